@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BACKPROP_H
+#define BACKPROP_H
+
+#include "network.h"
+
+// A bptt computes the gradient of a network's squared output error with respect to its weights, by truncated
+// backpropagation through time.  Steps are fed one at a time, carrying the network's activations from step to step; every
+// 'window' steps, or when a sequence ends, the error of the window's steps is backpropagated through the window and its
+// gradient added to the accumulated gradient.  To save memory the forward pass keeps only the activations carried into
+// every 'interval'-th step of the window.  The backward pass recomputes the steps between them one segment at a time,
+// so it needs O(window / interval + interval) node vectors rather than O(window), which is O(sqrt(window)) when interval
+// is about sqrt(window).  The price is running every step forward twice.
+struct bptt
+{
+  struct nnet *net;
+  size_t window;
+  size_t interval;
+  size_t steps;                 // steps fed in the current window.
+  size_t windows;               // windows backpropagated so far.
+  unsigned int *fired;          // per synapse: nodes below this one have fired by the time the synapse is applied.
+  flotype *inputs;              // window * inputcount: the inputs of the window's steps, to recompute them.
+  flotype *targets;             // window * outputcount: the target outputs of the window's steps.
+  sigtype *activations;         // carried from step to step by the forward pass.
+  sigtype *stored;              // activations carried into steps 0, interval, 2 * interval, ... of the window.
+  sigtype *replay;              // activations carried while a segment is recomputed.
+  sigtype *pre;                 // interval * nodecount: accumulated inputs of the recomputed segment's steps.
+  flotype *res;                 // interval * nodecount: node outputs of the recomputed segment's steps.
+  sigtype *nextpre;             // accumulated inputs of the step following the segment.
+  flotype *gpre;                // error gradient with respect to the accumulated inputs of the step being backpropagated
+  flotype *gnext;               // ... and of the step after it.
+  flotype *gres;                // error gradient with respect to the node outputs of the step being backpropagated.
+  flotype *outputs;
+  flotype *gradient;            // synapsecount: accumulated error gradient with respect to the weights.
+  double sqerr;                 // squared error of the outputs of the steps fed.
+  size_t scoredvals;            // number of outputs included in sqerr.
+};
+
+struct bptt *StartBptt (struct nnet *, size_t, size_t);
+void BpttStep (struct bptt *, const flotype *, const flotype *);
+void EndBpttWindow (struct bptt *);
+void ResetBptt (struct bptt *);
+void DescendGradient (struct bptt *, flotype);
+void FinishBptt (struct bptt *);
+
+#endif
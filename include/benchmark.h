@@ -0,0 +1,53 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// helpers shared by the benchmark programs: quieting the old engine, generating layered networks for it, setting up
+// its optimizers to run a given number of iterations, and reading hardware counters around a measured region.
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+
+// hardware events counted around each measured region, where perf_event_open permits.
+#define COUNTER_CYCLES         0
+#define COUNTER_INSTRUCTIONS   1
+#define COUNTER_LLC_MISSES     2
+#define COUNTER_BRANCH_MISSES  3
+#define COUNTERS               4
+
+struct counters
+{
+  int fd[COUNTERS];             // -1 for events that couldn't be opened.
+  uint64_t value[COUNTERS];     // counts between the last StartCounters and StopCounters.
+};
+
+void Quiet (void);
+void Loud (void);
+char *LayeredScript (const int *, int);
+size_t SetOptimizer (network_config *, int, size_t);
+int OpenCounters (struct counters *);
+void StartCounters (struct counters *);
+void StopCounters (struct counters *);
+void CloseCounters (struct counters *);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CASEFILE_H
+#define CASEFILE_H
+
+#include "network.h"
+
+// Binary case files hold a data set exactly as struct cases->data holds it in memory, so that a FromFile data source can
+// be mapped rather than parsed.  The header is followed, at dataoffset, by entrycount rows of inputcount + outputcount
+// values, each of the given precision, in the byte order of the machine that wrote the file.
+#define CASEFILE_MAGIC   "NNETCASE"
+#define CASEFILE_VERSION 1
+#define CASEFILE_ENDIAN  0x01020304
+#define CASEFILE_EXT     ".nnc"
+
+struct casefileheader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;              // CASEFILE_ENDIAN as written by the writer; reads differently on other byte orders.
+  uint32_t precision;           // bytes per value.
+  uint32_t reserved;
+  uint64_t inputcount;
+  uint64_t outputcount;
+  uint64_t entrycount;
+  uint64_t dataoffset;          // bytes from start of file to first value; the size of this header in version 1.
+  char padding[8];
+};
+
+int IsCaseFile (const char *);
+int MapCaseFile (struct cases *);
+void UnmapCaseFile (struct cases *);
+size_t WriteCaseFile (struct cases *, const char *);
+void ConvertDataSets (struct nnet *, const char *);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CASESTREAM_H
+#define CASESTREAM_H
+
+#include <pthread.h>
+#include "network.h"
+
+// default number of cases handed to the consumer at a time, and number of batch buffers in a reader's ring.  A ring of
+// two is double buffering: the consumer works on one batch while the reader thread parses the next.
+#define STREAM_BATCH 256
+#define STREAM_RING 2
+
+// A casestream delivers the cases of one data source in batches.  Batches are row-major, laid out exactly like
+// struct cases->data.  Cases already in memory, including binary case files (which are mapped, see casefile.h), are
+// handed out in place; text FromFile sources are parsed by a background thread into a ring of batch buffers so that
+// parsing batch k+1 overlaps the consumer's work on batch k.
+struct casestream
+{
+  struct cases *source;
+  size_t casesize;              // values per case (source->inputcount + source->outputcount).
+  size_t batchsize;             // maximum cases per batch.
+  size_t next;                  // in-memory sources: index of the next case to hand out.
+  // the remaining fields are only used when a reader thread is running.
+  size_t ringsize;
+  flotype *ring;                // ringsize * batchsize * casesize values.
+  size_t *counts;               // number of cases held in each ring slot.
+  size_t filled;                // slots published by the reader so far.
+  size_t taken;                 // slots handed to the consumer so far.
+  size_t drained;               // slots the consumer has finished with.
+  int finished;                 // reader has published its last slot.
+  int stop;                     // consumer is closing the stream early.
+  int threaded;
+  FILE *input;
+  pthread_t reader;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+};
+
+struct casestream *OpenCaseStream (struct cases *, size_t, size_t);
+flotype *NextCaseBatch (struct casestream *, size_t *);
+void CloseCaseStream (struct casestream *);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <pthread.h>
+#include "network.h"
+#include "weightfile.h"
+
+// number of saves that may be waiting or being written before Checkpoint blocks the caller.  Each holds a copy of the
+// network's node and synapse arrays, so this bounds the memory checkpointing uses.
+#define CHECKPOINT_QUEUE 2
+
+// one save: a snapshot of the network as it was when Checkpoint was called.
+struct checkpoint
+{
+  struct nnet net;              // shares plans with the live network; owns copies of its arrays and data list.
+  struct cases *data;           // net.data: datacount copies of the live data sets, linked in the same order.
+  size_t datacount;
+  struct conf config;           // copy of the configuration, with weightname set for this save.
+  char filename[256];
+  char weightname[256 + sizeof (WEIGHTFILE_EXT)];
+};
+
+// A checkpointer writes saves of a network on a background thread, so that training continues while a save is being
+// formatted and written.  Checkpoint snapshots the network into a ring of CHECKPOINT_QUEUE saves, and waits only when
+// the writer has fallen that far behind.
+struct checkpointer
+{
+  struct nnet *net;
+  struct conf *config;
+  struct checkpoint queue[CHECKPOINT_QUEUE];
+  size_t first;                 // oldest save not yet written.
+  size_t pending;               // saves queued or being written.
+  int stop;                     // no more saves are coming; finish the pending ones and exit.
+  pthread_t writer;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+};
+
+void NameOutputFile (char *, struct conf *);
+struct checkpointer *StartCheckpoints (struct nnet *, struct conf *);
+void Checkpoint (struct checkpointer *);
+void FinishCheckpoints (struct checkpointer *);
+
+#endif
@@ -46,10 +46,35 @@
 #define PAR_QSORT_LOW_LIMIT 1024
 
 // specifically for datafiles, weights, and activations. We want to be able to compile correctly for different size floats, on account of OMP and GPU
-// restrictions.
+// restrictions.  configure --enable-precision=single defines FLOTYPE_SINGLE: everything is float.  --enable-precision=mixed defines
+// FLOTYPE_MIXED: weights, data and activations are float, but node signals (the running sums the accumulators build up over many
+// synapses) are kept in double.  sigtype is the type of those signals.
+#if defined(FLOTYPE_SINGLE) || defined(FLOTYPE_MIXED)
+typedef float flotype;
+#define FLOTYPE_MAX FLT_MAX
+#define FLOTYPE_MIN FLT_MIN
+#define FLOTYPE_DIG FLT_DIG     // decimal digits that always survive a trip through flotype.
+#define FLOTYPE_DECIMAL_DIG FLT_DECIMAL_DIG     // digits that always suffice to print a flotype exactly.
+#else
 typedef double flotype;
+#define FLOTYPE_MAX DBL_MAX
+#define FLOTYPE_MIN DBL_MIN
+#define FLOTYPE_DIG DBL_DIG
+#define FLOTYPE_DECIMAL_DIG DBL_DECIMAL_DIG
+#endif
+#if defined(FLOTYPE_SINGLE)
+typedef float sigtype;
+#define FLOTYPE_NAME "single"
+#elif defined(FLOTYPE_MIXED)
+typedef double sigtype;
+#define FLOTYPE_NAME "mixed"
+#else
+typedef double sigtype;
+#define FLOTYPE_NAME "double"
+#endif
 
-// FLOFMT is for scripts (replace with %#.15g if all bits are needed; FLOFMT3 is for columnar human-readable (output).
+// FLOFMT is for human-readable output (nnetwriter prints weights and data exactly, see save.c); FLOFMT3 is for columnar
+// human-readable output.
 #define FLOFMT " %#6g"
 #define FLOFMT3 " %#6.3g"
 
@@ -57,12 +82,24 @@ typedef double flotype;
 #define ONE  ((flotype)1.0)
 #define TWO  ((flotype)2.0)
 
+// float builds call the float versions of libm so transfer loops vectorize at full float width.
+#if defined(FLOTYPE_SINGLE) || defined(FLOTYPE_MIXED)
+#define absolute(n)    ((flotype)(fabsf((float)(n))))
+#define logarithm(n)   ((flotype)(logf((float)(n))))
+#define cosine(n)      ((flotype)(cosf((float)(n))))
+#define sine(n)        ((flotype)(sinf((float)(n))))
+#define hypertan(n)    ((flotype)(tanhf((float)(n))))
+#define arctan(n)      ((flotype)(atanf((float)(n))))
+#define exponential(n) ((flotype)(expf((float)(n))))
+#else
 #define absolute(n)    ((flotype)(fabs((double)(n))))
 #define logarithm(n)   ((flotype)(log((double)(n))))
 #define cosine(n)      ((flotype)(cos((double)(n))))
+#define sine(n)        ((flotype)(sin((double)(n))))
 #define hypertan(n)    ((flotype)(tanh((double)(n))))
 #define arctan(n)      ((flotype)(atan((double)(n))))
 #define exponential(n) ((flotype)(exp((double)(n))))
+#endif
 
 // definition of various internal types
 enum switch_flag
@@ -125,6 +162,14 @@ enum optimization_method
 // flags for save configuration  (struct nnet ->flags)
 #define SAVE_SERIALIZE          0x400
 #define SAVE_DEFAULT            0x800
+// set by nnet -d: echo the script while parsing it
+#define DEBUG_ECHO             0x1000
+// Save(WeightFile): write weights to a binary weight file beside the saved script
+#define SAVE_WEIGHTFILE        0x2000
+// set by nnet -p or -P: count where the run's time goes and report it with each plan's results (profile.h)
+#define PROFILE_RUN            0x4000
+// set by nnet -k: start from the network cache beside the script while it is current, and write it when it isn't
+#define CACHE_NETWORK          0x8000
 
 // flags for datasets  (struct cases ->flags)
 #define DATA_IMMEDIATE        0x1
@@ -142,19 +187,32 @@ enum optimization_method
 #define DATA_NOWRITEOUTPUT 0x1000
 #define DATA_WRITEPIPE     0x2000
 #define DATA_WRITEFILE     0x4000
+#define DATA_MAPPED        0x8000
+#define DATA_SEQUENCE     0x10000
 
 #define PLAN_TRAIN            0x1
 #define PLAN_TEST             0x2
 #define PLAN_VALIDATE         0x4
 #define PLAN_DEPLOY           0x8
+#define PLAN_PRUNE           0x40
 
 #define PLAN_GRAD_DESCENT    0X10
 #define PLAN_ALL_METHODS     (PLAN_GRAD_DESCENT)
+// 'Precision Fast': run the plan with the approximate transfer functions of fastmath.h
+#define PLAN_PRECISION_FAST  0x20
+// DeploymentPlan(Quantize): deploy with int8 weights (quantize.h)
+#define PLAN_QUANTIZE        0x80
+
+// transfer functions a network is run with (struct nnet ->precision)
+#define PRECISION_EXACT       0
+#define PRECISION_FAST        1
 
 #define PLAN_DEFAULT_GOAL     (flotype)0.95
 #define PLAN_DEFAULT_EPOCHS   10
 #define PLAN_DEFAULT_RATE     (flotype)0.01
 #define PLAN_DEFAULT_MAXEP    1000
+#define PLAN_DEFAULT_LATENCY  1000
+#define PLAN_DEFAULT_WINDOW   64
 
 
 #define MANPAGE "\n"\
@@ -165,7 +223,9 @@ enum optimization_method
 "       ral networks.\n"\
 "\n"\
 "SYNOPSIS\n"\
-"       nnet filename\n"\
+"       nnet [-d] [-k] [-p | -P n] filename\n"\
+"\n"\
+"       nnet -c, nnet --convert filename\n"\
 "\n"\
 "       nnet -v, nnet --version\n"\
 "\n"\
@@ -208,6 +268,40 @@ enum optimization_method
 "       been done need not be entirely lost.\n"\
 "\n"\
 "OPTIONS\n"\
+"       -c,--convert\n"\
+"              Write each Immediate or text FromFile data set of  filename.nnet\n"\
+"              to  a  binary  case  file, and exit without carrying out the\n"\
+"              script's plans.  The data set read from file name is written\n"\
+"              to name.nnc, and the data of the Nth Data statement, if Immedi‐\n"\
+"              ate, to filename.N.nnc.  Binary case files are mapped into mem‐\n"\
+"              ory when read with FromFile, so they need no  parsing.   They\n"\
+"              are  specific to the precision nnet was built with and to the\n"\
+"              machine's byte order.\n"\
+"\n"\
+"       -d,--debug\n"\
+"              Echo the script to stdout, with line  numbers,  while  reading\n"\
+"              it.\n"\
+"\n"\
+"       -k,--cache\n"\
+"              Keep  what  parsing  filename.nnet  makes of it in filename.nnb,\n"\
+"              and while the script's contents are unchanged read that instead\n"\
+"              of parsing and validating the script again.  The cache is speci‐\n"\
+"              fic to the build of nnet that wrote it.   Scripts  that  read  a\n"\
+"              weight file are not cached.  -d reads the script regardless.\n"\
+"\n"\
+"       -p,--profile\n"\
+"              Count the wall time and calls spent parsing, validating and com‐\n"\
+"              piling the script, running the network forward and backward, up‐\n"\
+"              dating weights, reading and writing data, and saving checkpoints.\n"\
+"              The counts are written after each training epoch and each other\n"\
+"              plan, where the plan reports (its ReportTo destination), and then\n"\
+"              start again from zero.  Without this option the counting  costs\n"\
+"              next to nothing.\n"\
+"\n"\
+"       -P,--profile-nodes n\n"\
+"              As -p, and also time each firing of a group of nodes,  totalled\n"\
+"              by transfer function and by ranges of n nodes.\n"\
+"\n"\
 "       -v,--version\n"\
 "              Print the current version information of nnet and exit.\n"\
 "\n"\
@@ -319,8 +413,8 @@ enum optimization_method
 "       Silence may be called with multiple arguments.  Each  argument  must\n"\
 "       be one of the following keywords.\n"\
 "\n"\
-"       Silence(Echo)  suppresses the usual printing of the script to stdout\n"\
-"       as it is read.\n"\
+"       Silence(Echo)  suppresses the printing of the script to stdout as it\n"\
+"       is read, which nnet -d otherwise does.\n"\
 "\n"\
 "       Silence(Recurrence) suppresses a warning about  a  recurrent  neural\n"\
 "       network.\n"\
@@ -374,7 +468,17 @@ enum optimization_method
 "       close  to equal as possible.  If n is less than the number of epochs\n"\
 "       of training then one save will be made after each epoch.   If  given\n"\
 "       along  with  a Serialize keyword argument, each save will have a new\n"\
-"       incremental serial number.\n"\
+"       incremental serial number.  Saves are written by a background thread\n"\
+"       from a copy of the network taken at the end of the epoch, so training\n"\
+"       goes on while they are written.  Training waits only if two saves\n"\
+"       are still being written when the next one is due.\n"\
+"\n"\
+"       Save(WeightFile) writes the weights of the network to a binary\n"\
+"       weight file beside each savefile, named like the savefile with .nnw\n"\
+"       appended, and writes the Connect statements of the saved script to\n"\
+"       refer to that file instead of listing the weights.  Large networks\n"\
+"       then save and load quickly, and the saved script stays small enough\n"\
+"       to read and edit.\n"\
 "\n"\
 "   Node Definition Section\n"\
 "       Node Definition Sections define nodes.  They start with the  keyword\n"\
@@ -474,6 +578,25 @@ enum optimization_method
 "       It could also be written with the whole array on  one  line;  white‐\n"\
 "       space is not significant.\n"\
 "\n"\
+"       The weights may also be read from a binary weight file, such as one\n"\
+"       written by Save(WeightFile).  FromWeightFile “name” n in place of\n"\
+"       the weights takes the statement's weights, in the same order as an\n"\
+"       array of weights, from the file name starting with weight number n\n"\
+"       of the file (counting from 0).  A WeightFile(“name”) statement names\n"\
+"       the file for the rest of the section so it need not be repeated,\n"\
+"       and when n is left out reading continues after the weights that the\n"\
+"       previous reference to the same file read:\n"\
+"\n"\
+"            StartConnections\n"\
+"                 WeightFile(\"xor.nnw\")\n"\
+"                 Connect({0 2} {3 4} FromWeightFile 0)\n"\
+"                 Connect(3 4 FromWeightFile)\n"\
+"            EndConnections\n"\
+"\n"\
+"       Weight files are mapped into memory rather than parsed.  Files\n"\
+"       written by single-precision and double-precision builds of nnet can\n"\
+"       be read by either.\n"\
+"\n"\
 "       Whenever a different sequence of connection processing within a Con‐\n"\
 "       nect statement could give different results (for example in  a  non‐\n"\
 "       spiking  recurrent  network when the sources and destinations in the\n"\
@@ -575,6 +698,18 @@ enum optimization_method
 "       All types of data source must give cases in the same format  as  the\n"\
 "       <data>  argument  described  below. 'FromDirectory' means that every\n"\
 "       file in that directory is to be opened and read as a data source.\n"\
+"       The files are read concurrently and their cases are used in order  of\n"\
+"       file name.  Files whose names begin with '.' are ignored.\n"\
+"\n"\
+"       A file may instead hold plain columns of numbers: one case per line,\n"\
+"       the  input  values followed by the output values, separated by white\n"\
+"       space.  Blank lines and anything following '#' are ignored.  nnet takes\n"\
+"       a file to be in this form when its first character other than white\n"\
+"       space or comments is not '['.  Files are read while the network runs,\n"\
+"       by a separate thread, so they need not fit in memory.\n"\
+"\n"\
+"       A file may also be a binary case file written by nnet --convert, in\n"\
+"       which case it is mapped into memory rather than read.\n"\
 "\n"\
 "       <use> is one or more of the keywords 'Training', 'Testing', 'Valida‐\n"\
 "       tion',  or  'Deployment',  and  describe  what  operations this data\n"\
@@ -587,6 +722,15 @@ enum optimization_method
 "       to notify nnet that Output written to a  file  or  pipe  should  not\n"\
 "       include one or the other.  Flag keywords may come in any sequence.\n"\
 "\n"\
+"       The flag 'Sequence' says that the cases are the time steps of se‐\n"\
+"       quences, to be run through a recurrent network one after another,\n"\
+"       each step starting from the activations the previous step left be‐\n"\
+"       hind.  Each case of a Sequence data source has one extra input value\n"\
+"       before its inputs, the sequence marker: a case whose marker is not\n"\
+"       zero starts a new sequence, and the network's state is reset before\n"\
+"       it is run.  The marker is written back with the case's inputs.\n"\
+"       Sequence data can not be read 'FromPipe'.\n"\
+"\n"\
 "       <output_dest> may be skipped, unless 'Deployment' has been specified\n"\
 "       among the <use> arguments or 'WriteNoInput' or 'WriteNoOutput'  have\n"\
 "       been  specified  among the flags. If present, <output_dest> consists\n"\
@@ -629,6 +773,14 @@ enum optimization_method
 "       Says  that  when  Deploying, we will read input (but no output) from\n"\
 "       the pipe named inputstream and write output(but not  input)  to  the\n"\
 "       pipe named outputstream.\n"\
+"       A deployment plan serves a FromPipe data source for as long as nnet\n"\
+"       runs,  until  it is sent SIGINT or SIGTERM.  Each line written to the\n"\
+"       pipe is one case, and each gets one line in reply, in the order  the\n"\
+"       cases  arrived.   If  the  pipe name begins with 'unix:', the rest of\n"\
+"       it names a Unix domain socket that nnet listens on, and each connec‐\n"\
+"       tion's cases are answered on that connection.  DeploymentPlan's\n"\
+"       BatchSize  and  LatencyWindow  (microseconds) arguments control how\n"\
+"       many cases are gathered into one pass through the network.\n"\
 "          Data(FromFile \"Examples.nnx\" Testing\n"\
 "               ToFile \"Results.nnx\")\n"\
 "\n"\
@@ -652,6 +804,29 @@ enum optimization_method
 "       necessary  to  finish  the  original training plan starting from the\n"\
 "       point at which the output file was created). The final  output  file"\
 "       will contain no training or testing instructions.\n"\
+"       TrainingPlan(GradientDescent ...) follows the  gradient  of  the\n"\
+"       squared  error of the output nodes, found by truncated backpropa‐\n"\
+"       gation through time.  Cases are run in windows of up  to  'Window'\n"\
+"       steps  (default 64).  Ordinary cases are windows of one step; Se‐\n"\
+"       quence data is cut at each sequence marker and every Window steps,\n"\
+"       and BatchSize then counts windows.  Only every 'StoreEvery'th step\n"\
+"       of  a window is kept (by default about the square root of Window)\n"\
+"       and the steps between are recomputed when the gradient  is  taken\n"\
+"       back  through  them.   Accuracy  is  one minus the RMS error of an\n"\
+"       epoch's outputs.\n"\
+"       Any  plan  may  have  'Precision  Fast',  which runs it with fast\n"\
+"       approximations of exp, log, tanh and atan in the transfer  func‐\n"\
+"       tions (relative error below 1e-7 in double precision builds), or\n"\
+"       'Precision Exact', the default, which uses the math library.\n"\
+"       PruningPlan(PruneBelow x KeepTop k) removes synapses with weights\n"\
+"       smaller  than  x in magnitude, or outside the k largest into each\n"\
+"       node, except where that would change the firing sequence or  the\n"\
+"       value  of  a  Multiply or Max node.  TrainingPlan accepts the same\n"\
+"       arguments with 'PruneEvery n' to prune every n epochs.\n"\
+"       DeploymentPlan(Quantize) runs with int8 weights, int16 node out‐\n"\
+"       puts and int32 sums, scaled to the output ranges found  over  the\n"\
+"       Validation  (or  Testing) data, and reports how far the quantized\n"\
+"       outputs are from floating point ones.\n"\
 "\n"\
 "       SECTION INCOMPLETE. TBD\n"\
 "\n"\
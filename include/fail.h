@@ -0,0 +1,45 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// where the engine's errors go.  In the executables an error message goes to stderr and the program exits.  A
+// libgneural call arms a trap on its thread first: then messages go to the caller's log function, and Fail unwinds to
+// the call, which returns an error code instead.
+
+#ifndef FAIL_H
+#define FAIL_H
+
+#include <setjmp.h>
+#include "gneural.h"
+
+struct failtrap
+{
+  jmp_buf unwind;
+  gneural_log log;              // may be NULL.
+  void *logarg;
+  char message[512];            // the last error complained of while the trap was armed.
+};
+
+// the trap armed on this thread, if a libgneural call is running on it; NULL otherwise.
+extern __thread struct failtrap *failtrap;
+
+void Complain (const char *, ...) __attribute__ ((format (printf, 1, 2)));
+void Fail (int) __attribute__ ((noreturn));
+
+#endif
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "defines.h"
+
+// Fast approximations of the transcendental functions behind the transfer functions, used when a plan asks for
+// 'Precision Fast'.  Each is straight-line code (selects, no branches or table lookups) so transfer loops over them
+// vectorize.  Over the whole range of flotype, measured against libm:
+//   fastexp    relative error below 1e-8 (double) or 1e-7 (float).  Arguments beyond about +-708 (double) or +-87
+//              (float) are clamped, so results never overflow to infinity or underflow to zero.
+//   fastlog    relative error below 1e-8 (double) or 3e-7 (float) for positive arguments.  Zero gives -infinity,
+//              negative arguments and NaN give NaN, subnormal arguments are treated as the smallest normal number.
+//   fasttanh   relative error below 3e-8 (double) or 3e-7 (float).
+//   fastatan   relative error below 5e-8 (double) or 3e-7 (float).
+// Float builds are limited by float rounding rather than by the approximations.
+
+#if defined(FLOTYPE_SINGLE) || defined(FLOTYPE_MIXED)
+typedef int32_t flobits;
+#define FLOBITS_MANTISSA 23
+#define FLOBITS_BIAS     127
+#define FASTEXP_LIMIT    ((flotype)87.0)
+#define FAST_ROUNDER     ((flotype)0x1.8p23)
+#define FASTCOPYSIGN(a,b) ((flotype)(copysignf((float)(a), (float)(b))))
+#else
+typedef int64_t flobits;
+#define FLOBITS_MANTISSA 52
+#define FLOBITS_BIAS     1023
+#define FASTEXP_LIMIT    ((flotype)708.0)
+#define FAST_ROUNDER     ((flotype)0x1.8p52)
+#define FASTCOPYSIGN(a,b) ((flotype)(copysign((double)(a), (double)(b))))
+#endif
+
+#define FAST_LN2_HI  ((flotype)6.93145751953125e-1)
+#define FAST_LN2_LO  ((flotype)1.42860682030941723212e-6)
+#define FAST_LOG2E   ((flotype)1.44269504088896340736)
+#define FAST_SQRT2   ((flotype)1.41421356237309504880)
+#define FAST_PI_2    ((flotype)1.57079632679489661923)
+#define FAST_PI_4    ((flotype)0.78539816339744830962)
+#define FAST_TAN_PI_8 ((flotype)0.41421356237309504880)
+
+// e to the x: x = n ln2 + r with |r| <= ln2/2, then 2^n is built in the exponent bits and e^r is a degree 7 polynomial.
+// n is rounded to nearest by adding and subtracting FAST_ROUNDER, which leaves no fraction bits.
+static inline flotype
+fastexp (flotype x)
+{
+  x = absolute (x) > FASTEXP_LIMIT ? FASTCOPYSIGN (FASTEXP_LIMIT, x) : x;
+  const flotype n = (x * FAST_LOG2E + FAST_ROUNDER) - FAST_ROUNDER;
+  const flotype r = (x - n * FAST_LN2_HI) - n * FAST_LN2_LO;
+  const flotype p = ONE + r * (ONE + r * ((flotype) (1.0 / 2) +
+                                          r * ((flotype) (1.0 / 6) +
+                                               r * ((flotype) (1.0 / 24) +
+                                                    r * ((flotype) (1.0 / 120) +
+                                                         r * ((flotype) (1.0 / 720) +
+                                                              r * (flotype) (1.0 / 5040)))))));
+  const flobits bits = (flobits) ((int32_t) n + FLOBITS_BIAS) << FLOBITS_MANTISSA;
+  flotype scale;
+  memcpy (&scale, &bits, sizeof (flotype));
+  return (p * scale);
+}
+
+// natural log: x = m 2^e with m in [sqrt(1/2), sqrt(2)), then log m = 2 atanh(s) with s = (m-1)/(m+1), |s| < 0.172.
+static inline flotype
+fastlog (flotype x)
+{
+  const flotype y = x < FLOTYPE_MIN ? FLOTYPE_MIN : x;
+  flobits bits;
+  memcpy (&bits, &y, sizeof (flotype));
+  flotype e = (flotype) ((int32_t) (bits >> FLOBITS_MANTISSA) - FLOBITS_BIAS);
+  bits = (bits & (((flobits) 1 << FLOBITS_MANTISSA) - 1)) |
+    ((flobits) FLOBITS_BIAS << FLOBITS_MANTISSA);
+  flotype m;
+  memcpy (&m, &bits, sizeof (flotype));
+  const int high = m > FAST_SQRT2;
+  e = high ? e + ONE : e;
+  m = high ? m * (flotype) 0.5 : m;
+  const flotype s = (m - ONE) / (m + ONE);
+  const flotype s2 = s * s;
+  const flotype p = TWO * s * (ONE + s2 * ((flotype) (1.0 / 3) +
+                                           s2 * ((flotype) (1.0 / 5) +
+                                                 s2 * ((flotype) (1.0 / 7) +
+                                                       s2 * (flotype) (1.0 / 9)))));
+  const flotype r = (e * FAST_LN2_HI + p) + e * FAST_LN2_LO;
+  // positive finite x take r.  Otherwise zero gives -infinity, infinity gives itself, and NaN or negative x give NaN.
+  const int finite = (x > ZERO) & (x <= FLOTYPE_MAX);
+  const flotype special = x == ZERO ? -INFINITY : x * (x > ZERO ? ONE : NAN);
+  return (finite ? r : special);
+}
+
+// hyperbolic tangent: (1 - e^-2|x|) / (1 + e^-2|x|), except below |x| = 1/8, where that would cancel, a Taylor series.
+static inline flotype
+fasttanh (flotype x)
+{
+  const flotype a = x < ZERO ? -x : x;
+  const flotype e = fastexp (-TWO * a);
+  const flotype big = (ONE - e) / (ONE + e);
+  const flotype a2 = a * a;
+  const flotype small = a * (ONE - a2 * ((flotype) (1.0 / 3) -
+                                         a2 * ((flotype) (2.0 / 15) -
+                                               a2 * ((flotype) (17.0 / 315) -
+                                                     a2 * (flotype) (62.0 / 2835)))));
+  const flotype r = a < (flotype) 0.125 ? small : big;
+  return (x < ZERO ? -r : r);
+}
+
+// arctangent: reduce to |u| <= tan(pi/8) through atan(x) = pi/2 - atan(1/x) and atan(t) = pi/4 + atan((t-1)/(t+1)),
+// then a Taylor series through u^15.
+static inline flotype
+fastatan (flotype x)
+{
+  const flotype a = x < ZERO ? -x : x;
+  const int inverted = a > ONE;
+  const flotype t = inverted ? ONE / a : a;
+  const int shifted = t > FAST_TAN_PI_8;
+  const flotype u = shifted ? (t - ONE) / (t + ONE) : t;
+  const flotype u2 = u * u;
+  const flotype p = u * (ONE - u2 * ((flotype) (1.0 / 3) -
+                                     u2 * ((flotype) (1.0 / 5) -
+                                           u2 * ((flotype) (1.0 / 7) -
+                                                 u2 * ((flotype) (1.0 / 9) -
+                                                       u2 * ((flotype) (1.0 / 11) -
+                                                             u2 * ((flotype) (1.0 / 13) -
+                                                                   u2 * (flotype) (1.0 / 15))))))));
+  flotype r = shifted ? FAST_PI_4 + p : p;
+  r = inverted ? FAST_PI_2 - r : r;
+  return (x < ZERO ? -r : r);
+}
+
+#endif
@@ -26,4 +26,17 @@
 
 void feedforward (network *);
 
+void transfer (int, const sigtype *, flotype *, size_t);
+void fast_transfer (int, const sigtype *, flotype *, size_t);
+void init_activations (const struct nnet *const, sigtype *);
+void init_activations_batch (const struct nnet *const, sigtype *, size_t);
+void fwdprop (const struct nnet *const, const flotype * const,
+              sigtype * const, flotype * const, flotype * const);
+void fwdprop_record (const struct nnet *const, const flotype * const,
+                     sigtype * const, sigtype * const, flotype * const,
+                     flotype * const);
+void fwdprop_batch (const struct nnet *const, const size_t,
+                    const flotype * const, sigtype * const, flotype * const,
+                    flotype * const);
+
 #endif
@@ -0,0 +1,87 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* libgneural: the nnet engine as a library.  A context loads one nnet script and runs, steps, trains and saves the
+   network it describes.  Contexts share nothing, so each thread may use its own; a single context must not be used by
+   two threads at once.  Calls return GNEURAL_OK or a negative error code, and never exit or print: the engine's
+   error and warning messages go to the log function given to gneural_new, and the last error stays readable through
+   gneural_message.  Values are doubles whatever precision the library was built with, and cases are stored one after
+   another, inputs (or outputs) of a case side by side.  */
+
+#ifndef GNEURAL_H
+#define GNEURAL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GNEURAL_OK        0
+#define GNEURAL_FAILED   -1     /* the engine refused; gneural_message says why. */
+#define GNEURAL_NOMEM    -2     /* out of memory. */
+#define GNEURAL_BADCALL  -3     /* a NULL argument, or no network has been loaded. */
+
+#define GNEURAL_LOG_ERROR    0
+#define GNEURAL_LOG_WARNING  1
+
+  typedef struct gneural gneural;
+  typedef void (*gneural_log) (void *arg, int level, const char *message);
+
+  /* a context with no network.  log may be NULL to drop messages.  Returns NULL if out of memory. */
+  gneural *gneural_new (gneural_log log, void *arg);
+  void gneural_free (gneural * gn);
+
+  /* load a network from an nnet script, replacing any loaded before.  Plans and data in the script are read but not
+     carried out.  On failure the context keeps the network it had. */
+  int gneural_load_file (gneural * gn, const char *filename);
+  int gneural_load_script (gneural * gn, const char *text, size_t length);
+
+  /* write the network, with its current weights, as an nnet script. */
+  int gneural_save_file (gneural * gn, const char *filename);
+
+  /* node counts of the loaded network; zero if none is loaded. */
+  unsigned int gneural_inputs (const gneural * gn);
+  unsigned int gneural_outputs (const gneural * gn);
+
+  /* run count independent cases, each from the network's initial state. */
+  int gneural_run (gneural * gn, size_t count, const double *inputs,
+                   double *outputs);
+
+  /* run one step of a sequence, carrying recurrent signals on to the next step; gneural_reset starts a new sequence. */
+  int gneural_step (gneural * gn, const double *inputs, double *outputs);
+  int gneural_reset (gneural * gn);
+
+  /* train on count cases as one batch: backpropagate each from the network's initial state, then move the weights rate
+     times the summed gradient downhill.  If rmserror isn't NULL it gets the root mean square output error of the cases before the
+     update. */
+  int gneural_train (gneural * gn, size_t count, const double *inputs,
+                     const double *targets, double rate, double *rmserror);
+
+  /* the last error message, or an empty string. */
+  const char *gneural_message (const gneural * gn);
+  const char *gneural_strerror (int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,6 +30,7 @@
 
 #include<assert.h>
 #include<ctype.h>
+#include<float.h>
 #include<error.h>
 #include<getopt.h>
 #include<limits.h>
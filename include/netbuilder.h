@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef NETBUILDER_H
+#define NETBUILDER_H
+
+#include "network.h"
+
+// node groups, in the order their nodes are numbered: the bias node, then inputs, hidden nodes, and outputs.
+#define GROUP_BIAS   0
+#define GROUP_INPUT  1
+#define GROUP_HIDDEN 2
+#define GROUP_OUTPUT 3
+#define NODEGROUPS   4
+
+// the nodes of one group.  Each node keeps the identity it was created with; its position in the group changes only
+// when BuildSwapRange moves it.
+struct nodegroup
+{
+  unsigned int count;
+  unsigned int cap;
+  enum activation_function *transfer;   // by position, like the arrays of struct nnet.
+  enum accumulator_function *accum;
+  unsigned int *transferwidths;
+  unsigned int *position;       // by identity.
+  unsigned int *identity;       // by position.
+};
+
+// A netbuilder puts a network together in time linear in its size.  Its arrays grow geometrically, and its synapses
+// name their nodes by group and identity, so inserting nodes or swapping ranges of them never rewrites the synapses;
+// CompactNetwork numbers every node and synapse of the network in one pass.  Between calls to CompactNetwork the
+// network's node and synapse counts are kept current but its arrays are not.
+struct netbuilder
+{
+  struct nnet *net;
+  struct nodegroup groups[NODEGROUPS];
+  unsigned int synapsecount;
+  unsigned int synapsecap;
+  flotype *weights;
+  uint32_t *sources;            // node keys: group in the top two bits, identity below.
+  uint32_t *dests;
+  int compacted;                // net's arrays hold everything built so far.
+  uint64_t rndstate;            // randomfloat()'s state for Randomize weights; see RANDOMFLOAT_SEED.
+};
+
+struct netbuilder *StartNetBuilder (struct nnet *);
+int BuildNodes (struct netbuilder *, int, int, int, int, unsigned int);
+void BuildConnections (struct netbuilder *, int, int, int, int,
+                       const flotype *, size_t);
+void BuildSwapRange (struct netbuilder *, int, int, int);
+void CompactNetwork (struct netbuilder *);
+void FinishNetBuilder (struct netbuilder *);
+void DiscardNetBuilder (struct netbuilder *);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef NETCACHE_H
+#define NETCACHE_H
+
+#include "network.h"
+#include "parser.h"
+
+// A network cache holds everything nnetparser made of a script: the compiled network with its weights and topology,
+// its plans and data statements, the configuration the script set, and the warnings parsing drew.  nnet -k keeps one
+// beside the script, and while the script's contents hash to the value in the header it is read in place of parsing.
+// The header is followed by a payload of dataoffset bytes onward, in the byte order and struct layout of the machine
+// and build that wrote it.
+#define NETCACHE_MAGIC   "NNETCACH"
+#define NETCACHE_VERSION 1
+#define NETCACHE_ENDIAN  0x01020304
+#define NETCACHE_EXT     ".nnb"
+
+struct netcacheheader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;              // NETCACHE_ENDIAN as written by the writer; reads differently on other byte orders.
+  uint32_t precision;           // bytes per flotype.
+  uint32_t layout;              // sizes of the structs stored whole, so that a cache from another build isn't used.
+  uint64_t scripthash;          // FNV-1a hash of the script the cache was made from.
+  uint64_t scriptlength;
+  uint64_t payloadhash;         // FNV-1a hash of the payload, to catch a damaged file.
+  uint64_t payloadlength;
+  uint64_t dataoffset;          // bytes from start of file to the payload; the size of this header in version 1.
+};
+
+uint64_t HashScript (FILE *, uint64_t *);
+int LoadNetCache (const char *, uint64_t, uint64_t, struct nnet *,
+                  struct conf *, struct slidingbuffer *);
+void SaveNetCache (const char *, uint64_t, uint64_t, const struct nnet *,
+                   const struct conf *, const struct slidingbuffer *);
+
+#endif
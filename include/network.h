@@ -71,6 +71,27 @@ struct nnet
   unsigned int *dests;          // each synapse has its own destination.
   struct cases *data;
   struct plans *plan;
+  struct topology *topology;    // made by ValidateConnections; NULL until connections are read.
+  unsigned int precision;       // PRECISION_EXACT, or PRECISION_FAST while a plan asking for it runs.
+  struct quantized *quantized;  // int8 weights fwdprop_batch runs with while a DeploymentPlan with Quantize runs.
+  struct profile *profile;      // where the run's time goes, counted if nnet was run with -p; NULL otherwise.
+};
+
+// Summary of how the connections use each node, for validation warnings and for later stages that rearrange or compile
+// the network.  usage records the order in which the synapse sequence first uses a node as source and destination:
+// 0: no use yet recorded.  1: recorded as dest only.  2: recorded as dest then source.  3: recorded as source only.  4:
+// recorded as source then dest. 5: recorded as dest then source then dest. 6: recorded as source then dest then source.
+// 7: recorded as source / dest / source / dest OR dest / source / dest / source (multiactivation)
+struct topology
+{
+  unsigned int nodecount;
+  unsigned int *indegree;       // per node, synapses with that node as destination.
+  unsigned int *outdegree;      // per node, synapses with that node as source.
+  unsigned char *usage;
+  unsigned int silent;          // non-output nodes that send no signals.
+  unsigned int deaf;            // non-input nodes that receive no signals.
+  unsigned int recurrent;       // non-output nodes that save signal across activation sequences.
+  unsigned int multiactivated;  // nodes activated more than once per activation sequence.
 };
 
 // struct added by Ray Dillinger, Nov 2016
@@ -81,6 +102,7 @@ struct conf
   unsigned int serialnum;       // serial number of next save to output if serializing.
   unsigned int savecount;       // number of saves remaining to be made in the current plan
   char *savename;               // filename for script writeback
+  char *weightname;             // weight file written beside the script if saving with Save(WeightFile).
 };
 
 // struct added by Ray Dillinger, Jan 2017
@@ -92,8 +114,14 @@ struct plans
   unsigned int epochmax;        // zero - no maximum - continue until goal reached.
   unsigned int batchsize;
   unsigned int epochsize;
+  unsigned int latency;         // microseconds a deployment server waits for more requests to fill a batch.
+  unsigned int window;          // steps of a sequence backpropagated together when training.
+  unsigned int storeevery;      // steps between the activations stored within a window; zero for about sqrt(window).
   flotype trainrate;
   flotype momentum;
+  flotype prunebelow;           // pruning removes synapses with weights smaller in magnitude than this; zero if unused.
+  unsigned int keeptop;         // pruning keeps this many of the largest synapses into each node; zero if unused.
+  unsigned int pruneevery;      // training prunes after every this many epochs; zero for never.
 
   char *outputdest;             // filename to send individual results to case by case; may be NULL if output is not desired.
   char *reportdest;             // filename to send summary report (accuracy, use statistics, time, etc to).
@@ -107,6 +135,7 @@ struct cases
   uint32_t flags;               // 1 test 2 train 4 validate 8 deploy 10 sequential 20 seekable 40 randomize 80 no_output .....
   size_t entrycount;            // number of cases in allocated data buffer.
   size_t inputcount;            // width (number of nodes) of input data for this data source. usually nnet.inputcount.
+  // Sequence data sources carry the sequence marker as an extra first input value.
   size_t outputcount;           // width (number of nodes) of output for this data source. usually nnet.outputcount.
   char *inname;                 // filename for example data.  NULL for examples in script data.
   FILE *inpipe;                 // input pipe. NULL if pipe is not presently open.
@@ -145,11 +174,18 @@ typedef struct _network_config
   double gamma;
   double kbtmin, kbtmax;
   double wmin, wmax;
+  int rndstate;                 // where rnd() is in its sequence; see srnd().
+  unsigned char crossovermax;   // the next crossover of two mid-range weights makes a wmax (else a wmin) child.
 
   /* training fields */
   unsigned int num_cases;
   double cases_x[MAX_TRAINING_CASES][MAX_NUM_NEURONS][MAX_IN];
   double cases_y[MAX_TRAINING_CASES][MAX_NUM_NEURONS];
+
+  /* bookkeeping for benchmarks */
+  unsigned long error_calls;    // times error() has been called with this config.
+  void (*error_seen) (void *, double);  // if not NULL, called with error_seen_arg and each result of error().
+  void *error_seen_arg;
 } network_config;
 
 struct nnet *convertnetwork (struct _network *);
@@ -157,7 +193,15 @@ int AddHiddenNodes (struct nnet *, int, int, int, unsigned int);
 int AddInputNodes (struct nnet *, int, int, int, unsigned int);
 int AddOutputNodes (struct nnet *, int, int, int, unsigned int);
 void AddConnections (struct nnet *, int, int, int, int, flotype *);
-void AddRandomizedConnections (struct nnet *, int, int, int, int);
+struct plans **PlansInOrder (struct plans *, size_t *);
+struct cases **CasesInOrder (struct cases *, size_t *);
+struct topology *SummarizeTopology (const struct nnet *);
+void FreeTopology (struct topology *);
+int IsRecurrentNode (const struct nnet *, const struct topology *,
+                     unsigned int);
+int IsMultiActivatedNode (const struct nnet *, const struct topology *,
+                          unsigned int);
+void AddRandomizedConnections (struct nnet *, uint64_t *, int, int, int, int);
 
 
 /*
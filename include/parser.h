@@ -37,22 +37,39 @@
 "LogRectifier","Periodic","Gaussian","Spline","ParallelMult","ParallelMath"
 
 
-#define BFLEN 128
+struct netbuilder;
+
+// Script input is read in blocks of BFLEN bytes.  buffer[end] is the next unread character and buffer[head] is where the
+// next block will be read to.
+#define BFLEN 65536
 struct slidingbuffer
 {
   FILE *input;
   int head;
   int end;
+  int atend;                    // input has been read to end of file.
   int line;
   int col;
+  int announced;                // line zero's number has been echoed.
+  struct netbuilder *builder;   // the network being parsed, until parsing finishes.
+  int weightfiles;              // weights were read from weight files, so the script alone doesn't give the network.
   char *warnings;
+  size_t warnlen;               // length of warnings.
+  size_t warncap;               // bytes allocated for warnings.
   char buffer[BFLEN];
 };
 
 
 void parser (network *, network_config *, FILE *);
 void PrintWarnings (struct slidingbuffer *);
+void ErrStopParsing (struct slidingbuffer *, const char *, void *);
 void nnetparser (struct nnet *, struct conf *, struct slidingbuffer *);
+void FreeNnet (struct nnet *);
 void debugnnet (struct nnet *net);
+int ChAvailable (struct slidingbuffer *, int);
+int NextCh (struct slidingbuffer *);
+void SkipToNext (struct slidingbuffer *, struct conf *);
+int ReadCaseValues (struct slidingbuffer *, struct conf *, size_t, size_t,
+                    flotype *);
 
 #endif
@@ -0,0 +1,70 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "network.h"
+#include "parser.h"
+
+// phases of a run whose time nnet -p counts (struct profile ->seconds and ->calls).
+#define PROF_PARSE       0
+#define PROF_VALIDATE    1
+#define PROF_COMPILE     2
+#define PROF_FORWARD     3
+#define PROF_BACKWARD    4
+#define PROF_UPDATE      5
+#define PROF_DATA        6
+#define PROF_CHECKPOINT  7
+#define PROF_PHASES      8
+
+// wall time and calls counted since the last report.  Transfer functions and node ranges are counted only if rangesize
+// isn't zero: every group of nodes that fires adds its time to its transfer function and to the range of rangesize
+// nodes holding its first node.
+struct profile
+{
+  double since;                 // clock at the last report.
+  double seconds[PROF_PHASES];
+  unsigned long calls[PROF_PHASES];
+  double transferseconds[OUTPUTCOUNT];
+  unsigned long transfercalls[OUTPUTCOUNT];
+  unsigned int rangesize;
+  unsigned int rangecount;      // ranges allocated.
+  double *rangeseconds;
+  unsigned long *rangecalls;
+};
+
+// the time a phase started if net is being profiled, and zero if it isn't, so that a run without -p only pays for
+// testing one pointer.
+#define PROFILE_START(net) ((net)->profile != NULL ? ProfileClock () : 0.0)
+#define PROFILE_STOP(net, phase, start) \
+  do { if ((net)->profile != NULL) ProfileCount ((net)->profile, (phase), (start)); } while (0)
+// whether firings are being timed by transfer function and node range.
+#define PROFILE_DETAIL(net) ((net)->profile != NULL && (net)->profile->rangesize != 0)
+
+double ProfileClock (void);
+struct profile *StartProfile (unsigned int);
+void ProfileCount (struct profile *, int, double);
+void ProfileFiring (struct profile *, int, unsigned int, double);
+void ProfileReport (const struct nnet *, FILE *, const char *);
+void FreeProfile (struct profile *);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <stdint.h>
+#include "network.h"
+
+// largest magnitudes of quantized weights and node outputs.
+#define QUANT_WEIGHT_MAX   127
+#define QUANT_ACTIVITY_MAX 32767
+// the most integer synapses one node may take before its int32 accumulator could overflow.
+#define QUANT_FANIN_MAX    ((int32_t)(INT32_MAX / ((int64_t)QUANT_WEIGHT_MAX * QUANT_ACTIVITY_MAX)))
+
+// An int8 version of a network's weights, for deployment.  Node outputs are kept as int16 in steps of actscale[node],
+// and each synapse into an Add node that fires after it (an integer synapse) carries an int8 weight in steps of
+// destscale[dest] / actscale[source].  The integer synapses into a node are summed in int32, and the sum, times
+// destscale[dest], joins the node's float input when it fires.  Transfer functions and every other synapse stay float.
+// The struct also holds the scratch space fwdprop_batch runs it in, so one quantized network must not be run by two
+// threads at once.
+struct quantized
+{
+  const struct nnet *net;
+  int8_t *weights;              // synapsecount; zero for float synapses.
+  unsigned char *integer;       // synapsecount; whether the synapse is an integer synapse.
+  unsigned char *quantizes;     // nodecount; whether the node is the source of integer synapses.
+  unsigned char *accumulates;   // nodecount; whether the node is the dest of integer synapses.
+  flotype *actscale;            // nodecount; value of one step of the node's int16 output.
+  flotype *destscale;           // nodecount; value of one step of the node's int32 accumulator.
+  unsigned int intsynapses;     // number of integer synapses.
+  size_t lanes;                 // cases the scratch space below has room for; see ReserveQuantized.
+  flotype *res;                 // nodecount x lanes: node outputs, when the caller keeps no history.
+  int16_t *qres;                // nodecount x lanes: int16 node outputs.
+  int32_t *acc;                 // nodecount x lanes: int32 sums; all zero between batches, as firing clears them.
+};
+
+struct quantized *QuantizeNetwork (const struct nnet *, const flotype *);
+void ReserveQuantized (struct quantized *, size_t);
+void FreeQuantized (struct quantized *);
+
+#endif
@@ -28,6 +28,8 @@
 
 void randomize (network *, network_config *);
 
-double randomfloat (const double min, const double max);
+#define RANDOMFLOAT_SEED 38467      // where randomfloat()'s sequence starts for a new network.
+
+double randomfloat (uint64_t *, const double min, const double max);
 
 #endif
@@ -21,6 +21,11 @@
 #ifndef RND_H
 #define RND_H
 
-double rnd (void);
+#include "network.h"
+
+#define RND_SEED 38467          // where rnd()'s sequence starts in a new config.
+
+double rnd (network_config *);
+void srnd (network_config *, unsigned int);
 
 #endif
@@ -30,4 +30,9 @@ void network_save (network *, network_config *);
 void network_save_final_curve (network *, network_config *);
 
 void nnetwriter (struct nnet *, struct conf *, FILE *);
+
+// enough room for any value printed by FloText.
+#define FLOTEXTMAX 40
+
+const char *FloText (char *, flotype);
 #endif
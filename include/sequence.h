@@ -0,0 +1,42 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "network.h"
+
+// A sequencer runs a (usually recurrent) network one time step at a time over a sequence of cases.  The activations
+// that recurrent connections carry from one step to the next are kept between steps.  Everything is allocated when the
+// sequencer is started, so steps allocate nothing.  Training keeps the history it needs itself; see backprop.h.
+struct sequencer
+{
+  const struct nnet *net;
+  sigtype *activations;         // nodecount values carried from step to step.
+  flotype *history;             // nodecount node outputs of the latest step.
+  flotype *outputs;             // outputcount outputs of the latest step.
+};
+
+struct sequencer *StartSequencer (const struct nnet *);
+void ResetSequence (struct sequencer *);
+const flotype *SequenceStep (struct sequencer *, const flotype *);
+void FinishSequencer (struct sequencer *);
+
+#endif
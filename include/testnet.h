@@ -0,0 +1,37 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// helpers shared by the check programs that 'make check' runs, and by the benchmark programs: random numbers, random
+// synapses and layers for networks put together with a netbuilder, copying and freeing the arrays of such networks,
+// and running a check over many random networks.
+
+#ifndef TESTNET_H
+#define TESTNET_H
+
+#include "network.h"
+#include "netbuilder.h"
+
+double Uniform (double, double);
+void RandomSynapses (struct netbuilder *, int, unsigned int, double, int);
+void ConnectLayers (struct netbuilder *, int, int, int, int, double);
+void CopyNetwork (struct nnet *, const struct nnet *);
+void FreeNetwork (struct nnet *);
+int CheckNetworks (int, int (*)(int, void *), void *);
+
+#endif
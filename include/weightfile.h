@@ -0,0 +1,66 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WEIGHTFILE_H
+#define WEIGHTFILE_H
+
+#include "network.h"
+
+// Weight files hold connection weights in binary, so that the Connect statements of a large network can refer to them
+// by position instead of listing them.  The header is followed, at dataoffset, by weightcount values of the given
+// precision in the byte order of the machine that wrote the file.  dataoffset is a multiple of 64, so the values are
+// aligned for vector loads once mapped.
+#define WEIGHTFILE_MAGIC   "NNETWGHT"
+#define WEIGHTFILE_VERSION 1
+#define WEIGHTFILE_ENDIAN  0x01020304
+#define WEIGHTFILE_EXT     ".nnw"
+
+struct weightfileheader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;              // WEIGHTFILE_ENDIAN as written by the writer; reads differently on other byte orders.
+  uint32_t precision;           // bytes per value; float and double files are both read by either build.
+  uint32_t reserved;
+  uint64_t weightcount;
+  uint64_t dataoffset;          // bytes from start of file to first value; the size of this header in version 1.
+  char padding[24];
+};
+
+// a weight file mapped while a StartConnections section is parsed.
+struct weightfile
+{
+  char *name;
+  void *map;
+  size_t length;                // bytes mapped.
+  const char *values;           // first weight.
+  uint32_t precision;
+  size_t weightcount;
+  size_t next;                  // position after the last weights read, where FromWeightFile without a position reads.
+  struct weightfile *link;
+};
+
+struct weightfile *OpenWeightFile (struct weightfile **, const char *,
+                                   char *, size_t);
+int CopyWeights (struct weightfile *, size_t, size_t, flotype *);
+void CloseWeightFiles (struct weightfile *);
+void WriteWeightFile (const struct nnet *, const char *);
+
+#endif
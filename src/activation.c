@@ -23,6 +23,7 @@
 
 #include "includes.h"
 #include "activation.h"
+#include "fail.h"
 
 inline double
 activation (enum activation_function type, double x)
@@ -57,7 +58,7 @@ activation (enum activation_function type, double x)
       return 1. + x + x * x;
       break;
     default:
-      printf ("unknown activation function!\n");
-      exit (-1);
+      Complain ("unknown activation function!\n");
+      Fail (-1);
     }
 }
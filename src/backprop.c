@@ -0,0 +1,358 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// training nnet networks by truncated backpropagation through time, recomputing stored segments of each window.
+
+#include "includes.h"
+#include "defines.h"
+#include "feedforward.h"
+#include "backprop.h"
+#include "profile.h"
+#include "fail.h"
+
+static void *
+Allocate (size_t count, size_t size)
+{
+  void *block = calloc (count != 0 ? count : 1, size);
+  if (block == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in StartBptt.\n");
+      Fail (1);
+    }
+  return (block);
+}
+
+// the derivative of a combiner's result with respect to the value x it combined, where into is the value it ended up
+// accumulated into.  Multiply passes no gradient through a zero factor; Max passes it only to the greatest value.
+static inline flotype
+CombineSlope (int combiner, flotype x, sigtype into)
+{
+  switch (combiner)
+    {
+    case 0:
+      return (ZERO);
+    case 1:
+      return (ONE);
+    case 2:
+      return (x != ZERO ? (flotype) (into / x) : ZERO);
+    case 3:
+      return (ONE / ((ONE + absolute (x)) * (ONE + absolute (x))));
+    case 4:
+      return (x > ZERO ? ONE : x < ZERO ? -ONE : ZERO);
+    case 5:
+      return (ONE / (ONE + absolute (x)));
+    case 6:
+      return (x == into ? ONE : ZERO);
+    case 7:
+      return (x > ZERO ? ONE : ZERO);
+    default:
+      Complain ("unknown combination function\n");
+      Fail (1);
+    }
+}
+
+// given the gradient gout with respect to the outputs of a transfer, find the gradient gin with respect to its inputs.
+// ins and outs are the inputs and outputs of the transfer; the cases are those of transfer() in feedforward.c.
+static void
+TransferSlope (int fchoice, const sigtype * ins, const flotype * outs,
+               const flotype * gout, flotype * gin, size_t width)
+{
+  size_t count;
+  switch (fchoice)
+    {
+    case 0:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count];
+      break;                    // identity
+    case 1:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count] * (ONE - outs[count] * outs[count]);
+      break;                    // tanh sigmoid
+    case 2:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count] / (ONE + ins[count] * ins[count]);
+      break;                    // arctangent sigmoid
+    case 3:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count] * outs[count] * (ONE - outs[count]);
+      break;                    // unsigned logistic sigmoid
+    case 4:
+      for (count = 0; count < width; count++)
+        gin[count] =
+          gout[count] * (ONE - outs[count] * outs[count]) / TWO;
+      break;                    // signed logistic sigmoid
+    case 5:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count] / ((ONE + absolute (ins[count])) *
+                                    (ONE + absolute (ins[count])));
+      break;                    // softsign sigmoid
+    case 6:
+      for (count = 0; count < width; count++)
+        gin[count] = ins[count] + ONE == ZERO ? ZERO :
+          ins[count] > ZERO ? gout[count] / (ins[count] + ONE) :
+          -gout[count] / (ins[count] + ONE);
+      break;                    // mirrored logarithmic transfer
+    case 7:
+      for (count = 0; count < width; count++)
+        gin[count] = ZERO;
+      break;                    // signed step function
+    case 8:
+      for (count = 0; count < width; count++)
+        gin[count] = ins[count] > ZERO ? gout[count] : ZERO;
+      break;                    // rectified linear unit
+    case 9:
+      for (count = 0; count < width; count++)
+        gin[count] = gout[count] / (ONE + exponential (-ins[count]));
+      break;                    // softplus rectifier
+    case 10:
+      for (count = 0; count < width; count++)
+        gin[count] = ins[count] >= ONE ? gout[count] / ins[count] : ZERO;
+      break;                    // logarithmic rectifier
+    case 11:
+      for (count = 0; count < width; count++)
+        gin[count] = -gout[count] * sine (ins[count]);
+      break;                    // sinusoid Radial Bias Function
+    case 12:
+      for (count = 0; count < width; count++)
+        gin[count] = -TWO * ins[count] * outs[count] * gout[count];
+      break;                    // gaussian Radial Bias Function
+    case 13:
+      for (count = 0; count < width; count++)
+        gin[count] = ins[count] == ZERO ? ZERO :
+          gout[count] * ins[count] * (TWO * logarithm (ins[count]) + ONE);
+      break;                    // thin plate spline Radial Bias Function
+    case 14:
+      gin[0] = ZERO;
+      for (count = 1; count < width; count++)
+        {
+          gin[count] = gout[count] * ins[0];
+          gin[0] += gout[count] * ins[count];
+        }
+      break;                    // multiplication by first input.
+    case 15:
+      for (count = 0; count < width; count++)
+        gin[count] = ZERO;
+      for (count = 0; count + 1 < width; count += 2)
+        {
+          gin[count] = gout[count] * ins[count + 1] + gout[count + 1];
+          gin[count + 1] = gout[count] * ins[count] + gout[count + 1];
+        }
+      break;                    // parallel pairwise addition & multiplication.
+    default:
+      Complain ("unknown transfer function\n");
+      Fail (1);
+    }
+}
+
+// start computing gradients for net, in windows of window steps storing the activations of every interval-th step.
+struct bptt *
+StartBptt (struct nnet *net, size_t window, size_t interval)
+{
+  assert (net != NULL);
+  assert (window > 0);
+  assert (interval > 0 && interval <= window);
+  struct bptt *bp = (struct bptt *) Allocate (1, sizeof (struct bptt));
+  size_t nodes = net->nodecount;
+  size_t node = 1;
+  bp->net = net;
+  bp->window = window;
+  bp->interval = interval;
+  bp->fired = (unsigned int *) Allocate (net->synapsecount,
+                                         sizeof (unsigned int));
+  for (size_t conn = 0; conn < net->synapsecount; conn++)
+    {                           // the order in which fwdprop fires nodes.
+      while (node <= net->sources[conn])
+        node += net->transferwidths[node];
+      bp->fired[conn] = node;
+    }
+  bp->inputs = (flotype *) Allocate (window * net->inputcount,
+                                     sizeof (flotype));
+  bp->targets = (flotype *) Allocate (window * net->outputcount,
+                                      sizeof (flotype));
+  bp->activations = (sigtype *) Allocate (nodes, sizeof (sigtype));
+  bp->stored = (sigtype *) Allocate (((window + interval - 1) / interval) *
+                                     nodes, sizeof (sigtype));
+  bp->replay = (sigtype *) Allocate (nodes, sizeof (sigtype));
+  bp->pre = (sigtype *) Allocate (interval * nodes, sizeof (sigtype));
+  bp->res = (flotype *) Allocate (interval * nodes, sizeof (flotype));
+  bp->nextpre = (sigtype *) Allocate (nodes, sizeof (sigtype));
+  bp->gpre = (flotype *) Allocate (nodes, sizeof (flotype));
+  bp->gnext = (flotype *) Allocate (nodes, sizeof (flotype));
+  bp->gres = (flotype *) Allocate (nodes, sizeof (flotype));
+  bp->outputs = (flotype *) Allocate (net->outputcount, sizeof (flotype));
+  bp->gradient = (flotype *) Allocate (net->synapsecount, sizeof (flotype));
+  init_activations (net, bp->activations);
+  return (bp);
+}
+
+// feed one step with the given inputs and target outputs.  Ends the window if this step fills it.
+void
+BpttStep (struct bptt *bp, const flotype * inputs, const flotype * targets)
+{
+  assert (bp != NULL);
+  const struct nnet *net = bp->net;
+  if (bp->steps % bp->interval == 0)
+    memcpy (&(bp->stored[(bp->steps / bp->interval) * net->nodecount]),
+            bp->activations, sizeof (sigtype) * net->nodecount);
+  memcpy (&(bp->inputs[bp->steps * net->inputcount]), inputs,
+          sizeof (flotype) * net->inputcount);
+  memcpy (&(bp->targets[bp->steps * net->outputcount]), targets,
+          sizeof (flotype) * net->outputcount);
+  fwdprop (net, inputs, bp->activations, bp->res, bp->outputs);
+  for (size_t out = 0; out < net->outputcount; out++)
+    {
+      double diff = (double) bp->outputs[out] - (double) targets[out];
+      bp->sqerr += diff * diff;
+    }
+  bp->scoredvals += net->outputcount;
+  if (++(bp->steps) == bp->window)
+    EndBpttWindow (bp);
+}
+
+// find the gradient with respect to the accumulated inputs of the nodes from first up to (not including) last, which
+// fire together between two synapses.
+static void
+BackFire (struct bptt *bp, size_t first, size_t last, const sigtype * pre,
+          const flotype * res)
+{
+  const struct nnet *net = bp->net;
+  for (size_t node = first; node < last; node += net->transferwidths[node])
+    TransferSlope (net->transfer[node], &(pre[node]), &(res[node]),
+                   &(bp->gres[node]), &(bp->gpre[node]),
+                   net->transferwidths[node]);
+}
+
+// backpropagate one step, whose accumulated inputs and node outputs are pre and res, through the operations of fwdprop
+// in reverse order.  nextpre holds the accumulated inputs of the following step, and bp->gnext the gradient with
+// respect to them; connections made after their destination fired in this step fed the following step.
+static void
+BackStep (struct bptt *bp, const sigtype * pre, const flotype * res,
+          const sigtype * nextpre, const flotype * targets)
+{
+  const struct nnet *net = bp->net;
+  size_t first = net->nodecount - net->outputcount;
+  size_t node = net->nodecount;
+  memset (bp->gres, 0, sizeof (flotype) * net->nodecount);
+  memset (bp->gpre, 0, sizeof (flotype) * net->nodecount);
+  for (size_t out = 0; out < net->outputcount; out++)
+    bp->gres[first + out] = res[first + out] - targets[out];
+  for (size_t conn = net->synapsecount; conn-- > 0;)
+    {
+      BackFire (bp, bp->fired[conn], node, pre, res);
+      node = bp->fired[conn];
+      unsigned int from = net->sources[conn];
+      unsigned int to = net->dests[conn];
+      flotype slope = to >= node ? bp->gpre[to] : bp->gnext[to];
+      if (slope == ZERO)
+        continue;
+      slope *= CombineSlope (net->accum[to], res[from] * net->weights[conn],
+                             to >= node ? pre[to] : nextpre[to]);
+      bp->gradient[conn] += slope * res[from];
+      bp->gres[from] += slope * net->weights[conn];
+    }
+  BackFire (bp, 1, node, pre, res);
+}
+
+// backpropagate the steps fed since the window began, adding their gradient to bp->gradient.  Each segment of interval
+// steps is recomputed from the activations stored for its first step, last segment first.
+void
+EndBpttWindow (struct bptt *bp)
+{
+  assert (bp != NULL);
+  const struct nnet *net = bp->net;
+  size_t nodes = net->nodecount;
+  if (bp->steps == 0)
+    return;
+  memset (bp->gnext, 0, sizeof (flotype) * nodes);      // truncated: later steps are not part of this window.
+  for (size_t segment = (bp->steps + bp->interval - 1) / bp->interval;
+       segment-- > 0;)
+    {
+      size_t start = segment * bp->interval;
+      size_t len = MIN (bp->interval, bp->steps - start);
+      memcpy (bp->replay, &(bp->stored[segment * nodes]),
+              sizeof (sigtype) * nodes);
+      for (size_t step = 0; step < len; step++)
+        fwdprop_record (net, &(bp->inputs[(start + step) * net->inputcount]),
+                        bp->replay, &(bp->pre[step * nodes]),
+                        &(bp->res[step * nodes]), bp->outputs);
+      for (size_t step = len; step-- > 0;)
+        {
+          flotype *swap;
+          double began = PROFILE_START (net);
+          BackStep (bp, &(bp->pre[step * nodes]), &(bp->res[step * nodes]),
+                    step + 1 < len ? &(bp->pre[(step + 1) * nodes]) :
+                    bp->nextpre,
+                    &(bp->targets[(start + step) * net->outputcount]));
+          PROFILE_STOP (net, PROF_BACKWARD, began);
+          swap = bp->gnext;
+          bp->gnext = bp->gpre;
+          bp->gpre = swap;
+        }
+      memcpy (bp->nextpre, bp->pre, sizeof (sigtype) * nodes);
+    }
+  bp->steps = 0;
+  bp->windows++;
+}
+
+// end the current sequence: backpropagate the window in progress and start the next step from a resting network.
+void
+ResetBptt (struct bptt *bp)
+{
+  assert (bp != NULL);
+  EndBpttWindow (bp);
+  init_activations (bp->net, bp->activations);
+}
+
+// move the network's weights rate times the accumulated gradient downhill, and clear the gradient.
+void
+DescendGradient (struct bptt *bp, flotype rate)
+{
+  assert (bp != NULL);
+  struct nnet *net = bp->net;
+  double began = PROFILE_START (net);
+  for (size_t conn = 0; conn < net->synapsecount; conn++)
+    {
+      net->weights[conn] -= rate * bp->gradient[conn];
+      bp->gradient[conn] = ZERO;
+    }
+  PROFILE_STOP (net, PROF_UPDATE, began);
+}
+
+void
+FinishBptt (struct bptt *bp)
+{
+  if (bp == NULL)
+    return;
+  free (bp->fired);
+  free (bp->inputs);
+  free (bp->targets);
+  free (bp->activations);
+  free (bp->stored);
+  free (bp->replay);
+  free (bp->pre);
+  free (bp->res);
+  free (bp->nextpre);
+  free (bp->gpre);
+  free (bp->gnext);
+  free (bp->gres);
+  free (bp->outputs);
+  free (bp->gradient);
+  free (bp);
+}
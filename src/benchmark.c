@@ -0,0 +1,234 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// helpers shared by the benchmark programs, nnetbench and optbench.
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "includes.h"
+#include "defines.h"
+#include "benchmark.h"
+#include "testnet.h"
+
+// the old engine prints as it parses and trains; quiet sends stdout to /dev/null until loud restores it.
+static int savedout = -1;
+
+void
+Quiet (void)
+{
+  fflush (stdout);
+  savedout = dup (STDOUT_FILENO);
+  int null = open ("/dev/null", O_WRONLY);
+  dup2 (null, STDOUT_FILENO);
+  close (null);
+}
+
+void
+Loud (void)
+{
+  fflush (stdout);
+  dup2 (savedout, STDOUT_FILENO);
+  close (savedout);
+}
+
+// write a gneural_network script for a fully connected network with the given layer sizes, and MAX_TRAINING_CASES
+// random training cases.
+char *
+LayeredScript (const int *sizes, int layers)
+{
+  char *text = NULL;
+  size_t length;
+  FILE *out = open_memstream (&text, &length);
+  int first[MAX_NUM_LAYERS + 1];
+  int total = 0;
+  if (out == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in LayeredScript.\n");
+      exit (1);
+    }
+  for (int layer = 0; layer < layers; layer++)
+    {
+      first[layer] = total;
+      total += sizes[layer];
+    }
+  first[layers] = total;
+  fprintf (out, "NUMBER_OF_NEURONS %d\n", total);
+  for (int layer = 0; layer < layers; layer++)
+    for (int id = first[layer]; id < first[layer + 1]; id++)
+      fprintf (out, "NEURON %d NUMBER_OF_CONNECTIONS %d\n", id,
+               layer == 0 ? 1 : sizes[layer - 1]);
+  for (int id = sizes[0]; id < total; id++)
+    fprintf (out, "NEURON %d ACTIVATION TANH\n", id);
+  for (int id = sizes[0]; id < total; id++)
+    fprintf (out, "NEURON %d ACCUMULATOR LINEAR\n", id);
+  fprintf (out, "NETWORK NUMBER_OF_LAYERS %d\n", layers);
+  for (int layer = 0; layer < layers; layer++)
+    fprintf (out, "NETWORK LAYER %d NUMBER_OF_NEURONS %d\n", layer,
+             sizes[layer]);
+  for (int layer = 0; layer < layers; layer++)
+    for (int id = first[layer]; id < first[layer + 1]; id++)
+      fprintf (out, "NETWORK ASSIGN_NEURON_TO_LAYER %d %d %d\n", layer,
+               id - first[layer], id);
+  for (int layer = 1; layer < layers; layer++)
+    for (int id = first[layer]; id < first[layer + 1]; id++)
+      for (int from = first[layer - 1]; from < first[layer]; from++)
+        fprintf (out, "NEURON %d CONNECTION %d %d\n", id,
+                 from - first[layer - 1], from);
+  fprintf (out, "NUMBER_OF_TRAINING_CASES %d\n", MAX_TRAINING_CASES);
+  for (int c = 0; c < MAX_TRAINING_CASES; c++)
+    for (int id = 0; id < sizes[0]; id++)
+      fprintf (out, "TRAINING_CASE IN %d %d 0 %.6f\n", c, id,
+               Uniform (-1.0, 1.0));
+  for (int c = 0; c < MAX_TRAINING_CASES; c++)
+    for (int id = first[layers - 1]; id < total; id++)
+      fprintf (out, "TRAINING_CASE OUT %d %d %.6f\n", c, id,
+               Uniform (-0.5, 0.5));
+  fprintf (out, "INITIAL_WEIGHTS_RANDOMIZATION ON\nWEIGHT_MINIMUM -1.0\n"
+           "WEIGHT_MAXIMUM +1.0\nERROR_TYPE MSE\n"
+           "TRAINING_METHOD RANDOM_SEARCH OFF 1 1.e-300\n");
+  fclose (out);
+  return (text);
+}
+
+// set config up for method (an enum optimization_method) to run count of its iterations, and return how many it will
+// run.  The verbosity and accuracy are left to the caller.
+size_t
+SetOptimizer (network_config * config, int method, size_t count)
+{
+  config->optimization_type = method;
+  switch (method)
+    {
+    case RANDOM_SEARCH:        // attempts.
+      config->nmax = count;
+      break;
+    case SIMULATED_ANNEALING:  // temperature steps of 10 configurations.
+      config->mmax = MAX (2, count);
+      config->nmax = 10;
+      config->kbtmin = 1.e-4;
+      config->kbtmax = 1.0;
+      count = config->mmax;
+      break;
+    case GRADIENT_DESCENT:     // descent steps.
+      config->nxw = 100;
+      config->maxiter = count;
+      config->gamma = 0.01;
+      break;
+    case GENETIC_ALGORITHM:    // generations of 16 individuals.
+      config->nmax = count;
+      config->npop = 16;
+      config->rate = 0.1;
+      break;
+    case MSMCO:                // outer iterations of 10 trials, each narrowing the search by gamma.
+      config->mmax = count;
+      config->nmax = 10;
+      config->gamma = 0.5;
+      break;
+    }
+  return (count);
+}
+
+// open the hardware counters for this process and the threads it starts, counting in user space only.  Returns how
+// many events could be opened; where none could, errno says why.  Events left unopened read as zero.
+int
+OpenCounters (struct counters *ct)
+{
+  int opened = 0;
+  for (int event = 0; event < COUNTERS; event++)
+    {
+      ct->fd[event] = -1;
+      ct->value[event] = 0;
+    }
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  static const uint64_t configs[COUNTERS] = {
+    [COUNTER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+    [COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    [COUNTER_LLC_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    [COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES
+  };
+  int failure = 0;
+  for (int event = 0; event < COUNTERS; event++)
+    {
+      struct perf_event_attr attr;
+      memset (&attr, 0, sizeof (struct perf_event_attr));
+      attr.size = sizeof (struct perf_event_attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[event];
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      ct->fd[event] = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+      if (ct->fd[event] >= 0)
+        opened++;
+      else if (failure == 0)
+        failure = errno;
+    }
+  if (opened == 0)
+    errno = failure;
+#else
+  errno = ENOSYS;
+#endif
+  return (opened);
+}
+
+void
+StartCounters (struct counters *ct)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  for (int event = 0; event < COUNTERS; event++)
+    if (ct->fd[event] >= 0)
+      {
+        ioctl (ct->fd[event], PERF_EVENT_IOC_RESET, 0);
+        ioctl (ct->fd[event], PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+}
+
+void
+StopCounters (struct counters *ct)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  for (int event = 0; event < COUNTERS; event++)
+    if (ct->fd[event] >= 0)
+      {
+        ioctl (ct->fd[event], PERF_EVENT_IOC_DISABLE, 0);
+        if (read (ct->fd[event], &(ct->value[event]), sizeof (uint64_t)) !=
+            sizeof (uint64_t))
+          ct->value[event] = 0;
+      }
+#endif
+}
+
+void
+CloseCounters (struct counters *ct)
+{
+  for (int event = 0; event < COUNTERS; event++)
+    if (ct->fd[event] >= 0)
+      {
+        close (ct->fd[event]);
+        ct->fd[event] = -1;
+      }
+}
@@ -0,0 +1,245 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// binary case files: mapping them in place of parsing, and converting text or Immediate data sets to them.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes.h"
+#include "defines.h"
+#include "casestream.h"
+#include "casefile.h"
+
+// read the header of a file.  Returns 1 if the file starts with a case file header, 0 otherwise.
+static int
+ReadCaseFileHeader (int fd, struct casefileheader *hdr)
+{
+  if (pread (fd, hdr, sizeof (struct casefileheader), 0) !=
+      sizeof (struct casefileheader))
+    return (0);
+  return (memcmp (hdr->magic, CASEFILE_MAGIC, sizeof (hdr->magic)) == 0);
+}
+
+// Returns 1 if name is a binary case file.
+int
+IsCaseFile (const char *name)
+{
+  struct casefileheader hdr;
+  int retval;
+  int fd = open (name, O_RDONLY);
+  if (fd < 0)
+    return (0);
+  retval = ReadCaseFileHeader (fd, &hdr);
+  close (fd);
+  return (retval);
+}
+
+// If the FromFile source of dat is a binary case file, map it and point dat->data at the mapped values.  The mapping is
+// read-only and shared, so concurrent runs on the same file share its pages.  Returns 0 (leaving dat untouched) if the
+// file is not a case file.
+int
+MapCaseFile (struct cases *dat)
+{
+  assert (dat != NULL);
+  assert (dat->inname != NULL);
+  struct casefileheader hdr;
+  struct stat st;
+  size_t length;
+  void *map;
+  int fd = open (dat->inname, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf (stderr, "unable to open data file %s\n", dat->inname);
+      exit (1);
+    }
+  if (!ReadCaseFileHeader (fd, &hdr))
+    {
+      close (fd);
+      return (0);
+    }
+  if (hdr.version != CASEFILE_VERSION || hdr.endian != CASEFILE_ENDIAN)
+    {
+      fprintf (stderr,
+               "%s was written by a different version of nnet or on a machine with a different byte order.\n",
+               dat->inname);
+      exit (1);
+    }
+  if (hdr.precision != sizeof (flotype))
+    {
+      fprintf (stderr,
+               "%s holds %u-byte values, but this is a " FLOTYPE_NAME
+               " precision build of nnet.  Convert it again with nnet --convert.\n",
+               dat->inname, hdr.precision);
+      exit (1);
+    }
+  if (hdr.inputcount != dat->inputcount
+      || hdr.outputcount != dat->outputcount)
+    {
+      fprintf (stderr,
+               "%s holds cases of %" PRIu64 " inputs and %" PRIu64
+               " outputs, but the Data statement reads %zu inputs and %zu outputs.\n",
+               dat->inname, hdr.inputcount, hdr.outputcount, dat->inputcount,
+               dat->outputcount);
+      exit (1);
+    }
+  // the counts match the Data statement, so casebytes is small; entrycount is checked against the file size by
+  // division, since a damaged one could overflow the product.
+  uint64_t casebytes = (hdr.inputcount + hdr.outputcount) * hdr.precision;
+  if (fstat (fd, &st) != 0
+      || hdr.dataoffset != sizeof (struct casefileheader)
+      || (uint64_t) st.st_size < hdr.dataoffset
+      || (casebytes != 0 && hdr.entrycount >
+          ((uint64_t) st.st_size - hdr.dataoffset) / casebytes))
+    {
+      fprintf (stderr, "%s is truncated or damaged.\n", dat->inname);
+      exit (1);
+    }
+  length = hdr.dataoffset + hdr.entrycount * casebytes;
+  map = mmap (NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      fprintf (stderr, "unable to map data file %s\n", dat->inname);
+      exit (1);
+    }
+  posix_madvise (map, length, POSIX_MADV_SEQUENTIAL);
+  dat->data = (flotype *) ((char *) map + hdr.dataoffset);
+  dat->entrycount = hdr.entrycount;
+  dat->flags |= DATA_MAPPED | DATA_SEEKABLE;
+  return (1);
+}
+
+// Release the mapping made by MapCaseFile.
+void
+UnmapCaseFile (struct cases *dat)
+{
+  assert (dat != NULL);
+  assert ((dat->flags & DATA_MAPPED) != 0);
+  munmap ((char *) dat->data - sizeof (struct casefileheader),
+          sizeof (struct casefileheader) + sizeof (flotype) *
+          dat->entrycount * (dat->inputcount + dat->outputcount));
+  dat->data = NULL;
+  dat->entrycount = 0;
+  dat->flags &= ~(DATA_MAPPED | DATA_SEEKABLE);
+}
+
+// Write every case of dat to the binary case file name.  Reads through a casestream, so text files of any size can be
+// converted.  Returns the number of cases written.
+size_t
+WriteCaseFile (struct cases *dat, const char *name)
+{
+  assert (dat != NULL);
+  assert (name != NULL);
+  struct casefileheader hdr;
+  size_t casesize = dat->inputcount + dat->outputcount;
+  size_t count;
+  flotype *rows;
+  FILE *out = fopen (name, "wb");
+  if (out == NULL)
+    {
+      fprintf (stderr, "unable to open %s\n", name);
+      exit (1);
+    }
+  memset (&hdr, 0, sizeof (struct casefileheader));
+  memcpy (hdr.magic, CASEFILE_MAGIC, sizeof (hdr.magic));
+  hdr.version = CASEFILE_VERSION;
+  hdr.endian = CASEFILE_ENDIAN;
+  hdr.precision = sizeof (flotype);
+  hdr.inputcount = dat->inputcount;
+  hdr.outputcount = dat->outputcount;
+  hdr.dataoffset = sizeof (struct casefileheader);
+  fwrite (&hdr, sizeof (struct casefileheader), 1, out);
+  struct casestream *cs = OpenCaseStream (dat, STREAM_BATCH, STREAM_RING);
+  while ((rows = NextCaseBatch (cs, &count)) != NULL)
+    {
+      if (fwrite (rows, sizeof (flotype) * casesize, count, out) != count)
+        {
+          fprintf (stderr, "error writing %s\n", name);
+          exit (1);
+        }
+      hdr.entrycount += count;
+    }
+  CloseCaseStream (cs);
+  // now that the number of cases is known, rewrite the header.
+  if (fseek (out, 0, SEEK_SET) != 0
+      || fwrite (&hdr, sizeof (struct casefileheader), 1, out) != 1
+      || fclose (out) != 0)
+    {
+      fprintf (stderr, "error writing %s\n", name);
+      exit (1);
+    }
+  return (hdr.entrycount);
+}
+
+// Convert the data sets of a parsed script to binary case files.  A FromFile source "name" becomes "name.nnc"; the Nth
+// Data statement of the script, if it is Immediate, becomes "scriptname.N.nnc" (scriptname without its .nnet extension).
+// Data statements may then be changed to read the converted files with FromFile.
+void
+ConvertDataSets (struct nnet *net, const char *scriptname)
+{
+  assert (net != NULL);
+  assert (scriptname != NULL);
+  size_t statements = 0;
+  size_t index = 0;
+  size_t namelen = strlen (scriptname);
+  char *outname;
+  struct cases *dat;
+  for (dat = net->data; dat != NULL; dat = dat->next)
+    statements++;
+  if (namelen > 5 && strcmp (&(scriptname[namelen - 5]), ".nnet") == 0)
+    namelen -= 5;
+  for (dat = net->data; dat != NULL; dat = dat->next, index++)
+    {
+      size_t number = statements - index;       // the list is in reverse script order.
+      if ((dat->flags & DATA_IMMEDIATE) != 0)
+        {
+          outname = malloc (namelen + 32);
+          if (outname != NULL)
+            snprintf (outname, namelen + 32, "%.*s.%zu" CASEFILE_EXT,
+                      (int) namelen, scriptname, number);
+        }
+      else if ((dat->flags & DATA_FROMFILE) != 0)
+        {
+          if (IsCaseFile (dat->inname))
+            continue;
+          outname = malloc (strlen (dat->inname) + sizeof (CASEFILE_EXT));
+          if (outname != NULL)
+            sprintf (outname, "%s" CASEFILE_EXT, dat->inname);
+        }
+      else
+        {
+          fprintf (stderr,
+                   "Data statement %zu: only Immediate and FromFile data can be converted.\n",
+                   number);
+          continue;
+        }
+      if (outname == NULL)
+        {
+          fprintf (stderr,
+                   "Runtime Error: Allocation failure in ConvertDataSets.\n");
+          exit (1);
+        }
+      printf ("Data statement %zu: wrote %zu cases to %s\n", number,
+              WriteCaseFile (dat, outname), outname);
+      free (outname);
+    }
+}
@@ -0,0 +1,438 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// batched delivery of data cases to plans, with a background reader for data files.
+
+#include <dirent.h>
+#include "includes.h"
+#include "defines.h"
+#include "parser.h"
+#include "casestream.h"
+#include "casefile.h"
+
+// State for reading the cases of one text data file, in either of its two forms.
+struct casereader
+{
+  struct cases *source;
+  const char *name;
+  size_t casesize;
+  int columnar;
+  struct slidingbuffer bf;      // bracket form
+  struct conf cfg;
+  char *line;                   // columnar form
+  size_t linecap;
+  size_t lineno;
+};
+
+// Data files may be written in the same [[inputs][outputs]] grammar as Immediate data, or as plain columns with one case
+// per line.  Peek at the first character that isn't whitespace or comment to tell which, then rewind.
+static int
+DataIsColumnar (FILE * input)
+{
+  int ch;
+  int incomment = 0;
+  while ((ch = fgetc (input)) != EOF)
+    {
+      if (ch == '#')
+        incomment = 1;
+      else if (ch == '\n')
+        incomment = 0;
+      else if (!incomment && !isspace (ch))
+        break;
+    }
+  rewind (input);
+  return (ch != EOF && ch != '[');
+}
+
+static void
+StartReader (struct casereader *rd, struct cases *dat, const char *name,
+             FILE * input)
+{
+  memset (rd, 0, sizeof (struct casereader));
+  rd->source = dat;
+  rd->name = name;
+  rd->casesize = dat->inputcount + dat->outputcount;
+  rd->columnar = DataIsColumnar (input);
+  rd->bf.input = input;
+  rd->bf.line = 1;              // data files aren't echoed, so number their lines as editors do.
+  rd->cfg.flags = SILENCE_ECHO;
+}
+
+static void
+StopReader (struct casereader *rd)
+{
+  free (rd->line);
+  rd->line = NULL;
+}
+
+// read one whitespace-separated line of casesize values.  Blank lines and '#' comments are skipped.  Returns 0 at end of
+// input.
+static int
+ReadColumnarCase (struct casereader *rd, flotype * target)
+{
+  char *cursor;
+  char *end;
+  char *comment;
+  size_t count;
+  double value;
+  while (getline (&(rd->line), &(rd->linecap), rd->bf.input) != -1)
+    {
+      ++(rd->lineno);
+      if ((comment = strchr (rd->line, '#')) != NULL)
+        *comment = 0;
+      for (count = 0, cursor = rd->line;; cursor = end, count++)
+        {
+          value = strtod (cursor, &end);
+          if (end == cursor)
+            break;
+          if (fabs (value) > FLOTYPE_MAX)
+            {
+              fprintf (stderr,
+                       "\n%s line %zu : Float value in data exceeds float range.\n",
+                       rd->name, rd->lineno);
+              exit (1);
+            }
+          if (count < rd->casesize)
+            target[count] = (flotype) value;
+        }
+      while (isspace (*cursor))
+        cursor++;
+      if (*cursor != 0)
+        {
+          fprintf (stderr, "\n%s line %zu : Non-numeric value in data.\n",
+                   rd->name, rd->lineno);
+          exit (1);
+        }
+      if (count == 0)
+        continue;
+      if (count != rd->casesize)
+        {
+          fprintf (stderr,
+                   "\n%s line %zu : Expected %zu values per case, found %zu.\n",
+                   rd->name, rd->lineno, rd->casesize, count);
+          exit (1);
+        }
+      return (1);
+    }
+  return (0);
+}
+
+// read one [[inputs][outputs]] case.  Returns 0 at end of input.
+static int
+ReadBracketCase (struct casereader *rd, flotype * target)
+{
+  struct slidingbuffer *bf = &(rd->bf);
+  if (ReadCaseValues
+      (bf, &(rd->cfg), rd->source->inputcount, rd->source->outputcount,
+       target))
+    return (1);
+  if (!ChAvailable (bf, 1))
+    return (0);
+  fprintf (stderr, "\nIn data file %s:", rd->name);
+  ErrStopParsing (bf, "Expected '[' at start of data case.", NULL);
+  return (0);
+}
+
+// read up to max cases into target.  Returns the number read; fewer than max means the end of the file was reached.
+static size_t
+ReadCases (struct casereader *rd, flotype * target, size_t max)
+{
+  size_t count;
+  for (count = 0; count < max; count++)
+    if (!(rd->columnar ?
+          ReadColumnarCase (rd, &(target[count * rd->casesize])) :
+          ReadBracketCase (rd, &(target[count * rd->casesize]))))
+      break;
+  return (count);
+}
+
+// Reader thread.  Fills the ring slot after the last one published, waiting whenever the consumer has not yet finished
+// with the oldest slot.
+static void *
+CaseReader (void *arg)
+{
+  struct casestream *cs = (struct casestream *) arg;
+  struct casereader rd;
+  int atend = 0;
+  StartReader (&rd, cs->source, cs->source->inname, cs->input);
+  while (!atend)
+    {
+      pthread_mutex_lock (&cs->lock);
+      while (!cs->stop && cs->filled - cs->drained == cs->ringsize)
+        pthread_cond_wait (&cs->changed, &cs->lock);
+      if (cs->stop)
+        {
+          pthread_mutex_unlock (&cs->lock);
+          break;
+        }
+      size_t slot = cs->filled % cs->ringsize;
+      pthread_mutex_unlock (&cs->lock);
+      size_t count =
+        ReadCases (&rd, &(cs->ring[slot * cs->batchsize * cs->casesize]),
+                   cs->batchsize);
+      atend = (count < cs->batchsize);
+      pthread_mutex_lock (&cs->lock);
+      cs->counts[slot] = count;
+      if (count != 0)
+        cs->filled++;
+      cs->finished = atend;
+      pthread_cond_broadcast (&cs->changed);
+      pthread_mutex_unlock (&cs->lock);
+    }
+  StopReader (&rd);
+  return (NULL);
+}
+
+// Read all of one file of a FromDirectory source into shard, which has the widths of the directory's data set.  Binary
+// case files are mapped; text files are read with doubling growth of the shard's buffer.
+static void
+LoadShard (struct cases *shard, const char *name)
+{
+  struct casereader rd;
+  size_t casesize = shard->inputcount + shard->outputcount;
+  size_t capacity = STREAM_BATCH;
+  size_t count;
+  FILE *input;
+  shard->inname = (char *) name;
+  if (MapCaseFile (shard))
+    return;
+  if (NULL == (input = fopen (name, "r")))
+    {
+      fprintf (stderr, "unable to open data file %s\n", name);
+      exit (1);
+    }
+  StartReader (&rd, shard, name, input);
+  shard->entrycount = 0;
+  shard->data = NULL;
+  do
+    {
+      if (shard->data == NULL || shard->entrycount == capacity)
+        {
+          if (shard->data != NULL)
+            capacity *= 2;
+          shard->data =
+            (flotype *) realloc (shard->data,
+                                 sizeof (flotype) * casesize * capacity);
+          if (shard->data == NULL)
+            {
+              fprintf (stderr,
+                       "Runtime Error: Allocation failure in LoadShard.\n");
+              exit (1);
+            }
+        }
+      count =
+        ReadCases (&rd, &(shard->data[shard->entrycount * casesize]),
+                   capacity - shard->entrycount);
+      shard->entrycount += count;
+    }
+  while (shard->entrycount == capacity);
+  StopReader (&rd);
+  fclose (input);
+}
+
+static int
+VisibleEntry (const struct dirent *entry)
+{
+  return (entry->d_name[0] != '.');
+}
+
+// Load every file of a FromDirectory source.  The files are read concurrently, one shard per file, by the OpenMP
+// worker threads, then concatenated in file name order into dat->data, where they stay for later plans.
+static void
+LoadDirectory (struct cases *dat)
+{
+  struct dirent **entries;
+  size_t casesize = dat->inputcount + dat->outputcount;
+  size_t dirlen = strlen (dat->inname);
+  int filecount = scandir (dat->inname, &entries, VisibleEntry, alphasort);
+  if (filecount < 0)
+    {
+      fprintf (stderr, "unable to read data directory %s\n", dat->inname);
+      exit (1);
+    }
+  struct cases *shards =
+    (struct cases *) calloc (filecount + 1, sizeof (struct cases));
+  char **names = (char **) calloc (filecount + 1, sizeof (char *));
+  if (shards == NULL || names == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in LoadDirectory.\n");
+      exit (1);
+    }
+  for (int file = 0; file < filecount; file++)
+    {
+      names[file] = malloc (dirlen + strlen (entries[file]->d_name) + 2);
+      if (names[file] == NULL)
+        {
+          fprintf (stderr,
+                   "Runtime Error: Allocation failure in LoadDirectory.\n");
+          exit (1);
+        }
+      sprintf (names[file], "%s/%s", dat->inname, entries[file]->d_name);
+      free (entries[file]);
+      shards[file].inputcount = dat->inputcount;
+      shards[file].outputcount = dat->outputcount;
+      shards[file].flags = DATA_FROMFILE;
+    }
+  free (entries);
+#pragma omp parallel for schedule(dynamic)
+  for (int file = 0; file < filecount; file++)
+    LoadShard (&(shards[file]), names[file]);
+  size_t total = 0;
+  for (int file = 0; file < filecount; file++)
+    total += shards[file].entrycount;
+  dat->data = (flotype *) malloc (sizeof (flotype) * casesize * total + 1);
+  if (dat->data == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in LoadDirectory.\n");
+      exit (1);
+    }
+  dat->entrycount = 0;
+  for (int file = 0; file < filecount; file++)
+    {
+      memcpy (&(dat->data[dat->entrycount * casesize]), shards[file].data,
+              sizeof (flotype) * casesize * shards[file].entrycount);
+      dat->entrycount += shards[file].entrycount;
+      if ((shards[file].flags & DATA_MAPPED) != 0)
+        UnmapCaseFile (&(shards[file]));
+      else
+        free (shards[file].data);
+      free (names[file]);
+    }
+  free (shards);
+  free (names);
+}
+
+// Open a data source for reading in batches of at most batchsize cases.  ringsize is the number of batch buffers the
+// reader thread may fill ahead of the consumer (only used for sources that need reading).
+struct casestream *
+OpenCaseStream (struct cases *dat, size_t batchsize, size_t ringsize)
+{
+  assert (dat != NULL);
+  assert (batchsize > 0);
+  assert (ringsize > 0);
+  struct casestream *cs =
+    (struct casestream *) calloc (1, sizeof (struct casestream));
+  if (cs == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure (1) in OpenCaseStream.\n");
+      exit (1);
+    }
+  cs->source = dat;
+  cs->casesize = dat->inputcount + dat->outputcount;
+  cs->batchsize = batchsize;
+  if (dat->data != NULL || (dat->flags & DATA_IMMEDIATE) != 0)
+    return (cs);                // cases are already in memory.
+  if ((dat->flags & DATA_FROMDIRECTORY) != 0)
+    {
+      LoadDirectory (dat);
+      return (cs);
+    }
+  if ((dat->flags & DATA_FROMFILE) == 0)
+    return (cs);                // FromPipe sources are served by ServeDeployment.
+  if (MapCaseFile (dat))
+    return (cs);                // binary case file, now mapped.
+  if (NULL == (cs->input = fopen (dat->inname, "r")))
+    {
+      fprintf (stderr, "unable to open data file %s\n", dat->inname);
+      exit (1);
+    }
+  cs->ringsize = ringsize;
+  cs->ring =
+    (flotype *) malloc (sizeof (flotype) * ringsize * batchsize *
+                        cs->casesize);
+  cs->counts = (size_t *) calloc (ringsize, sizeof (size_t));
+  if (cs->ring == NULL || cs->counts == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure (2) in OpenCaseStream.\n");
+      exit (1);
+    }
+  pthread_mutex_init (&cs->lock, NULL);
+  pthread_cond_init (&cs->changed, NULL);
+  if (pthread_create (&cs->reader, NULL, CaseReader, cs) != 0)
+    {
+      fprintf (stderr,
+               "Runtime Error: unable to start reader thread for %s\n",
+               dat->inname);
+      exit (1);
+    }
+  cs->threaded = 1;
+  return (cs);
+}
+
+// Return the next batch of cases and store the number of cases in it in *count, or return NULL when the source is
+// exhausted.  The batch stays valid until the next call; calling again hands the previous batch's buffer back to the
+// reader.
+flotype *
+NextCaseBatch (struct casestream *cs, size_t * count)
+{
+  assert (cs != NULL);
+  assert (count != NULL);
+  flotype *retval;
+  size_t slot;
+  if (!cs->threaded)
+    {
+      if (cs->source->data == NULL || cs->next >= cs->source->entrycount)
+        return (NULL);
+      *count = MIN (cs->batchsize, cs->source->entrycount - cs->next);
+      retval = &(cs->source->data[cs->next * cs->casesize]);
+      cs->next += *count;
+      return (retval);
+    }
+  pthread_mutex_lock (&cs->lock);
+  if (cs->taken > cs->drained)
+    {
+      cs->drained++;
+      pthread_cond_broadcast (&cs->changed);
+    }
+  while (cs->taken == cs->filled && !cs->finished)
+    pthread_cond_wait (&cs->changed, &cs->lock);
+  if (cs->taken == cs->filled)
+    {
+      pthread_mutex_unlock (&cs->lock);
+      return (NULL);
+    }
+  slot = cs->taken++ % cs->ringsize;
+  *count = cs->counts[slot];
+  pthread_mutex_unlock (&cs->lock);
+  return (&(cs->ring[slot * cs->batchsize * cs->casesize]));
+}
+
+// Stop the reader (if any) and release the stream.  Safe to call before the source is exhausted.
+void
+CloseCaseStream (struct casestream *cs)
+{
+  if (cs == NULL)
+    return;
+  if (cs->threaded)
+    {
+      pthread_mutex_lock (&cs->lock);
+      cs->stop = 1;
+      pthread_cond_broadcast (&cs->changed);
+      pthread_mutex_unlock (&cs->lock);
+      pthread_join (cs->reader, NULL);
+      pthread_mutex_destroy (&cs->lock);
+      pthread_cond_destroy (&cs->changed);
+      fclose (cs->input);
+    }
+  free (cs->ring);
+  free (cs->counts);
+  free (cs);
+}
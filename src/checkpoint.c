@@ -0,0 +1,275 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// saving scripts: naming savefiles, and writing saves on a background thread while training goes on.
+
+#include "includes.h"
+#include "defines.h"
+#include "save.h"
+#include "checkpoint.h"
+#include "profile.h"
+
+// if not serializing, filename = config->savename.
+// if serializing & there is a dot in the filename, last dot in filename is replaced with dot,++serial,dot
+// if serializing & there is no dot in the filename, the filename is extended with dot-serial.
+// if serializing, increment serial number in config.
+// filename is a 256-char buffer.
+void
+NameOutputFile (char *filename, struct conf *config)
+{
+  size_t lastdot = 0;
+  size_t len = strlen (config->savename);
+  size_t index = len;
+  size_t writeindex = 0;
+  if ((config->flags & SAVE_SERIALIZE) == 0)
+    {
+      strncpy (filename, config->savename, 255);
+      return;
+    }
+  for (index = 1; index <= len && config->savename[len - index] != '.';
+       index++);
+  lastdot = (config->savename[len - index] == '.') ? len - index : len;
+  for (index = 0; (index <= len) && writeindex < 256; index++)
+    if (index != lastdot)
+      {
+        filename[writeindex++] = config->savename[index];
+        if (index + 1 == len && lastdot == len)
+          writeindex +=
+            snprintf (&(filename[writeindex]), 255 - index, ".%d",
+                      ++(config->serialnum));
+      }
+    else
+      writeindex +=
+        snprintf (&(filename[writeindex]), 255 - index, ".%d.",
+                  ++(config->serialnum));
+  filename[writeindex] = 0;
+}
+
+// copy bytes from src into the buffer old, resized to fit.  Returns the buffer; NULL if src is NULL.
+static void *
+CopyArray (void *old, const void *src, size_t bytes)
+{
+  void *copy;
+  if (src == NULL)
+    {
+      free (old);
+      return (NULL);
+    }
+  copy = realloc (old, bytes != 0 ? bytes : 1);
+  if (copy == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in CopyArray.\n");
+      exit (1);
+    }
+  memcpy (copy, src, bytes);
+  return (copy);
+}
+
+// copy the live data set list into save.  Running a plan maps, unmaps and loads file and directory sources, changing
+// their flags, data and entrycount while the writer may be reading them, so the save gets its own copy of each list
+// entry.  Only Immediate data is written into a save, and it is never changed after parsing, so it is shared; other
+// sources keep just their flags and names.
+static struct cases *
+CopyDataSets (struct checkpoint *save, const struct cases *data)
+{
+  size_t count = 0;
+  for (const struct cases *current = data; current != NULL;
+       current = current->next)
+    count++;
+  save->data = (struct cases *) realloc (save->data, count != 0 ?
+                                         count * sizeof (struct cases) : 1);
+  if (save->data == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in CopyDataSets.\n");
+      exit (1);
+    }
+  save->datacount = count;
+  count = 0;
+  for (const struct cases *current = data; current != NULL;
+       current = current->next, count++)
+    {
+      struct cases *copy = &(save->data[count]);
+      *copy = *current;
+      if ((copy->flags & DATA_IMMEDIATE) == 0)
+        {
+          copy->data = NULL;
+          copy->entrycount = 0;
+        }
+      copy->inpipe = copy->outpipe = NULL;
+      copy->next = current->next != NULL ? copy + 1 : NULL;
+    }
+  return (count != 0 ? save->data : NULL);
+}
+
+// snapshot net and config into save, naming its savefile.  Only the caller's thread changes the network, so a plain
+// copy made here is consistent.  Plans are not changed while plans run, so they are shared; data sets are copied.
+static void
+TakeSnapshot (struct checkpoint *save, const struct nnet *net,
+              struct conf *config)
+{
+  struct nnet copy = *net;
+  copy.data = CopyDataSets (save, net->data);
+  copy.transfer =
+    CopyArray (save->net.transfer, net->transfer,
+               net->nodecount * sizeof (enum activation_function));
+  copy.accum =
+    CopyArray (save->net.accum, net->accum,
+               net->nodecount * sizeof (enum accumulator_function));
+  copy.transferwidths =
+    CopyArray (save->net.transferwidths, net->transferwidths,
+               net->nodecount * sizeof (unsigned int));
+  copy.weights =
+    CopyArray (save->net.weights, net->weights,
+               net->synapsecount * sizeof (flotype));
+  copy.sources =
+    CopyArray (save->net.sources, net->sources,
+               net->synapsecount * sizeof (unsigned int));
+  copy.dests =
+    CopyArray (save->net.dests, net->dests,
+               net->synapsecount * sizeof (unsigned int));
+  save->net = copy;
+  NameOutputFile (save->filename, config);
+  save->config = *config;
+  save->config.weightname = NULL;
+  if ((config->flags & SAVE_WEIGHTFILE) != 0)
+    {
+      size_t len = strnlen (save->filename, sizeof (save->filename) - 1);
+      memcpy (save->weightname, save->filename, len);
+      memcpy (&(save->weightname[len]), WEIGHTFILE_EXT,
+              sizeof (WEIGHTFILE_EXT));
+      save->config.weightname = save->weightname;
+    }
+}
+
+static void
+WriteCheckpoint (struct checkpoint *save)
+{
+  FILE *outf = fopen (save->filename, "w");
+  if (outf == NULL)
+    {
+      fprintf (stderr, "unable to open %s", save->filename);
+      exit (1);
+    }
+  setvbuf (outf, NULL, _IOFBF, 1 << 20);        // large networks are written in long runs.
+  nnetwriter (&(save->net), &(save->config), outf);
+  if (fclose (outf) != 0)
+    {
+      fprintf (stderr, "error writing %s\n", save->filename);
+      exit (1);
+    }
+}
+
+// the writer thread: write queued saves oldest first until told to stop and none are left.
+static void *
+CheckpointWriter (void *arg)
+{
+  struct checkpointer *cp = (struct checkpointer *) arg;
+  pthread_mutex_lock (&(cp->lock));
+  for (;;)
+    {
+      while (cp->pending == 0 && !cp->stop)
+        pthread_cond_wait (&(cp->changed), &(cp->lock));
+      if (cp->pending == 0)
+        break;
+      struct checkpoint *save = &(cp->queue[cp->first]);
+      pthread_mutex_unlock (&(cp->lock));
+      WriteCheckpoint (save);
+      pthread_mutex_lock (&(cp->lock));
+      cp->first = (cp->first + 1) % CHECKPOINT_QUEUE;
+      cp->pending--;
+      pthread_cond_broadcast (&(cp->changed));
+    }
+  pthread_mutex_unlock (&(cp->lock));
+  return (NULL);
+}
+
+// start a writer thread for saves of net.
+struct checkpointer *
+StartCheckpoints (struct nnet *net, struct conf *config)
+{
+  assert (net != NULL);
+  assert (config != NULL);
+  struct checkpointer *cp =
+    (struct checkpointer *) calloc (1, sizeof (struct checkpointer));
+  if (cp == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in StartCheckpoints.\n");
+      exit (1);
+    }
+  cp->net = net;
+  cp->config = config;
+  pthread_mutex_init (&(cp->lock), NULL);
+  pthread_cond_init (&(cp->changed), NULL);
+  if (pthread_create (&(cp->writer), NULL, CheckpointWriter, cp) != 0)
+    {
+      fprintf (stderr, "Runtime Error: unable to start checkpoint writer.\n");
+      exit (1);
+    }
+  return (cp);
+}
+
+// save the network as it is now.  Returns once the snapshot is queued, which is at once unless CHECKPOINT_QUEUE saves
+// are still waiting to be written.
+void
+Checkpoint (struct checkpointer *cp)
+{
+  assert (cp != NULL);
+  struct checkpoint *save;
+  double began = PROFILE_START (cp->net);
+  pthread_mutex_lock (&(cp->lock));
+  while (cp->pending == CHECKPOINT_QUEUE)
+    pthread_cond_wait (&(cp->changed), &(cp->lock));
+  // the writer only touches queued saves, so this slot is ours until it is queued.
+  save = &(cp->queue[(cp->first + cp->pending) % CHECKPOINT_QUEUE]);
+  pthread_mutex_unlock (&(cp->lock));
+  TakeSnapshot (save, cp->net, cp->config);
+  pthread_mutex_lock (&(cp->lock));
+  cp->pending++;
+  pthread_cond_broadcast (&(cp->changed));
+  pthread_mutex_unlock (&(cp->lock));
+  PROFILE_STOP (cp->net, PROF_CHECKPOINT, began);
+}
+
+// wait for every queued save to be written, then stop the writer and free the checkpointer.
+void
+FinishCheckpoints (struct checkpointer *cp)
+{
+  assert (cp != NULL);
+  pthread_mutex_lock (&(cp->lock));
+  cp->stop = 1;
+  pthread_cond_broadcast (&(cp->changed));
+  pthread_mutex_unlock (&(cp->lock));
+  pthread_join (cp->writer, NULL);
+  for (size_t index = 0; index < CHECKPOINT_QUEUE; index++)
+    {
+      struct nnet *copy = &(cp->queue[index].net);
+      free (copy->transfer);
+      free (copy->accum);
+      free (copy->transferwidths);
+      free (copy->weights);
+      free (copy->sources);
+      free (copy->dests);
+      free (cp->queue[index].data);
+    }
+  pthread_mutex_destroy (&(cp->lock));
+  pthread_cond_destroy (&(cp->changed));
+  free (cp);
+}
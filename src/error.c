@@ -64,8 +64,6 @@ error (network * nn, network_config * config)
             }
           err += tmp;
         }
-      return err;
-
       break;
       // Mean Squared Error
     case MSE:
@@ -95,10 +93,18 @@ error (network * nn, network_config * config)
             }
           err += tmp;
         }
-      return sqrt (err);
+      err = sqrt (err);
       break;
     default:
-      return 0.;
       break;
     }
+  // msmco calls error() from several threads at once.
+#pragma omp atomic
+  config->error_calls++;
+  if (config->error_seen != NULL)
+    {
+#pragma omp critical (error_seen)
+      config->error_seen (config->error_seen_arg, err);
+    }
+  return err;
 }
@@ -0,0 +1,61 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// error reporting that libgneural can intercept; see fail.h.
+
+#include <stdarg.h>
+#include "includes.h"
+#include "fail.h"
+
+__thread struct failtrap *failtrap = NULL;
+
+// report an error: to stderr, or to the armed trap's log without the newlines that set it apart on a terminal.
+void
+Complain (const char *format, ...)
+{
+  va_list args;
+  va_start (args, format);
+  if (failtrap == NULL)
+    vfprintf (stderr, format, args);
+  else
+    {
+      char *msg = failtrap->message;
+      vsnprintf (msg, sizeof (failtrap->message), format, args);
+      while (*msg == '\n')
+        msg++;
+      size_t length = strlen (msg);
+      while (length > 0 && msg[length - 1] == '\n')
+        msg[--length] = '\0';
+      memmove (failtrap->message, msg, length + 1);
+      if (failtrap->log != NULL)
+        failtrap->log (failtrap->logarg, GNEURAL_LOG_ERROR,
+                       failtrap->message);
+    }
+  va_end (args);
+}
+
+// stop after an error: exit with status, or unwind to the libgneural call that armed the trap.
+void
+Fail (int status)
+{
+  if (failtrap != NULL)
+    longjmp (failtrap->unwind, 1);
+  exit (status);
+}
@@ -0,0 +1,120 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// fastcheck: checks the approximations of fastmath.h against the system math library over the ranges the transfer
+// functions use them on, and at the special values, and fails if any is further off than fastmath.h says it can be.
+// Run by 'make check', built in double precision as fastcheck and in single precision as fastcheck_single.
+
+#include "includes.h"
+#include "defines.h"
+#include "fastmath.h"
+
+#define FASTCHECK_POINTS 1000000
+
+// the error bounds fastmath.h documents.
+#if defined(FLOTYPE_SINGLE) || defined(FLOTYPE_MIXED)
+#define BOUND_EXP  1e-7
+#define BOUND_LOG  3e-7
+#define BOUND_TANH 3e-7
+#define BOUND_ATAN 3e-7
+#else
+#define BOUND_EXP  1e-8
+#define BOUND_LOG  1e-8
+#define BOUND_TANH 3e-8
+#define BOUND_ATAN 5e-8
+#endif
+
+struct errors
+{
+  const char *name;
+  double bound;
+  double worst;                 // relative error.
+  double at;
+};
+
+static void
+Measure (struct errors *e, flotype x, flotype fast, double exact)
+{
+  double err = fast == exact ? 0.0 : fabs (fast - exact) / fabs (exact);
+  if (!(err <= e->worst))
+    {
+      e->worst = err;
+      e->at = x;
+    }
+}
+
+// whether fast differs from the library's result at a special value, rounded to flotype; NaN agrees with NaN.
+static int
+Special (const char *what, flotype fast, double exact)
+{
+  if ((isnan (fast) && isnan (exact)) || fast == (flotype) exact)
+    return (0);
+  printf ("fastcheck: %s gave %g, not %g\n", what, (double) fast, exact);
+  return (1);
+}
+
+int
+main (void)
+{
+  struct errors errs[4] = {
+    {"fastexp", BOUND_EXP, 0.0, 0.0},
+    {"fastlog", BOUND_LOG, 0.0, 0.0},
+    {"fasttanh", BOUND_TANH, 0.0, 0.0},
+    {"fastatan", BOUND_ATAN, 0.0, 0.0}
+  };
+  double limit = FASTEXP_LIMIT;
+  int failed = 0;
+  for (long point = 0; point <= FASTCHECK_POINTS; point++)
+    {
+      double u = 2.0 * point / FASTCHECK_POINTS - 1.0;  // -1 to 1.
+      flotype x = (flotype) (u * limit);
+      Measure (&(errs[0]), x, fastexp (x), exp ((double) x));
+      x = (flotype) exp (u * (limit - 8.0));    // positive normal numbers, spread over their exponents.
+      Measure (&(errs[1]), x, fastlog (x), log ((double) x));
+      x = (flotype) (20.0 * u * u * u); // denser near zero, where tanh and atan change fastest.
+      Measure (&(errs[2]), x, fasttanh (x), tanh ((double) x));
+      x = (flotype) (100.0 * u * u * u);
+      Measure (&(errs[3]), x, fastatan (x), atan ((double) x));
+    }
+  for (int fn = 0; fn < 4; fn++)
+    {
+      printf ("fastcheck (" FLOTYPE_NAME
+              "): %s worst relative error %.3g at %.9g, bound %g\n",
+              errs[fn].name, errs[fn].worst, errs[fn].at, errs[fn].bound);
+      failed |= !(errs[fn].worst <= errs[fn].bound);
+    }
+  failed |= Special ("fastlog(0)", fastlog (ZERO), -INFINITY);
+  failed |= Special ("fastlog(-1)", fastlog (-ONE), NAN);
+  failed |= Special ("fastlog(inf)", fastlog (INFINITY), INFINITY);
+  failed |= Special ("fastlog(nan)", fastlog (NAN), NAN);
+  failed |= Special ("fastlog(1)", fastlog (ONE), 0.0);
+  failed |= Special ("fasttanh(inf)", fasttanh (INFINITY), 1.0);
+  failed |= Special ("fasttanh(-inf)", fasttanh (-INFINITY), -1.0);
+  failed |= Special ("fasttanh(nan)", fasttanh (NAN), NAN);
+  failed |= Special ("fastatan(inf)", fastatan (INFINITY), atan (INFINITY));
+  failed |= Special ("fastatan(nan)", fastatan (NAN), NAN);
+  failed |= Special ("fastexp(nan)", fastexp (NAN), NAN);
+  if (!(isfinite (fastexp (INFINITY)) && fastexp (-INFINITY) > ZERO))
+    {
+      printf ("fastcheck: fastexp does not clamp infinite arguments\n");
+      failed = 1;
+    }
+  return (failed);
+}
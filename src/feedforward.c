@@ -27,6 +27,10 @@
 #include "binom.h"
 #include "fact.h"
 #include "activation.h"
+#include "fastmath.h"
+#include "quantize.h"
+#include "profile.h"
+#include "fail.h"
 
 #define PI M_PI
 
@@ -102,8 +106,8 @@ feedforward (network * nn)
 
 
 // input combining functions. Some widely used, some just plain strange.  Routine by Ray D. 6 September 2016
-flotype
-combine (const int combiner, const flotype currentval, const flotype ad)
+sigtype
+combine (const int combiner, const sigtype currentval, const flotype ad)
 {
   switch (combiner)
     {
@@ -124,8 +128,8 @@ combine (const int combiner, const flotype currentval, const flotype ad)
     case 7:
       return ad > 0 ? currentval + ad : currentval;     // ignore negative inputs
     default:
-      fprintf (stderr, "unknown combination function\n");
-      exit (1);
+      Complain ("unknown combination function\n");
+      Fail (1);
     }
 }
 
@@ -134,57 +138,87 @@ combine (const int combiner, const flotype currentval, const flotype ad)
 static inline flotype
 identity (const int combiner)
 {
-  return (combiner == 1) ? ONE : ZERO;
+  return (combiner == 2) ? ONE : ZERO;  // only Multiply starts from one.
 }
 
 // initialize an activation vector for use by a network. Routine by Ray D. 6 September 2016
 void
-init_activations (const struct nnet *const net, flotype * vec)
+init_activations (const struct nnet *const net, sigtype * vec)
 {
-#pragma omp parallel for
+#pragma omp simd
   for (size_t pos = 0; pos < net->nodecount; pos++)
-    vec[pos] = identity (net->transfer[pos]);
+    vec[pos] = identity (net->accum[pos]);
 }
 
-// most of the popular transfer functions, and a few deliberate peculiarities, vectorized for OMP.
-// Routine by Ray D. 6 September 2016
+// reset the nodes of the group starting at first, whose transfer has just run, so recurrent transfers start from the
+// identity element for their accumulator.  If pre is not NULL it gets what they had accumulated.  A group is only one
+// or a few nodes wide, far too little work to hand out to threads on every firing, so this stays on the calling thread.
+static inline void
+reset_fired (const struct nnet *const net, const size_t first,
+             sigtype * const activations, sigtype * const pre)
+{
+  const size_t last = first + net->transferwidths[first];
+  if (pre != NULL)
+    memcpy (&(pre[first]), &(activations[first]),
+            sizeof (sigtype) * (last - first));
+#pragma omp simd
+  for (size_t resetcount = first; resetcount < last; resetcount++)
+    activations[resetcount] = identity (net->accum[resetcount]);
+}
+
+// initialize a node-major activation vector (see fwdprop_batch) for a batch of cases.
+void
+init_activations_batch (const struct nnet *const net, sigtype * vec,
+                        size_t batch)
+{
+  for (size_t pos = 0; pos < net->nodecount; pos++)
+    {
+      const sigtype start = identity (net->accum[pos]);
+      for (size_t lane = 0; lane < batch; lane++)
+        vec[pos * batch + lane] = start;
+    }
+}
+
+// most of the popular transfer functions, and a few deliberate peculiarities, vectorized for OMP.  The loops are SIMD
+// loops rather than threaded ones: a transfer runs over one node group or one batch row at a time, which is far too
+// little work to pay for starting a parallel region.  Routine by Ray D. 6 September 2016
 void
-transfer (int fchoice, double *ins, double *outs, size_t width)
+transfer (int fchoice, const sigtype * ins, flotype * outs, size_t width)
 {
   switch (fchoice)
     {
     case 0:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = ins[count];
       break;                    // identity
     case 1:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = hypertan (ins[count]);
       break;                    // tanh sigmoid
     case 2:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = arctan (ins[count]);
       break;                    // arctangent sigmoid
     case 3:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = ONE / (ONE + exponential (-ins[count]));
       break;                    // unsigned logistic sigmoid
     case 4:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
-        outs[count] = (TWO / (ONE + exp (-ins[count]))) - ONE;
+        outs[count] = (TWO / (ONE + exponential (-ins[count]))) - ONE;
       break;                    // signed logistic sigmoid
     case 5:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = ins[count] / (ONE + absolute (ins[count]));
       break;                    // softsign sigmoid
     case 6:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)    // mirrored logarithmic transfer
         outs[count] =
           ins[count] >
@@ -192,57 +226,127 @@ transfer (int fchoice, double *ins, double *outs, size_t width)
           -logarithm (absolute (-ins[count] - ONE));
       break;
     case 7:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = ins[count] > ZERO ? ONE : -ONE;
       break;                    // signed step function
     case 8:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = ins[count] > ZERO ? ins[count] : ZERO;
       break;                    // rectified linear unit
     case 9:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)
         outs[count] = logarithm (ONE + exponential (ins[count]));
       break;                    // softplus rectifier
     case 10:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)    // logarithmic rectifier - mimics spike freq. in biological networks.
         outs[count] = ins[count] >= ONE ? logarithm (ins[count]) : ZERO;
+      break;
     case 11:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)    // sinusoid Radial Bias Function
         outs[count] = cosine (ins[count]);
       break;
     case 12:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)    // gaussian Radial Bias Function
         outs[count] = exponential (-ins[count] * ins[count]);
       break;
     case 13:
-#pragma omp parallel for
+#pragma omp simd
       for (size_t count = 0; count < width; count++)    // thin plate spline Radial Bias Function
         outs[count] = (ins[count] * ins[count]) * logarithm (ins[count]);
       break;
       // Note: Activation functions below this point operate on multiple nodes. This is an experimental capability.
     case 14:
-#pragma omp parallel for
-      for (size_t count = 1; count < width; count++)    // multiplication by first input.
-        outs[count] = ins[count] * ins[0];
-      outs[0] = 0;
+      {                         // multiplication by first input.
+        const sigtype first = ins[0];
+#pragma omp simd
+        for (size_t count = 1; count < width; count++)
+          outs[count] = ins[count] * first;
+        outs[0] = 0;
+      }
       break;
     case 15:
-#pragma omp parallel for
-      for (size_t count = 0; count < (width - 1); count += 2)
+#pragma omp simd
+      for (size_t pair = 0; pair < width / 2; pair++)
         {                       // parallel pairwise addition & multiplication.
-          outs[count] = ins[count] * ins[count + 1];
-          outs[count + 1] = ins[count] + ins[count + 1];
+          const sigtype left = ins[2 * pair];
+          const sigtype right = ins[2 * pair + 1];
+          outs[2 * pair] = left * right;
+          outs[2 * pair + 1] = left + right;
         }
+      if (width % 2 != 0)
+        outs[width - 1] = 0;    // an unpaired last node has no partner to combine with.
       break;
     default:
-      fprintf (stderr, "unknown transfer function\n");
-      exit (1);
+      Complain ("unknown transfer function\n");
+      Fail (1);
+    }
+}
+
+
+// transfer, with the transcendental functions replaced by the approximations in fastmath.h.  Used while a plan with
+// 'Precision Fast' runs.  Transfers that need no transcendental function, and the cosine, are left to transfer().
+void
+fast_transfer (int fchoice, const sigtype * ins, flotype * outs, size_t width)
+{
+  switch (fchoice)
+    {
+    case 1:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)
+        outs[count] = fasttanh (ins[count]);
+      break;                    // tanh sigmoid
+    case 2:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)
+        outs[count] = fastatan (ins[count]);
+      break;                    // arctangent sigmoid
+    case 3:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)
+        outs[count] = ONE / (ONE + fastexp (-ins[count]));
+      break;                    // unsigned logistic sigmoid
+    case 4:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)
+        outs[count] = (TWO / (ONE + fastexp (-ins[count]))) - ONE;
+      break;                    // signed logistic sigmoid
+    case 6:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)    // mirrored logarithmic transfer
+        outs[count] =
+          ins[count] >
+          ZERO ? fastlog (absolute (ins[count] + ONE)) :
+          -fastlog (absolute (-ins[count] - ONE));
+      break;
+    case 9:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)    // softplus rectifier, as max(x,0) + log(1 + e^-|x|).
+        outs[count] = (ins[count] > ZERO ? ins[count] : ZERO) +
+          fastlog (ONE + fastexp (-absolute (ins[count])));
+      break;
+    case 10:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)    // logarithmic rectifier - mimics spike freq. in biological networks.
+        outs[count] = ins[count] >= ONE ? fastlog (ins[count]) : ZERO;
+      break;
+    case 12:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)    // gaussian Radial Bias Function
+        outs[count] = fastexp (-ins[count] * ins[count]);
+      break;
+    case 13:
+#pragma omp simd
+      for (size_t count = 0; count < width; count++)    // thin plate spline Radial Bias Function
+        outs[count] = (ins[count] * ins[count]) * fastlog (ins[count]);
+      break;
+    default:
+      transfer (fchoice, ins, outs, width);
     }
 }
 
@@ -260,17 +364,20 @@ transfer (int fchoice, double *ins, double *outs, size_t width)
 // Handles recurrent networks. Saves history if desired so we can later do backprop.  Handles combinators varying by
 // node.  Handles transfer functions varying by node.  Handles transfer functions of differing widths.
 
-void
-fwdprop (const struct nnet *const net, const flotype * const inputs,
-         flotype * const activations, flotype * const history,
-         flotype * const outputs)
+// The work of fwdprop and fwdprop_record.  If pre is not NULL, each node's accumulated input is recorded there as the
+// node fires.
+static inline void
+propagate (const struct nnet *const net, const flotype * const inputs,
+           sigtype * const activations, sigtype * const pre,
+           flotype * const res, flotype * const outputs)
 {
+  void (*const run) (int, const sigtype *, flotype *, size_t) =
+    net->precision == PRECISION_FAST ? fast_transfer : transfer;
+  const int detail = PROFILE_DETAIL (net);
+  double began = 0.0;
   size_t wcount = 0;
   size_t nodecount = 0;
-  flotype *res =
-    history != NULL ? history : alloca (sizeof (flotype) * net->nodecount);
   res[nodecount++] = ONE;       // bias.
-#pragma omp parallel for
   for (size_t incount = nodecount; incount <= net->inputcount; incount++)       // process inputs.
     activations[incount] =
       combine (net->accum[incount], activations[incount],
@@ -281,17 +388,14 @@ fwdprop (const struct nnet *const net, const flotype * const inputs,
       for (; nodecount <= net->sources[wcount];
            nodecount += net->transferwidths[nodecount])
         {
-          transfer (net->transfer[nodecount], &(activations[nodecount]),
-                    &(res[nodecount]), net->transferwidths[nodecount]);
-          // reset nodes whose transfers have run so recurrent transfers start from the identity element for their accumulator.
-#pragma omp parallel for
-          for (size_t resetcount = nodecount;
-               resetcount <= nodecount + net->transferwidths[nodecount];
-               resetcount++)
-            {
-              // capture activation history if history vector is provided. many training methods need it.
-              activations[resetcount] = identity (net->accum[resetcount]);
-            }
+          if (detail)
+            began = ProfileClock ();
+          run (net->transfer[nodecount], &(activations[nodecount]),
+               &(res[nodecount]), net->transferwidths[nodecount]);
+          reset_fired (net, nodecount, activations, pre);
+          if (detail)
+            ProfileFiring (net->profile, net->transfer[nodecount], nodecount,
+                           began);
         }
       activations[net->dests[wcount]] =
         combine (net->accum[net->dests[wcount]],
@@ -299,15 +403,325 @@ fwdprop (const struct nnet *const net, const flotype * const inputs,
                  res[net->sources[wcount]] * net->weights[wcount]);
     }
   // process transfer functions for any nodes following last weight source to be sure we get outputs for all output nodes.
-  for (; nodecount < net->nodecount; nodecount++)
+  for (; nodecount < net->nodecount;
+       nodecount += net->transferwidths[nodecount])
     {
-      transfer (net->nodecount, &(activations[nodecount]), &(res[nodecount]),
-                net->transferwidths[nodecount]);
-#pragma omp parallel for
+      if (detail)
+        began = ProfileClock ();
+      run (net->transfer[nodecount], &(activations[nodecount]),
+           &(res[nodecount]), net->transferwidths[nodecount]);
+      reset_fired (net, nodecount, activations, pre);
+      if (detail)
+        ProfileFiring (net->profile, net->transfer[nodecount], nodecount,
+                       began);
+    }
+  memcpy (outputs, &(res[net->nodecount - net->outputcount]), sizeof (flotype) * net->outputcount);     // send outputs from res
+}
+
+void
+fwdprop (const struct nnet *const net, const flotype * const inputs,
+         sigtype * const activations, flotype * const history,
+         flotype * const outputs)
+{
+  flotype *res =
+    history != NULL ? history : alloca (sizeof (flotype) * net->nodecount);
+  double began = PROFILE_START (net);
+  propagate (net, inputs, activations, NULL, res, outputs);
+  PROFILE_STOP (net, PROF_FORWARD, began);
+}
+
+// fwdprop_record: fwdprop, also recording in pre the accumulated input of every node at the time it fired (the value
+// its transfer function was applied to).  Backpropagation needs it along with the history.  Neither may be NULL.
+void
+fwdprop_record (const struct nnet *const net, const flotype * const inputs,
+                sigtype * const activations, sigtype * const pre,
+                flotype * const history, flotype * const outputs)
+{
+  assert (pre != NULL);
+  assert (history != NULL);
+  double began = PROFILE_START (net);
+  propagate (net, inputs, activations, pre, history, outputs);
+  PROFILE_STOP (net, PROF_FORWARD, began);
+}
+
+
+// Apply one synapse to every case of a batch.  The switch on the combiner is hoisted out of the lane loop so the common
+// combiners reduce to a single multiply-add per lane that the compiler can vectorize.
+static inline void
+combine_lanes (const int combiner, sigtype * restrict acc,
+               const flotype * restrict src, const flotype weight,
+               const size_t lanes)
+{
+  size_t lane;
+  switch (combiner)
+    {
+    case 0:
+      break;
+    case 1:
+#pragma omp simd
+      for (lane = 0; lane < lanes; lane++)
+        acc[lane] += src[lane] * weight;
+      break;
+    case 2:
+#pragma omp simd
+      for (lane = 0; lane < lanes; lane++)
+        acc[lane] *= src[lane] * weight;
+      break;
+    case 6:
+#pragma omp simd
+      for (lane = 0; lane < lanes; lane++)
+        acc[lane] = MAX (acc[lane], src[lane] * weight);
+      break;
+    default:
+      for (lane = 0; lane < lanes; lane++)
+        acc[lane] = combine (combiner, acc[lane], src[lane] * weight);
+    }
+}
+
+// Run a transfer function over a node-major batch.  Transfers that act on each node alone see width * lanes
+// contiguous values and go straight to transfer().  The multi-node transfers combine rows of the group, so each is one
+// fused pass down the lanes of its rows, with no gather into case-major order.
+static void
+transfer_lanes (int fchoice, int fast, sigtype * ins, flotype * outs,
+                size_t width, size_t lanes)
+{
+  size_t lane;
+  switch (fchoice)
+    {
+    case 14:
+      {                         // multiplication by first input.
+        const sigtype *first = ins;
+        for (size_t unit = 1; unit < width; unit++)
+          {
+            const sigtype *in = &(ins[unit * lanes]);
+            flotype *out = &(outs[unit * lanes]);
+#pragma omp simd
+            for (lane = 0; lane < lanes; lane++)
+              out[lane] = in[lane] * first[lane];
+          }
+        for (lane = 0; lane < lanes; lane++)
+          outs[lane] = 0;
+      }
+      break;
+    case 15:
+      for (size_t pair = 0; pair < width / 2; pair++)
+        {                       // parallel pairwise addition & multiplication.
+          const sigtype *left = &(ins[2 * pair * lanes]);
+          const sigtype *right = &(ins[(2 * pair + 1) * lanes]);
+          flotype *product = &(outs[2 * pair * lanes]);
+          flotype *sum = &(outs[(2 * pair + 1) * lanes]);
+#pragma omp simd
+          for (lane = 0; lane < lanes; lane++)
+            {
+              product[lane] = left[lane] * right[lane];
+              sum[lane] = left[lane] + right[lane];
+            }
+        }
+      if (width % 2 != 0)
+        for (lane = 0; lane < lanes; lane++)
+          outs[(width - 1) * lanes + lane] = 0;
+      break;
+    default:
+      if (fast)
+        fast_transfer (fchoice, ins, outs, width * lanes);
+      else
+        transfer (fchoice, ins, outs, width * lanes);
+    }
+}
+
+
+// Fire a node group of a quantized batch: fold the integer sums into the group's float inputs, run the transfer
+// function, and keep int16 copies of the outputs that integer synapses read.
+static void
+fire_quantized (const struct quantized *qn, unsigned int first, int fast,
+                sigtype * activations, flotype * res, int16_t * qres,
+                int32_t * acc, size_t lanes)
+{
+  const struct nnet *net = qn->net;
+  const unsigned int width = net->transferwidths[first];
+  double began = PROFILE_DETAIL (net) ? ProfileClock () : 0.0;
+  for (unsigned int node = first; node < first + width; node++)
+    if (qn->accumulates[node])
+      {
+        sigtype *act = &(activations[node * lanes]);
+        int32_t *sum = &(acc[node * lanes]);
+        const flotype scale = qn->destscale[node];
+#pragma omp simd
+        for (size_t lane = 0; lane < lanes; lane++)
+          {
+            act[lane] += sum[lane] * scale;
+            sum[lane] = 0;
+          }
+      }
+  transfer_lanes (net->transfer[first], fast, &(activations[first * lanes]),
+                  &(res[first * lanes]), width, lanes);
+  for (unsigned int node = first; node < first + width; node++)
+    {
+      const sigtype start = identity (net->accum[node]);
+      for (size_t lane = 0; lane < lanes; lane++)
+        activations[node * lanes + lane] = start;
+      if (qn->quantizes[node])
+        {
+          const flotype *out = &(res[node * lanes]);
+          int16_t *q = &(qres[node * lanes]);
+          const flotype inverse = ONE / qn->actscale[node];
+#pragma omp simd
+          for (size_t lane = 0; lane < lanes; lane++)
+            {
+              flotype steps = out[lane] * inverse;
+              steps = absolute (steps) > QUANT_ACTIVITY_MAX ?
+                FASTCOPYSIGN (QUANT_ACTIVITY_MAX, steps) : steps;
+              q[lane] = (int16_t) (int32_t) (steps + FASTCOPYSIGN (0.5, steps));       // rounded.
+            }
+        }
+    }
+  if (PROFILE_DETAIL (net))
+    ProfileFiring (net->profile, net->transfer[first], first, began);
+}
+
+// fwdprop_quantized: fwdprop_batch with the integer synapses of qn (see quantize.h) run as int16 x int8 products summed
+// in int32.  The vectors are as for fwdprop_batch; the int16 outputs and int32 sums are kept in qn's scratch space, and
+// so are the node outputs when history is NULL.
+static void
+fwdprop_quantized (struct quantized *qn, const size_t batch,
+                   const flotype * const inputs, sigtype * const activations,
+                   flotype * const history, flotype * const outputs)
+{
+  const struct nnet *net = qn->net;
+  const int fast = net->precision == PRECISION_FAST;
+  size_t nodecount = 1;
+  ReserveQuantized (qn, batch);
+  flotype *res = history != NULL ? history : qn->res;
+  int16_t *qres = qn->qres;
+  int32_t *acc = qn->acc;
+  for (size_t lane = 0; lane < batch; lane++)
+    {
+      res[lane] = ONE;          // bias.
+      qres[lane] = (int16_t) (ONE / qn->actscale[0] + (flotype) 0.5);
+    }
+  for (size_t incount = 1; incount <= net->inputcount; incount++)
+    combine_lanes (net->accum[incount], &(activations[incount * batch]),
+                   &(inputs[(incount - 1) * batch]), ONE, batch);
+  for (size_t wcount = 0; wcount < net->synapsecount; wcount++)
+    {
+      const unsigned int source = net->sources[wcount];
+      const unsigned int dest = net->dests[wcount];
+      for (; nodecount <= source; nodecount += net->transferwidths[nodecount])
+        fire_quantized (qn, nodecount, fast, activations, res, qres, acc,
+                        batch);
+      if (qn->integer[wcount])
+        {
+          const int16_t *q = &(qres[source * batch]);
+          int32_t *sum = &(acc[dest * batch]);
+          const int32_t weight = qn->weights[wcount];
+#pragma omp simd
+          for (size_t lane = 0; lane < batch; lane++)
+            sum[lane] += q[lane] * weight;
+        }
+      else
+        combine_lanes (net->accum[dest], &(activations[dest * batch]),
+                       &(res[source * batch]), net->weights[wcount], batch);
+    }
+  for (; nodecount < net->nodecount;
+       nodecount += net->transferwidths[nodecount])
+    fire_quantized (qn, nodecount, fast, activations, res, qres, acc, batch);
+  memcpy (outputs, &(res[(net->nodecount - net->outputcount) * batch]),
+          sizeof (flotype) * net->outputcount * batch);
+}
+
+
+// fwdprop_batch: same semantics as fwdprop, for 'batch' independent cases at once. Every vector is node-major: the value
+// belonging to node (or input, or output) n of case b is found at [n * batch + b]. So inputs is inputcount x batch,
+// activations and history are nodecount x batch, and outputs is outputcount x batch. Initialize activations with
+// init_activations_batch. Each source, destination and weight is loaded once per batch rather than once per case, so
+// the synapse arrays are traversed batch times less often than calling fwdprop once for every case.  Without history,
+// each call allocates space for the node outputs, so callers that run many batches should pass it.  While
+// net->quantized is set, the network's int8 weights are run instead, and history gets the quantized node outputs.
+void
+fwdprop_batch (const struct nnet *const net, const size_t batch,
+               const flotype * const inputs, sigtype * const activations,
+               flotype * const history, flotype * const outputs)
+{
+  assert (net != NULL);
+  assert (batch > 0);
+  double began = PROFILE_START (net);
+  if (net->quantized != NULL)
+    {
+      fwdprop_quantized (net->quantized, batch, inputs, activations,
+                         history, outputs);
+      PROFILE_STOP (net, PROF_FORWARD, began);
+      return;
+    }
+  const int fast = net->precision == PRECISION_FAST;
+  const int detail = PROFILE_DETAIL (net);
+  double fired = 0.0;
+  size_t wcount = 0;
+  size_t nodecount = 0;
+  flotype *res = history != NULL ? history :
+    (flotype *) malloc (sizeof (flotype) * net->nodecount * batch);
+  if (res == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in fwdprop_batch.\n");
+      Fail (1);
+    }
+  for (size_t lane = 0; lane < batch; lane++)
+    res[lane] = ONE;            // bias.
+  nodecount++;
+  for (size_t incount = nodecount; incount <= net->inputcount; incount++)      // process inputs.
+    combine_lanes (net->accum[incount], &(activations[incount * batch]),
+                   &(inputs[(incount - 1) * batch]), ONE, batch);
+  for (wcount = 0; wcount < net->synapsecount; wcount++)
+    {                           // process connections.
+      for (; nodecount <= net->sources[wcount];
+           nodecount += net->transferwidths[nodecount])
+        {
+          if (detail)
+            fired = ProfileClock ();
+          transfer_lanes (net->transfer[nodecount], fast,
+                          &(activations[nodecount * batch]),
+                          &(res[nodecount * batch]),
+                          net->transferwidths[nodecount], batch);
+          for (size_t resetcount = nodecount;
+               resetcount < nodecount + net->transferwidths[nodecount];
+               resetcount++)
+            {
+              const sigtype start = identity (net->accum[resetcount]);
+              for (size_t lane = 0; lane < batch; lane++)
+                activations[resetcount * batch + lane] = start;
+            }
+          if (detail)
+            ProfileFiring (net->profile, net->transfer[nodecount], nodecount,
+                           fired);
+        }
+      combine_lanes (net->accum[net->dests[wcount]],
+                     &(activations[net->dests[wcount] * batch]),
+                     &(res[net->sources[wcount] * batch]),
+                     net->weights[wcount], batch);
+    }
+  for (; nodecount < net->nodecount;
+       nodecount += net->transferwidths[nodecount])
+    {
+      if (detail)
+        fired = ProfileClock ();
+      transfer_lanes (net->transfer[nodecount], fast,
+                      &(activations[nodecount * batch]),
+                      &(res[nodecount * batch]),
+                      net->transferwidths[nodecount], batch);
       for (size_t resetcount = nodecount;
-           resetcount <= nodecount + net->transferwidths[nodecount];
+           resetcount < nodecount + net->transferwidths[nodecount];
            resetcount++)
-        activations[resetcount] = identity (net->accum[resetcount]);
+        {
+          const sigtype start = identity (net->accum[resetcount]);
+          for (size_t lane = 0; lane < batch; lane++)
+            activations[resetcount * batch + lane] = start;
+        }
+      if (detail)
+        ProfileFiring (net->profile, net->transfer[nodecount], nodecount,
+                       fired);
     }
-  memcpy (&(res[0]), &(outputs[net->nodecount - net->outputcount - 1]), sizeof (flotype) * net->outputcount);   // send outputs to res
+  memcpy (outputs, &(res[(net->nodecount - net->outputcount) * batch]),
+          sizeof (flotype) * net->outputcount * batch);
+  if (history == NULL)
+    free (res);
+  PROFILE_STOP (net, PROF_FORWARD, began);
 }
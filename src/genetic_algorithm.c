@@ -104,7 +104,6 @@ static void
 crossover (network_config * config,
            double w1, double w2, double *n1, double *n2)
 {
-  static int POSS = 1;
   double average = (w1 + w2) / 2;
   double delta = (config->wmax - config->wmin) / 2;
   double mid = (config->wmax + config->wmin) / 2;
@@ -116,15 +115,15 @@ crossover (network_config * config,
     *n2 = average + delta;
   else
     {                           /* == mid */
-      if (POSS)
+      if (config->crossovermax)
         {
           *n2 = config->wmax;
-          POSS = 0;
+          config->crossovermax = 0;
         }
       else
         {
           *n2 = config->wmin;
-          POSS = 1;
+          config->crossovermax = 1;
         }
     }
 }
@@ -135,19 +134,19 @@ mutation (network_config * config, double *weight, double rate)
 
   double delta = config->wmax - config->wmin;
 
-  if (rnd () > rate)
+  if (rnd (config) > rate)
     return;
-  if (rnd () > 0.5)
+  if (rnd (config) > 0.5)
     {
       /* go plus */
-      *weight += (rnd () * delta / 2);
+      *weight += (rnd (config) * delta / 2);
       if (*weight > config->wmax)
         *weight -= delta;
     }
   else
     {
       /* go minus */
-      *weight -= (rnd () * delta / 2);
+      *weight -= (rnd (config) * delta / 2);
       if (*weight < config->wmin)
         *weight += delta;
     }
@@ -169,7 +168,7 @@ individual_compare (const void *a, const void *b)
 }
 
 static void
-init_individuals (unsigned long weight_cout,
+init_individuals (network_config * config, unsigned long weight_cout,
                   individual_t ** individuals, int size)
 {
   int n, k;
@@ -177,7 +176,7 @@ init_individuals (unsigned long weight_cout,
   for (n = 0; n < size; ++n)
     /* for each neuron in the network... */
     for (k = 0; k < weight_cout; k++)
-      individuals[n]->weights[k] = rnd ();
+      individuals[n]->weights[k] = rnd (config);
 }
 
 static void
@@ -270,7 +269,7 @@ genetic_algorithm (network * nn, network_config * config)
     }
 
   int weight_cout = actual_weight_count (nn);
-  init_individuals (weight_cout, individuals, npop);
+  init_individuals (config, weight_cout, individuals, npop);
 
   for (n = 0; n < nmax; ++n)
     {
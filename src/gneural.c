@@ -0,0 +1,391 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// libgneural's entry points; see gneural.h.  Each call that runs engine code arms the context's failure trap first,
+// so an error deep in the parser or a kernel unwinds to the call instead of exiting the caller's process.
+
+#include <stdarg.h>
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "parser.h"
+#include "netbuilder.h"
+#include "save.h"
+#include "feedforward.h"
+#include "backprop.h"
+#include "fail.h"
+#include "gneural.h"
+
+struct gneural
+{
+  struct failtrap trap;         // where the engine's messages go while a call runs, and the last error.
+  struct nnet *net;             // NULL until a script is loaded.
+  struct conf config;           // the loaded script's configuration, used to save it.
+  sigtype *steps;               // activations gneural_step carries from step to step.
+  struct bptt *bp;              // made by the first gneural_train after a load.
+  size_t batch;                 // cases the node-major buffers below have room for.
+  flotype *ins;
+  flotype *outs;
+  flotype *history;             // node outputs, so that gneural_run doesn't allocate.
+  sigtype *acts;
+};
+
+// record an error found by the library itself, as Complain would while the trap is armed.
+static int
+Refuse (struct gneural *gn, int status, const char *format, ...)
+{
+  va_list args;
+  va_start (args, format);
+  vsnprintf (gn->trap.message, sizeof (gn->trap.message), format, args);
+  va_end (args);
+  if (gn->trap.log != NULL)
+    gn->trap.log (gn->trap.logarg, GNEURAL_LOG_ERROR, gn->trap.message);
+  return (status);
+}
+
+static void
+FreeConf (struct conf *config)
+{
+  free (config->openingcomment);
+  free (config->savename);
+  free (config->weightname);
+}
+
+static void
+FreeLoaded (struct gneural *gn)
+{
+  FinishBptt (gn->bp);
+  FreeNnet (gn->net);
+  FreeConf (&(gn->config));
+  free (gn->steps);
+  free (gn->ins);
+  free (gn->outs);
+  free (gn->history);
+  free (gn->acts);
+  gn->bp = NULL;
+  gn->net = NULL;
+  memset (&(gn->config), 0, sizeof (struct conf));
+  gn->steps = NULL;
+  gn->ins = NULL;
+  gn->outs = NULL;
+  gn->history = NULL;
+  gn->acts = NULL;
+  gn->batch = 0;
+}
+
+gneural *
+gneural_new (gneural_log log, void *arg)
+{
+  struct gneural *gn = (struct gneural *) calloc (1, sizeof (struct gneural));
+  if (gn == NULL)
+    return (NULL);
+  gn->trap.log = log;
+  gn->trap.logarg = arg;
+  return (gn);
+}
+
+void
+gneural_free (gneural * gn)
+{
+  if (gn == NULL)
+    return;
+  FreeLoaded (gn);
+  free (gn);
+}
+
+// parse the script open on input into a new network, and make it the context's network if the parse succeeds.
+static int
+Load (struct gneural *gn, FILE * input)
+{
+  struct failtrap *outer = failtrap;
+  struct slidingbuffer *bf =
+    (struct slidingbuffer *) calloc (1, sizeof (struct slidingbuffer));
+  struct nnet *net = (struct nnet *) calloc (1, sizeof (struct nnet));
+  sigtype *steps = NULL;
+  struct conf config;
+  memset (&config, 0, sizeof (struct conf));
+  if (bf == NULL || net == NULL)
+    {
+      fclose (input);
+      free (bf);
+      free (net);
+      return (Refuse (gn, GNEURAL_NOMEM, "Out of memory loading a network."));
+    }
+  bf->input = input;
+  config.flags = SAVE_DEFAULT;  // there is no script filename to save beside unless the script names one.
+  failtrap = &(gn->trap);
+  if (setjmp (gn->trap.unwind) != 0)
+    {                           // the parser can leave allocations of the statement it stopped in behind.
+      failtrap = outer;
+      if (bf->input != NULL)
+        fclose (bf->input);
+      DiscardNetBuilder (bf->builder);
+      free (bf->warnings);
+      free (bf);
+      FreeNnet (net);
+      FreeConf (&config);
+      return (GNEURAL_FAILED);
+    }
+  nnetparser (net, &config, bf);
+  failtrap = outer;
+  fclose (bf->input);
+  steps = (sigtype *) malloc (sizeof (sigtype) * net->nodecount);
+  if (steps == NULL)
+    {
+      free (bf->warnings);
+      free (bf);
+      FreeNnet (net);
+      FreeConf (&config);
+      return (Refuse (gn, GNEURAL_NOMEM, "Out of memory loading a network."));
+    }
+  if (bf->warnings != NULL && gn->trap.log != NULL)
+    for (char *line = strtok (bf->warnings, "\n"); line != NULL;
+         line = strtok (NULL, "\n"))
+      gn->trap.log (gn->trap.logarg, GNEURAL_LOG_WARNING, line);
+  free (bf->warnings);
+  free (bf);
+  FreeLoaded (gn);
+  gn->net = net;
+  gn->config = config;
+  gn->steps = steps;
+  init_activations (net, steps);
+  gn->trap.message[0] = '\0';
+  return (GNEURAL_OK);
+}
+
+int
+gneural_load_file (gneural * gn, const char *filename)
+{
+  if (gn == NULL || filename == NULL)
+    return (GNEURAL_BADCALL);
+  FILE *input = fopen (filename, "r");
+  if (input == NULL)
+    return (Refuse (gn, GNEURAL_FAILED, "Unable to open %s.", filename));
+  return (Load (gn, input));
+}
+
+int
+gneural_load_script (gneural * gn, const char *text, size_t length)
+{
+  if (gn == NULL || text == NULL)
+    return (GNEURAL_BADCALL);
+  FILE *input = fmemopen ((void *) text, length, "r");
+  if (input == NULL)
+    return (Refuse (gn, GNEURAL_NOMEM, "Out of memory loading a network."));
+  return (Load (gn, input));
+}
+
+int
+gneural_save_file (gneural * gn, const char *filename)
+{
+  if (gn == NULL || filename == NULL || gn->net == NULL)
+    return (GNEURAL_BADCALL);
+  FILE *output = fopen (filename, "w");
+  if (output == NULL)
+    return (Refuse (gn, GNEURAL_FAILED, "Unable to write %s.", filename));
+  struct failtrap *outer = failtrap;
+  failtrap = &(gn->trap);
+  if (setjmp (gn->trap.unwind) != 0)
+    {
+      failtrap = outer;
+      fclose (output);
+      return (GNEURAL_FAILED);
+    }
+  nnetwriter (gn->net, &(gn->config), output);
+  failtrap = outer;
+  if (fclose (output) != 0)
+    return (Refuse (gn, GNEURAL_FAILED, "Error writing %s.", filename));
+  return (GNEURAL_OK);
+}
+
+unsigned int
+gneural_inputs (const gneural * gn)
+{
+  return (gn != NULL && gn->net != NULL ? gn->net->inputcount : 0);
+}
+
+unsigned int
+gneural_outputs (const gneural * gn)
+{
+  return (gn != NULL && gn->net != NULL ? gn->net->outputcount : 0);
+}
+
+// make room in the node-major buffers for count cases.
+static int
+Reserve (struct gneural *gn, size_t count)
+{
+  const struct nnet *net = gn->net;
+  if (count <= gn->batch)
+    return (GNEURAL_OK);
+  flotype *ins =
+    (flotype *) realloc (gn->ins, sizeof (flotype) * (net->inputcount + 1) *
+                         count);
+  if (ins != NULL)
+    gn->ins = ins;
+  flotype *outs =
+    (flotype *) realloc (gn->outs, sizeof (flotype) * (net->outputcount + 1) *
+                         count);
+  if (outs != NULL)
+    gn->outs = outs;
+  flotype *history =
+    (flotype *) realloc (gn->history, sizeof (flotype) * net->nodecount *
+                         count);
+  if (history != NULL)
+    gn->history = history;
+  sigtype *acts =
+    (sigtype *) realloc (gn->acts, sizeof (sigtype) * net->nodecount * count);
+  if (acts != NULL)
+    gn->acts = acts;
+  if (ins == NULL || outs == NULL || history == NULL || acts == NULL)
+    return (Refuse (gn, GNEURAL_NOMEM, "Out of memory for %zu cases.",
+                    count));
+  gn->batch = count;
+  return (GNEURAL_OK);
+}
+
+int
+gneural_run (gneural * gn, size_t count, const double *inputs,
+             double *outputs)
+{
+  if (gn == NULL || gn->net == NULL || inputs == NULL || outputs == NULL)
+    return (GNEURAL_BADCALL);
+  const struct nnet *net = gn->net;
+  const size_t incount = net->inputcount;
+  const size_t outcount = net->outputcount;
+  int status = Reserve (gn, count);
+  if (status != GNEURAL_OK || count == 0)
+    return (status);
+  for (size_t cs = 0; cs < count; cs++)
+    for (size_t in = 0; in < incount; in++)
+      gn->ins[in * count + cs] = inputs[cs * incount + in];
+  struct failtrap *outer = failtrap;
+  failtrap = &(gn->trap);
+  if (setjmp (gn->trap.unwind) != 0)
+    {
+      failtrap = outer;
+      return (GNEURAL_FAILED);
+    }
+  init_activations_batch (net, gn->acts, count);
+  fwdprop_batch (net, count, gn->ins, gn->acts, gn->history, gn->outs);
+  failtrap = outer;
+  for (size_t cs = 0; cs < count; cs++)
+    for (size_t out = 0; out < outcount; out++)
+      outputs[cs * outcount + out] = gn->outs[out * count + cs];
+  return (GNEURAL_OK);
+}
+
+int
+gneural_step (gneural * gn, const double *inputs, double *outputs)
+{
+  if (gn == NULL || gn->net == NULL || inputs == NULL || outputs == NULL)
+    return (GNEURAL_BADCALL);
+  const struct nnet *net = gn->net;
+  int status = Reserve (gn, 1);
+  if (status != GNEURAL_OK)
+    return (status);
+  for (size_t in = 0; in < net->inputcount; in++)
+    gn->ins[in] = inputs[in];
+  struct failtrap *outer = failtrap;
+  failtrap = &(gn->trap);
+  if (setjmp (gn->trap.unwind) != 0)
+    {
+      failtrap = outer;
+      return (GNEURAL_FAILED);
+    }
+  fwdprop (net, gn->ins, gn->steps, NULL, gn->outs);
+  failtrap = outer;
+  for (size_t out = 0; out < net->outputcount; out++)
+    outputs[out] = gn->outs[out];
+  return (GNEURAL_OK);
+}
+
+int
+gneural_reset (gneural * gn)
+{
+  if (gn == NULL || gn->net == NULL)
+    return (GNEURAL_BADCALL);
+  init_activations (gn->net, gn->steps);
+  return (GNEURAL_OK);
+}
+
+int
+gneural_train (gneural * gn, size_t count, const double *inputs,
+               const double *targets, double rate, double *rmserror)
+{
+  if (gn == NULL || gn->net == NULL || inputs == NULL || targets == NULL)
+    return (GNEURAL_BADCALL);
+  struct nnet *net = gn->net;
+  const size_t incount = net->inputcount;
+  const size_t outcount = net->outputcount;
+  int status = Reserve (gn, 1);
+  if (status != GNEURAL_OK)
+    return (status);
+  struct failtrap *outer = failtrap;
+  failtrap = &(gn->trap);
+  if (setjmp (gn->trap.unwind) != 0)
+    {
+      failtrap = outer;
+      return (GNEURAL_FAILED);
+    }
+  if (gn->bp == NULL)
+    gn->bp = StartBptt (net, 1, 1);
+  struct bptt *bp = gn->bp;
+  bp->sqerr = 0.0;
+  bp->scoredvals = 0;
+  for (size_t cs = 0; cs < count; cs++)
+    {
+      for (size_t in = 0; in < incount; in++)
+        gn->ins[in] = inputs[cs * incount + in];
+      for (size_t out = 0; out < outcount; out++)
+        gn->outs[out] = targets[cs * outcount + out];
+      ResetBptt (bp);
+      BpttStep (bp, gn->ins, gn->outs);
+      EndBpttWindow (bp);
+    }
+  DescendGradient (bp, (flotype) rate);
+  failtrap = outer;
+  if (rmserror != NULL)
+    *rmserror = bp->scoredvals > 0 ? sqrt (bp->sqerr / bp->scoredvals) : 0.0;
+  return (GNEURAL_OK);
+}
+
+const char *
+gneural_message (const gneural * gn)
+{
+  return (gn != NULL ? gn->trap.message : "");
+}
+
+const char *
+gneural_strerror (int status)
+{
+  switch (status)
+    {
+    case GNEURAL_OK:
+      return ("no error");
+    case GNEURAL_FAILED:
+      return ("the engine reported an error");
+    case GNEURAL_NOMEM:
+      return ("out of memory");
+    case GNEURAL_BADCALL:
+      return ("bad argument or no network loaded");
+    default:
+      return ("unknown status");
+    }
+}
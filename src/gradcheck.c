@@ -0,0 +1,165 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// gradcheck: checks the gradients that truncated backpropagation through time finds against central differences of the
+// squared output error, on random recurrent networks using every combiner and transfer function, for every StoreEvery
+// interval from 1 to the window.  Run by 'make check'; exits nonzero if any gradient is off by more than
+// GRADCHECK_TOLERANCE relative.
+
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "netbuilder.h"
+#include "feedforward.h"
+#include "backprop.h"
+#include "testnet.h"
+
+#define GRADCHECK_NETWORKS  400
+#define GRADCHECK_STEPS     7
+#define GRADCHECK_SYNAPSES  30
+#define GRADCHECK_DELTA     1e-6
+#define GRADCHECK_TOLERANCE 1e-4
+#define GRADCHECK_FLOOR     1e-4  // gradients much smaller than this are compared absolutely.
+
+// single-node transfers, and the two that run over groups of nodes.
+#define SINGLE_TRANSFERS 14
+#define WIDE_TRANSFERS   2
+#define COMBINERS        8
+
+// what the networks checked so far have found.
+struct gradtally
+{
+  double worst;                 // worst relative gradient error.
+  int skipped;                  // networks whose outputs weren't finite.
+};
+
+// a network of two inputs, four single hidden nodes and a group of four hidden nodes under a wide transfer, and two
+// outputs, with transfers and combiners chosen at random, joined by random synapses that may run backwards.
+static void
+RandomNetwork (struct nnet *net, int wide)
+{
+  struct netbuilder *nb = StartNetBuilder (net);
+  BuildNodes (nb, GROUP_INPUT, 2, 0, 1, 1);
+  for (int node = 0; node < 4; node++)
+    BuildNodes (nb, GROUP_HIDDEN, 1, random () % SINGLE_TRANSFERS,
+                random () % COMBINERS, 1);
+  BuildNodes (nb, GROUP_HIDDEN, 1, SINGLE_TRANSFERS + wide, 1, 4);
+  BuildNodes (nb, GROUP_HIDDEN, 3, 0, 1, 1);
+  for (int node = 0; node < 2; node++)
+    BuildNodes (nb, GROUP_OUTPUT, 1, random () % SINGLE_TRANSFERS,
+                random () % COMBINERS, 1);
+  RandomSynapses (nb, 1, GRADCHECK_SYNAPSES, 0.5, 0);
+  FinishNetBuilder (nb);
+}
+
+// half the squared error of the network's outputs over the steps, run from the identity activations; NaN if any node's
+// output is not finite at any step.
+static double
+StepsError (const struct nnet *net, const flotype * inputs,
+            const flotype * targets)
+{
+  sigtype *activations = malloc (sizeof (sigtype) * net->nodecount);
+  flotype *history = malloc (sizeof (flotype) * net->nodecount);
+  flotype *outputs = malloc (sizeof (flotype) * (net->outputcount + 1));
+  double err = 0.0;
+  if (activations == NULL || history == NULL || outputs == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in StepsError.\n");
+      exit (1);
+    }
+  init_activations (net, activations);
+  for (size_t step = 0; step < GRADCHECK_STEPS; step++)
+    {
+      fwdprop (net, &(inputs[step * net->inputcount]), activations, history,
+               outputs);
+      for (size_t node = 0; node < net->nodecount; node++)
+        if (!isfinite (history[node]))
+          err = NAN;
+      for (size_t out = 0; out < net->outputcount; out++)
+        {
+          double diff = outputs[out] - targets[step * net->outputcount + out];
+          err += 0.5 * diff * diff;
+        }
+    }
+  free (activations);
+  free (history);
+  free (outputs);
+  return (err);
+}
+
+// find the worst relative difference between backpropagated and central difference gradients of a random network, over
+// every interval, and add it to the gradtally.  A network with a node whose output is not finite (say, a thin plate
+// spline of a negative value) leaves nothing to compare, and is counted as skipped.  Returns 1 if the worst difference
+// is over GRADCHECK_TOLERANCE.
+static int
+CheckNetwork (int network, void *arg)
+{
+  struct gradtally *tally = (struct gradtally *) arg;
+  const int wide = network % WIDE_TRANSFERS;
+  struct nnet net;
+  flotype inputs[GRADCHECK_STEPS * 2];
+  flotype targets[GRADCHECK_STEPS * 2];
+  double worst = 0.0;
+  memset (&net, 0, sizeof (struct nnet));
+  RandomNetwork (&net, wide);
+  for (size_t index = 0; index < GRADCHECK_STEPS * 2; index++)
+    {
+      inputs[index] = Uniform (-0.5, 0.5);
+      targets[index] = Uniform (-0.5, 0.5);
+    }
+  if (!isfinite (StepsError (&net, inputs, targets)))
+    worst = -1.0;
+  for (size_t interval = 1; worst >= 0.0 && interval <= GRADCHECK_STEPS;
+       interval++)
+    {
+      struct bptt *bp = StartBptt (&net, GRADCHECK_STEPS, interval);
+      for (size_t step = 0; step < GRADCHECK_STEPS; step++)
+        BpttStep (bp, &(inputs[step * 2]), &(targets[step * 2]));
+      for (size_t synapse = 0; synapse < net.synapsecount; synapse++)
+        {
+          flotype weight = net.weights[synapse];
+          net.weights[synapse] = weight + GRADCHECK_DELTA;
+          double above = StepsError (&net, inputs, targets);
+          net.weights[synapse] = weight - GRADCHECK_DELTA;
+          double below = StepsError (&net, inputs, targets);
+          net.weights[synapse] = weight;
+          double numeric = (above - below) / (2 * GRADCHECK_DELTA);
+          double found = bp->gradient[synapse];
+          double err = isfinite (found) ? fabs (numeric - found) /
+            (GRADCHECK_FLOOR + fabs (numeric) + fabs (found)) : INFINITY;
+          worst = MAX (worst, err);
+        }
+      FinishBptt (bp);
+    }
+  FreeNetwork (&net);
+  tally->skipped += worst < 0.0;
+  tally->worst = MAX (tally->worst, worst);
+  return (worst > GRADCHECK_TOLERANCE);
+}
+
+int
+main (void)
+{
+  struct gradtally tally = { 0.0, 0 };
+  int failing = CheckNetworks (GRADCHECK_NETWORKS, CheckNetwork, &tally);
+  printf ("gradcheck: %d networks (%d not finite, skipped), worst relative gradient error %g\n",
+          GRADCHECK_NETWORKS, tally.skipped, tally.worst);
+  return (failing != 0);
+}
@@ -60,7 +60,7 @@ msmco (network * nn, network_config * config)
                   for (j = 0; j < nn->neurons[i].num_input; ++j)
                     {
                       nn->neurons[i].w[j] = 0.5 * delta +
-                        (0.5 - rnd ()) * 0.5 * delta;
+                        (0.5 - rnd (config)) * 0.5 * delta;
                     }
                 }
             }
@@ -69,7 +69,7 @@ msmco (network * nn, network_config * config)
               for (k = 0, i = 0; i < nn->num_of_neurons; i++)
                 for (j = 0; j < nn->neurons[i].num_input; ++j, ++k)
                   nn->neurons[i].w[j] =
-                    wbest[k] + (0.5 - rnd ()) * 0.5 * delta * pow (gamma, m);
+                    wbest[k] + (0.5 - rnd (config)) * 0.5 * delta * pow (gamma, m);
             }
           // update error
           err = error (nn, config);
@@ -0,0 +1,364 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// building networks in linear time: nodes and synapses accumulate in geometrically growing arrays, keyed so that
+// inserting nodes never renumbers existing synapses, and are numbered once when the network is compacted.
+
+#include "includes.h"
+#include "defines.h"
+#include "randomize.h"
+#include "netbuilder.h"
+#include "profile.h"
+#include "fail.h"
+
+#define KEYSHIFT 30
+#define KEYMASK ((1u << KEYSHIFT) - 1)
+
+static void *
+Grow (void *array, size_t count, size_t size)
+{
+  void *grown = realloc (array, count != 0 ? count * size : 1);
+  if (grown == NULL)
+    {
+      Complain
+        ("Runtime error: allocation failure while building a network.\n");
+      Fail (1);
+    }
+  return (grown);
+}
+
+// add count nodes to the end of a group.
+static void
+AppendNodes (struct nodegroup *grp, unsigned int count, int transferfn,
+             int accumfn, unsigned int xfersize)
+{
+  if (grp->count + count > grp->cap)
+    {
+      grp->cap = MAX (2 * grp->cap, grp->count + count);
+      if (grp->cap > KEYMASK)
+        {
+          Complain ("Runtime error: too many nodes in one group.\n");
+          Fail (1);
+        }
+      grp->transfer =
+        Grow (grp->transfer, grp->cap, sizeof (enum activation_function));
+      grp->accum =
+        Grow (grp->accum, grp->cap, sizeof (enum accumulator_function));
+      grp->transferwidths =
+        Grow (grp->transferwidths, grp->cap, sizeof (unsigned int));
+      grp->position = Grow (grp->position, grp->cap, sizeof (unsigned int));
+      grp->identity = Grow (grp->identity, grp->cap, sizeof (unsigned int));
+    }
+  for (unsigned int index = 0; index < count; index++)
+    {
+      unsigned int pos = grp->count++;
+      grp->transfer[pos] = transferfn;
+      grp->accum[pos] = accumfn;
+      grp->transferwidths[pos] = xfersize;
+      grp->position[pos] = grp->identity[pos] = pos;
+    }
+}
+
+static void
+ReserveSynapses (struct netbuilder *nb, size_t more)
+{
+  if (nb->synapsecount + more <= nb->synapsecap)
+    return;
+  if (nb->synapsecount + more > UINT_MAX)
+    {
+      Complain ("Runtime error: too many connections.\n");
+      Fail (1);
+    }
+  nb->synapsecap = MIN ((size_t) UINT_MAX,
+                        MAX (2 * (size_t) nb->synapsecap,
+                             nb->synapsecount + more));
+  nb->weights = Grow (nb->weights, nb->synapsecap, sizeof (flotype));
+  nb->sources = Grow (nb->sources, nb->synapsecap, sizeof (uint32_t));
+  nb->dests = Grow (nb->dests, nb->synapsecap, sizeof (uint32_t));
+}
+
+// the group holding node id as the network is numbered now, and (in *pos) the node's position in the group.
+static int
+NodeGroup (const struct netbuilder *nb, unsigned int id, unsigned int *pos)
+{
+  const struct nnet *net = nb->net;
+  assert (id < net->nodecount);
+  if (id == 0)
+    {
+      *pos = 0;
+      return (GROUP_BIAS);
+    }
+  if (id <= net->inputcount)
+    {
+      *pos = id - 1;
+      return (GROUP_INPUT);
+    }
+  if (id < net->nodecount - net->outputcount)
+    {
+      *pos = id - 1 - net->inputcount;
+      return (GROUP_HIDDEN);
+    }
+  *pos = id - (net->nodecount - net->outputcount);
+  return (GROUP_OUTPUT);
+}
+
+static uint32_t
+NodeKey (const struct netbuilder *nb, unsigned int id)
+{
+  unsigned int pos;
+  int group = NodeGroup (nb, id, &pos);
+  return (((uint32_t) group << KEYSHIFT) | nb->groups[group].identity[pos]);
+}
+
+// start building onto net, which may be empty or may already hold nodes and connections.
+struct netbuilder *
+StartNetBuilder (struct nnet *net)
+{
+  assert (net != NULL);
+  struct netbuilder *nb =
+    (struct netbuilder *) calloc (1, sizeof (struct netbuilder));
+  if (nb == NULL)
+    {
+      Complain ("Runtime error: allocation failure in StartNetBuilder.\n");
+      Fail (1);
+    }
+  nb->net = net;
+  nb->rndstate = RANDOMFLOAT_SEED;
+  for (unsigned int id = 0; id < net->nodecount; id++)
+    {
+      unsigned int pos;
+      int group = NodeGroup (nb, id, &pos);
+      AppendNodes (&(nb->groups[group]), 1,
+                   net->transfer != NULL ? net->transfer[id] : 0,
+                   net->accum != NULL ? net->accum[id] : 0,
+                   net->transferwidths != NULL ? net->transferwidths[id] : 1);
+    }
+  ReserveSynapses (nb, net->synapsecount);
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      nb->weights[conn] = net->weights[conn];
+      nb->sources[conn] = NodeKey (nb, net->sources[conn]);
+      nb->dests[conn] = NodeKey (nb, net->dests[conn]);
+    }
+  nb->synapsecount = net->synapsecount;
+  nb->compacted = 1;
+  return (nb);
+}
+
+// add newnodes nodes at the end of group, renumbering the nodes of later groups.  Returns the ID of the first new node.
+int
+BuildNodes (struct netbuilder *nb, int group, int newnodes, int transferfn,
+            int accumfn, unsigned int xfersize)
+{
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
+  unsigned int first;
+  if (group <= GROUP_BIAS || group >= NODEGROUPS || newnodes < 0)
+    {
+      Complain ("Program Error: improper call to BuildNodes.\n");
+      Fail (1);
+    }
+  if (net->nodecount == 0)
+    {                           // reserve the bias node.
+      AppendNodes (&(nb->groups[GROUP_BIAS]), 1, 0, 0, 1);
+      net->nodecount = 1;
+    }
+  first = nb->groups[GROUP_BIAS].count;
+  for (int earlier = GROUP_INPUT; earlier <= group; earlier++)
+    first += nb->groups[earlier].count;
+  AppendNodes (&(nb->groups[group]), newnodes, transferfn, accumfn, xfersize);
+  net->nodecount += newnodes;
+  if (group == GROUP_INPUT)
+    net->inputcount += newnodes;
+  else if (group == GROUP_OUTPUT)
+    net->outputcount += newnodes;
+  nb->compacted = 0;
+  return (first);
+}
+
+// connect every node from fromstart to fromend to every node from tostart to toend, in order by source and then by
+// destination.  weights holds one weight per connection in that order, or a single weight they all share
+// (weightcount 1), or is NULL to give them random weights.
+void
+BuildConnections (struct netbuilder *nb, int fromstart, int fromend,
+                  int tostart, int toend, const flotype * weights,
+                  size_t weightcount)
+{
+  assert (nb != NULL);
+  size_t count = (size_t) (1 + fromend - fromstart) * (1 + toend - tostart);
+  size_t wt = 0;
+  if (fromstart < 0 || tostart < 0 || fromstart > fromend || tostart > toend
+      || toend >= nb->net->nodecount || fromend >= nb->net->nodecount
+      || (weights != NULL && weightcount != 1 && weightcount != count))
+    {
+      Complain ("Program Error: improper call to BuildConnections.\n");
+      Fail (1);
+    }
+  ReserveSynapses (nb, count);
+  for (int from = fromstart; from <= fromend; from++)
+    {
+      uint32_t source = NodeKey (nb, from);
+      for (int to = tostart; to <= toend; to++)
+        {
+          unsigned int conn = nb->synapsecount++;
+          nb->sources[conn] = source;
+          nb->dests[conn] = NodeKey (nb, to);
+          if (weights == NULL)
+            nb->weights[conn] = randomfloat (&(nb->rndstate), -0.5, +0.5);
+          else
+            nb->weights[conn] = weights[weightcount == 1 ? 0 : wt++];
+        }
+    }
+  nb->net->synapsecount = nb->synapsecount;
+  nb->compacted = 0;
+}
+
+// exchange the len nodes starting at start with the len nodes starting at star2.  Both ranges must lie within the same
+// group and must not overlap.  Connections follow the nodes they were made to.
+void
+BuildSwapRange (struct netbuilder *nb, int start, int star2, int len)
+{
+  assert (nb != NULL);
+  unsigned int pa, pb, pe;
+  int group;
+  if (start > star2)
+    {
+      int swap = start;
+      start = star2;
+      star2 = swap;
+    }
+  if (len <= 0 || start <= 0 || star2 + len > nb->net->nodecount)
+    {
+      Complain ("Program Error: improper call to BuildSwapRange.\n");
+      Fail (1);
+    }
+  if (start + len > star2)
+    {
+      Complain ("BuildSwapRange cannot swap overlapping ranges.\n");
+      Fail (1);
+    }
+  group = NodeGroup (nb, start, &pa);
+  if (NodeGroup (nb, star2 + len - 1, &pe) != group)
+    {
+      Complain
+        ("BuildSwapRange cannot swap nodes between input, hidden, and output nodes.\n");
+      Fail (1);
+    }
+  NodeGroup (nb, star2, &pb);
+  struct nodegroup *grp = &(nb->groups[group]);
+  for (int count = 0; count < len; count++, pa++, pb++)
+    {
+      enum activation_function transfer = grp->transfer[pa];
+      enum accumulator_function accum = grp->accum[pa];
+      unsigned int width = grp->transferwidths[pa];
+      unsigned int identity = grp->identity[pa];
+      grp->transfer[pa] = grp->transfer[pb];
+      grp->accum[pa] = grp->accum[pb];
+      grp->transferwidths[pa] = grp->transferwidths[pb];
+      grp->identity[pa] = grp->identity[pb];
+      grp->transfer[pb] = transfer;
+      grp->accum[pb] = accum;
+      grp->transferwidths[pb] = width;
+      grp->identity[pb] = identity;
+      grp->position[grp->identity[pa]] = pa;
+      grp->position[grp->identity[pb]] = pb;
+    }
+  nb->compacted = 0;
+}
+
+// number every node and synapse built so far and store them in the network's arrays, sized to fit.
+void
+CompactNetwork (struct netbuilder *nb)
+{
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
+  unsigned int base[NODEGROUPS];
+  unsigned int next = 0;
+  double began = PROFILE_START (net);
+  for (int group = 0; group < NODEGROUPS; group++)
+    {
+      base[group] = next;
+      next += nb->groups[group].count;
+    }
+  assert (next == net->nodecount);
+  net->transfer =
+    Grow (net->transfer, net->nodecount, sizeof (enum activation_function));
+  net->accum =
+    Grow (net->accum, net->nodecount, sizeof (enum accumulator_function));
+  net->transferwidths =
+    Grow (net->transferwidths, net->nodecount, sizeof (unsigned int));
+  for (int group = 0; group < NODEGROUPS; group++)
+    {
+      const struct nodegroup *grp = &(nb->groups[group]);
+      memcpy (&(net->transfer[base[group]]), grp->transfer,
+              grp->count * sizeof (enum activation_function));
+      memcpy (&(net->accum[base[group]]), grp->accum,
+              grp->count * sizeof (enum accumulator_function));
+      memcpy (&(net->transferwidths[base[group]]), grp->transferwidths,
+              grp->count * sizeof (unsigned int));
+    }
+  net->synapsecount = nb->synapsecount;
+  net->weights = Grow (net->weights, net->synapsecount, sizeof (flotype));
+  net->sources = Grow (net->sources, net->synapsecount, sizeof (unsigned int));
+  net->dests = Grow (net->dests, net->synapsecount, sizeof (unsigned int));
+  memcpy (net->weights, nb->weights, net->synapsecount * sizeof (flotype));
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      uint32_t from = nb->sources[conn];
+      uint32_t to = nb->dests[conn];
+      net->sources[conn] = base[from >> KEYSHIFT]
+        + nb->groups[from >> KEYSHIFT].position[from & KEYMASK];
+      net->dests[conn] = base[to >> KEYSHIFT]
+        + nb->groups[to >> KEYSHIFT].position[to & KEYMASK];
+    }
+  nb->compacted = 1;
+  PROFILE_STOP (net, PROF_COMPILE, began);
+}
+
+// compact the network if anything was built since it was last compacted, and free the builder.
+void
+FinishNetBuilder (struct netbuilder *nb)
+{
+  assert (nb != NULL);
+  if (!nb->compacted)
+    CompactNetwork (nb);
+  DiscardNetBuilder (nb);
+}
+
+// free the builder without compacting what it holds, when building stops partway.
+void
+DiscardNetBuilder (struct netbuilder *nb)
+{
+  if (nb == NULL)
+    return;
+  for (int group = 0; group < NODEGROUPS; group++)
+    {
+      struct nodegroup *grp = &(nb->groups[group]);
+      free (grp->transfer);
+      free (grp->accum);
+      free (grp->transferwidths);
+      free (grp->position);
+      free (grp->identity);
+    }
+  free (nb->weights);
+  free (nb->sources);
+  free (nb->dests);
+  free (nb);
+}
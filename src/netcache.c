@@ -0,0 +1,416 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// network caches: saving what nnetparser made of a script, and reading it back instead of parsing the script again.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes.h"
+#include "defines.h"
+#include "netcache.h"
+#include "fail.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+// flags nnet sets from its command line rather than from the script.
+#define OPTION_FLAGS (DEBUG_ECHO | PROFILE_RUN | CACHE_NETWORK)
+
+// the sizes of the structs a cache stores whole.
+#define NETCACHE_LAYOUT ((uint32_t) (sizeof (struct plans) \
+                                     | sizeof (struct cases) << 10 \
+                                     | sizeof (enum activation_function) << 20 \
+                                     | sizeof (enum accumulator_function) << 26))
+
+// FNV-1a taken a 64-bit word at a time in four interleaved lanes, so that the multiplies overlap, then the lanes and
+// any leftover bytes folded together.  Every step is invertible, so changing any one word changes the hash.
+static uint64_t
+Hash (uint64_t seed, const void *data, size_t size)
+{
+  const unsigned char *byte = (const unsigned char *) data;
+  uint64_t lane[4] = { seed, seed ^ 1, seed ^ 2, seed ^ 3 };
+  uint64_t word;
+  size_t index;
+  for (index = 0; index + sizeof (lane) <= size; index += sizeof (lane))
+    for (int ln = 0; ln < 4; ln++)
+      {
+        memcpy (&word, &(byte[index + ln * sizeof (word)]), sizeof (word));
+        lane[ln] = (lane[ln] ^ word) * FNV_PRIME;
+      }
+  uint64_t hash = seed;
+  for (int ln = 0; ln < 4; ln++)
+    hash = (hash ^ lane[ln]) * FNV_PRIME;
+  for (; index < size; index++)
+    hash = (hash ^ byte[index]) * FNV_PRIME;
+  return (hash);
+}
+
+// hash the script open on input from its start, setting *length to its length in bytes, and rewind it for parsing.
+uint64_t
+HashScript (FILE * input, uint64_t * length)
+{
+  assert (input != NULL);
+  assert (length != NULL);
+  char block[BFLEN];
+  uint64_t hash = FNV_OFFSET;
+  size_t got;
+  *length = 0;
+  rewind (input);
+  while ((got = fread (block, 1, BFLEN, input)) > 0)
+    {
+      hash = Hash (hash, block, got);
+      *length += got;
+    }
+  rewind (input);
+  return (hash);
+}
+
+static void
+Put (FILE * out, const void *data, size_t size)
+{
+  if (size != 0)
+    fwrite (data, 1, size, out);
+}
+
+// a string is stored as its size including the terminator, or zero for NULL, followed by its characters.
+static void
+PutString (FILE * out, const char *text)
+{
+  uint64_t size = text != NULL ? strlen (text) + 1 : 0;
+  Put (out, &size, sizeof (size));
+  Put (out, text, size);
+}
+
+// Write the cache name for a script of the given hash and length, which parsed to net and config with the warnings in
+// bf.  It is written under a temporary name and renamed over name, so no run reads one half written.  A script that
+// read weight files isn't cached, and a cache that can't be written is left unwritten: it only saves time.
+void
+SaveNetCache (const char *name, uint64_t scripthash, uint64_t scriptlength,
+              const struct nnet *net, const struct conf *config,
+              const struct slidingbuffer *bf)
+{
+  assert (name != NULL);
+  assert (net != NULL && net->topology != NULL);
+  if (bf->weightfiles)
+    return;
+  const struct topology *tp = net->topology;
+  struct netcacheheader hdr;
+  uint64_t count;
+  char *payload = NULL;
+  size_t payloadlength = 0;
+  FILE *stream = open_memstream (&payload, &payloadlength);
+  if (stream == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in SaveNetCache.\n");
+      Fail (1);
+    }
+  unsigned int flags = config->flags & ~OPTION_FLAGS;
+  Put (stream, &flags, sizeof (flags));
+  Put (stream, &(config->savecount), sizeof (config->savecount));
+  PutString (stream, config->openingcomment);
+  PutString (stream, (config->flags & SAVE_DEFAULT) == 0 ? config->savename :
+             NULL);
+  PutString (stream, bf->warnings);
+  Put (stream, &(net->inputcount), sizeof (net->inputcount));
+  Put (stream, &(net->outputcount), sizeof (net->outputcount));
+  Put (stream, &(net->nodecount), sizeof (net->nodecount));
+  Put (stream, &(net->synapsecount), sizeof (net->synapsecount));
+  Put (stream, net->transfer,
+       sizeof (enum activation_function) * net->nodecount);
+  Put (stream, net->accum,
+       sizeof (enum accumulator_function) * net->nodecount);
+  Put (stream, net->transferwidths, sizeof (unsigned int) * net->nodecount);
+  Put (stream, net->weights, sizeof (flotype) * net->synapsecount);
+  Put (stream, net->sources, sizeof (unsigned int) * net->synapsecount);
+  Put (stream, net->dests, sizeof (unsigned int) * net->synapsecount);
+  Put (stream, &(tp->silent), sizeof (tp->silent));
+  Put (stream, &(tp->deaf), sizeof (tp->deaf));
+  Put (stream, &(tp->recurrent), sizeof (tp->recurrent));
+  Put (stream, &(tp->multiactivated), sizeof (tp->multiactivated));
+  Put (stream, tp->indegree, sizeof (unsigned int) * (tp->nodecount + 1));
+  Put (stream, tp->outdegree, sizeof (unsigned int) * (tp->nodecount + 1));
+  Put (stream, tp->usage, tp->nodecount + 1);
+  count = 0;
+  for (const struct plans * pl = net->plan; pl != NULL; pl = pl->next)
+    count++;
+  Put (stream, &count, sizeof (count));
+  for (const struct plans * pl = net->plan; pl != NULL; pl = pl->next)
+    {
+      Put (stream, pl, sizeof (struct plans));
+      PutString (stream, pl->outputdest);
+      PutString (stream, pl->reportdest);
+      PutString (stream, pl->inputsrc);
+    }
+  count = 0;
+  for (const struct cases * dat = net->data; dat != NULL; dat = dat->next)
+    count++;
+  Put (stream, &count, sizeof (count));
+  for (const struct cases * dat = net->data; dat != NULL; dat = dat->next)
+    {
+      Put (stream, dat, sizeof (struct cases));
+      PutString (stream, dat->inname);
+      PutString (stream, dat->outname);
+      Put (stream, dat->data, sizeof (flotype) * dat->entrycount *
+           (dat->inputcount + dat->outputcount));
+    }
+  if (fclose (stream) != 0)
+    {
+      Complain ("Runtime Error: Allocation failure in SaveNetCache.\n");
+      Fail (1);
+    }
+  memset (&hdr, 0, sizeof (struct netcacheheader));
+  memcpy (hdr.magic, NETCACHE_MAGIC, sizeof (hdr.magic));
+  hdr.version = NETCACHE_VERSION;
+  hdr.endian = NETCACHE_ENDIAN;
+  hdr.precision = sizeof (flotype);
+  hdr.layout = NETCACHE_LAYOUT;
+  hdr.scripthash = scripthash;
+  hdr.scriptlength = scriptlength;
+  hdr.payloadhash = Hash (FNV_OFFSET, payload, payloadlength);
+  hdr.payloadlength = payloadlength;
+  hdr.dataoffset = sizeof (struct netcacheheader);
+  char *tmpname = (char *) malloc (strlen (name) + 24);
+  if (tmpname == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in SaveNetCache.\n");
+      Fail (1);
+    }
+  sprintf (tmpname, "%s.%ld", name, (long) getpid ());
+  FILE *out = fopen (tmpname, "wb");
+  if (out != NULL)
+    {
+      int written =
+        fwrite (&hdr, sizeof (struct netcacheheader), 1, out) == 1
+        && fwrite (payload, 1, payloadlength, out) == payloadlength;
+      if (fclose (out) != 0 || !written || rename (tmpname, name) != 0)
+        remove (tmpname);
+    }
+  free (tmpname);
+  free (payload);
+}
+
+struct cachereader
+{
+  const char *at;
+  size_t left;
+  int damaged;                  // something ran past the end of the payload.
+};
+
+static const void *
+Take (struct cachereader *cr, size_t size)
+{
+  if (cr->damaged || size > cr->left)
+    {
+      cr->damaged = 1;
+      return (NULL);
+    }
+  const void *data = cr->at;
+  cr->at += size;
+  cr->left -= size;
+  return (data);
+}
+
+static void
+TakeValue (struct cachereader *cr, void *value, size_t size)
+{
+  const void *data = Take (cr, size);
+  if (data != NULL)
+    memcpy (value, data, size);
+}
+
+// a new allocation holding the next count items of size bytes; NULL if count is zero or the payload is short of them.
+static void *
+TakeArray (struct cachereader *cr, size_t count, size_t size)
+{
+  if (count != 0 && size > cr->left / count)
+    cr->damaged = 1;
+  const void *data = Take (cr, count * size);
+  if (data == NULL || count == 0)
+    return (NULL);
+  void *copy = malloc (count * size);
+  if (copy == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in LoadNetCache.\n");
+      Fail (1);
+    }
+  memcpy (copy, data, count * size);
+  return (copy);
+}
+
+static char *
+TakeString (struct cachereader *cr)
+{
+  uint64_t size = 0;
+  TakeValue (cr, &size, sizeof (size));
+  if (size > cr->left)
+    cr->damaged = 1;
+  char *text = (char *) TakeArray (cr, size, 1);
+  if (text != NULL && text[size - 1] != '\0')
+    {
+      free (text);
+      cr->damaged = 1;
+      return (NULL);
+    }
+  return (text);
+}
+
+// Read the cache name into net, config and the warnings of bf, if it was made by this build of nnet from a script of
+// the given hash and length.  The cache is mapped and its arrays copied out, as everything a parsed network holds is
+// its own to free or reallocate.  Returns 0, leaving them as they were, if there is no such cache.
+int
+LoadNetCache (const char *name, uint64_t scripthash, uint64_t scriptlength,
+              struct nnet *net, struct conf *config, struct slidingbuffer *bf)
+{
+  assert (name != NULL);
+  assert (net != NULL);
+  struct netcacheheader hdr;
+  struct stat st;
+  uint64_t count = 0;
+  int fd = open (name, O_RDONLY);
+  if (fd < 0)
+    return (0);
+  if (pread (fd, &hdr, sizeof (hdr), 0) != sizeof (hdr)
+      || memcmp (hdr.magic, NETCACHE_MAGIC, sizeof (hdr.magic)) != 0
+      || hdr.version != NETCACHE_VERSION || hdr.endian != NETCACHE_ENDIAN
+      || hdr.precision != sizeof (flotype) || hdr.layout != NETCACHE_LAYOUT
+      || hdr.scripthash != scripthash || hdr.scriptlength != scriptlength
+      || hdr.dataoffset != sizeof (struct netcacheheader)
+      || fstat (fd, &st) != 0
+      || (uint64_t) st.st_size != hdr.dataoffset + hdr.payloadlength)
+    {
+      close (fd);
+      return (0);
+    }
+  size_t length = st.st_size;
+  void *map = mmap (NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return (0);
+  struct cachereader cr = { (const char *) map + hdr.dataoffset,
+    hdr.payloadlength, 0
+  };
+  if (Hash (FNV_OFFSET, cr.at, cr.left) != hdr.payloadhash)
+    {
+      munmap (map, length);
+      return (0);
+    }
+  struct nnet *loaded = (struct nnet *) calloc (1, sizeof (struct nnet));
+  struct topology *tp =
+    (struct topology *) calloc (1, sizeof (struct topology));
+  if (loaded == NULL || tp == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in LoadNetCache.\n");
+      Fail (1);
+    }
+  loaded->topology = tp;
+  unsigned int flags = 0;
+  unsigned int savecount = 0;
+  TakeValue (&cr, &flags, sizeof (flags));
+  TakeValue (&cr, &savecount, sizeof (savecount));
+  char *comment = TakeString (&cr);
+  char *savename = TakeString (&cr);
+  char *warnings = TakeString (&cr);
+  TakeValue (&cr, &(loaded->inputcount), sizeof (loaded->inputcount));
+  TakeValue (&cr, &(loaded->outputcount), sizeof (loaded->outputcount));
+  TakeValue (&cr, &(loaded->nodecount), sizeof (loaded->nodecount));
+  TakeValue (&cr, &(loaded->synapsecount), sizeof (loaded->synapsecount));
+  loaded->transfer = TakeArray (&cr, loaded->nodecount,
+                                sizeof (enum activation_function));
+  loaded->accum = TakeArray (&cr, loaded->nodecount,
+                             sizeof (enum accumulator_function));
+  loaded->transferwidths = TakeArray (&cr, loaded->nodecount,
+                                      sizeof (unsigned int));
+  loaded->weights = TakeArray (&cr, loaded->synapsecount, sizeof (flotype));
+  loaded->sources = TakeArray (&cr, loaded->synapsecount,
+                               sizeof (unsigned int));
+  loaded->dests = TakeArray (&cr, loaded->synapsecount,
+                             sizeof (unsigned int));
+  tp->nodecount = loaded->nodecount;
+  TakeValue (&cr, &(tp->silent), sizeof (tp->silent));
+  TakeValue (&cr, &(tp->deaf), sizeof (tp->deaf));
+  TakeValue (&cr, &(tp->recurrent), sizeof (tp->recurrent));
+  TakeValue (&cr, &(tp->multiactivated), sizeof (tp->multiactivated));
+  tp->indegree = TakeArray (&cr, tp->nodecount + 1, sizeof (unsigned int));
+  tp->outdegree = TakeArray (&cr, tp->nodecount + 1, sizeof (unsigned int));
+  tp->usage = TakeArray (&cr, tp->nodecount + 1, 1);
+  TakeValue (&cr, &count, sizeof (count));
+  struct plans **plantail = &(loaded->plan);
+  for (uint64_t index = 0; index < count && !cr.damaged; index++)
+    {                           // rebuilt in the order they were written, the order of the list the parser made.
+      struct plans *pl = TakeArray (&cr, 1, sizeof (struct plans));
+      if (pl == NULL)
+        break;
+      pl->outputdest = TakeString (&cr);
+      pl->reportdest = TakeString (&cr);
+      pl->inputsrc = TakeString (&cr);
+      pl->next = NULL;
+      *plantail = pl;
+      plantail = &(pl->next);
+    }
+  count = 0;
+  TakeValue (&cr, &count, sizeof (count));
+  struct cases **datatail = &(loaded->data);
+  for (uint64_t index = 0; index < count && !cr.damaged; index++)
+    {
+      struct cases *dat = TakeArray (&cr, 1, sizeof (struct cases));
+      if (dat == NULL)
+        break;
+      dat->flags &= ~DATA_MAPPED;
+      dat->inname = TakeString (&cr);
+      dat->outname = TakeString (&cr);
+      dat->inpipe = dat->outpipe = NULL;
+      dat->next = NULL;
+      dat->data = cr.damaged ? NULL : TakeArray (&cr, dat->entrycount,
+                                                  sizeof (flotype) *
+                                                  (dat->inputcount +
+                                                   dat->outputcount));
+      *datatail = dat;
+      datatail = &(dat->next);
+    }
+  int damaged = cr.damaged || cr.left != 0;
+  munmap (map, length);
+  if (damaged)
+    {
+      FreeNnet (loaded);
+      free (comment);
+      free (savename);
+      free (warnings);
+      return (0);
+    }
+  loaded->profile = net->profile;
+  *net = *loaded;
+  free (loaded);
+  config->flags = flags | (config->flags & OPTION_FLAGS);
+  config->savecount = savecount;
+  free (config->openingcomment);
+  config->openingcomment = comment;
+  if (savename != NULL)
+    {
+      free (config->savename);
+      config->savename = savename;
+    }
+  bf->warnings = warnings;
+  bf->warnlen = warnings != NULL ? strlen (warnings) : 0;
+  bf->warncap = warnings != NULL ? bf->warnlen + 1 : 0;
+  return (1);
+}
@@ -45,6 +45,8 @@
 #include "simulated_annealing.h"
 #include "gradient_descent.h"
 #include "genetic_algorithm.h"
+#include "rnd.h"
+#include "fail.h"
 
 /*
  * network* API
@@ -112,7 +114,7 @@ network_set_neuron_number (network * nn, unsigned long nr)
   if (!nn->neurons)
     {
       printf ("No memory available to allocate the neurons array!\n");
-      exit (-1);
+      Fail (-1);
     }
 
   memset (nn->neurons, 0, sizeof (neuron) * nr);
@@ -146,7 +148,7 @@ network_set_layer_number (network * nn, unsigned long nr)
   if (!nn->layers)
     {
       printf ("No memory available to allocate the layers array!\n");
-      exit (-1);
+      Fail (-1);
     }
   memset (nn->layers, 0, sizeof (layer) * nr);
 
@@ -176,7 +178,7 @@ network_neuron_set_connection_number (neuron * ne, unsigned int nr)
   if (!ne->connection)
     {
       printf ("No memory available to allocate the connetcion array!\n");
-      exit (-1);
+      Fail (-1);
     }
 
   memset (ne->connection, 0, sizeof (neuron *) * nr);
@@ -185,7 +187,7 @@ network_neuron_set_connection_number (neuron * ne, unsigned int nr)
   if (!ne->w)
     {
       printf ("No memory available to allocate the y array!\n");
-      exit (-1);
+      Fail (-1);
     }
 
   for (i = 0; i < nr; ++i)
@@ -344,7 +346,7 @@ network_run_algorithm (network * nn, network_config * config)
     {
       /* print the network topology in case of error... */
       network_print (nn);
-      exit (-1);
+      Fail (-1);
     }
 
   /* network_print(nn); */
@@ -360,7 +362,11 @@ network_config_alloc ()
 {
   network_config *config = (network_config *) malloc (sizeof (*config));
   if (config)
-    memset (config, 0, sizeof (*config));
+    {
+      memset (config, 0, sizeof (*config));
+      config->rndstate = RND_SEED;
+      config->crossovermax = 1;
+    }
   return config;
 }
 
@@ -406,8 +412,8 @@ nnet_alloc_default ()
   struct nnet *retval = (struct nnet *) calloc (1, sizeof (struct nnet));
   if (retval == NULL)
     {
-      printf ("Unable to allocate (in nnet_alloc_default).\n");
-      exit (1);
+      Complain ("Unable to allocate (in nnet_alloc_default).\n");
+      Fail (1);
     }
   //calloc does the right thing here: all pointers are NULL, all counts are zero.
   return (retval);
@@ -421,28 +427,31 @@ SwapRange (struct nnet *net, int start, int star2, int len)
   int swap;
   unsigned int wsap;
   if (start > star2)
-    SwapRange (net, star2, start, len);
-  if (net == NULL || len < 0 || start < 0 || star2 < 0
-      || star2 + len >= net->nodecount)
     {
-      printf ("improper call to SwapRange.\n");
-      exit (1);
+      SwapRange (net, star2, start, len);
+      return;
+    }
+  if (net == NULL || len < 0 || start <= 0 || star2 + len > net->nodecount)
+    {
+      Complain ("improper call to SwapRange.\n");
+      Fail (1);
     }
-  if (start + len >= star2)
+  if (start + len > star2)
     {
-      printf ("SwapRange cannot swap overlapping ranges.\n");
-      exit (1);
+      Complain ("SwapRange cannot swap overlapping ranges.\n");
+      Fail (1);
     }
-  if (start < net->inputcount && star2 + len >= net->inputcount)
+  if (start <= net->inputcount && star2 + len > net->inputcount + 1)
     {
-      printf ("SwapRange cannot swap between input and non-input nodes.\n");
-      exit (1);
+      Complain ("SwapRange cannot swap between input and non-input nodes.\n");
+      Fail (1);
     }
   if (start < (net->nodecount - net->outputcount)
-      && star2 + len >= (net->nodecount - net->outputcount))
+      && star2 + len > (net->nodecount - net->outputcount))
     {
-      printf ("SwapRange cannot swap between output and non-output nodes.\n");
-      exit (1);
+      Complain
+        ("SwapRange cannot swap between output and non-output nodes.\n");
+      Fail (1);
     }
   for (count = 0; count < len; count++)
     {
@@ -458,30 +467,31 @@ SwapRange (struct nnet *net, int start, int star2, int len)
     }
   for (count = 0; count < net->synapsecount; count++)
     {
-      if (net->sources[count] > start && net->sources[count] < start + len)
+      if (net->sources[count] >= start && net->sources[count] < start + len)
         net->sources[count] += (star2 - start);
-      else if (net->sources[count] > star2
+      else if (net->sources[count] >= star2
                && net->sources[count] < star2 + len)
-        net->sources[count] += (start - star2);
-      if (net->dests[count] > start && net->dests[count] < start + len)
+        net->sources[count] -= (star2 - start);
+      if (net->dests[count] >= start && net->dests[count] < start + len)
         net->dests[count] += (star2 - start);
-      else if (net->dests[count] > star2 && net->dests[count] < star2 + len)
-        net->dests[count] += (start - star2);
+      else if (net->dests[count] >= star2 && net->dests[count] < star2 + len)
+        net->dests[count] -= (star2 - start);
     }
 }
 
 // add (newcount) new nodes starting at (startloc). update synapses to maintain pre-existing connectivity. new nodes
 // should have the specified accumulator and transfer functions and transfer size - but being new will have no incoming
 // or outgoing connections.  This is NOT public - it could insert new nodes only part of which are in the input or
-// output ranges accidentally breaking input/output to connectivity mappings even though it preserves connectivity.
+// output ranges accidentally breaking input/output to connectivity mappings even though it preserves connectivity.  Each call takes time linear in
+// the size of the network; a netbuilder (netbuilder.h) builds a whole network in linear time.
 int
 InsertNodes (struct nnet *net, int startloc, int newcount, int transferfn,
              int accumfn, unsigned int xfersize)
 {
   if (net == NULL || newcount < 0)
     {
-      fprintf (stderr, "Program Error: improper call to InsertNodes.\n");
-      exit (1);
+      Complain ("Program Error: improper call to InsertNodes.\n");
+      Fail (1);
     }
   if (net->nodecount == 0)
     {
@@ -499,9 +509,8 @@ InsertNodes (struct nnet *net, int startloc, int newcount, int transferfn,
       free (newtrans);
       free (newacc);
       free (xwidth);
-      fprintf (stderr,
-               "Runtime error: allocation failure while inserting nodes.\n");
-      exit (1);
+      Complain ("Runtime error: allocation failure while inserting nodes.\n");
+      Fail (1);
     }
   newtrans[0] = 0;
   newacc[0] = 0;
@@ -561,8 +570,8 @@ AddInputNodes (struct nnet *net, int newnodes, int transferfn, int accumfn,
 {
   net->inputcount += newnodes;
   return (InsertNodes
-          (net, net->inputcount - newnodes, newnodes, transferfn, accumfn,
-           xfersize));
+          (net, net->inputcount - newnodes + (net->nodecount != 0), newnodes,
+           transferfn, accumfn, xfersize));
 }
 
 
@@ -591,8 +600,8 @@ AddConnections (struct nnet *net, int fromstart, int fromend, int tostart,
   net->dests = (unsigned int *) realloc (net->dests, newcount * sizeof (int));
   if (net->weights == NULL || net->sources == NULL || net->dests == NULL)
     {
-      printf ("Runtime error: allocation failure in AddConnections.\n");
-      exit (1);
+      Complain ("Runtime error: allocation failure in AddConnections.\n");
+      Fail (1);
     }
   for (int from = fromstart; from <= fromend; from++)
     for (int to = tostart; to <= toend; to++)
@@ -603,10 +612,10 @@ AddConnections (struct nnet *net, int fromstart, int fromend, int tostart,
       }
 }
 
-// insert randomized connections into an existing network.
+// insert randomized connections into an existing network, drawing their weights from the generator *rndstate.
 void
-AddRandomizedConnections (struct nnet *net, int fromstart, int fromend,
-                          int tostart, int toend)
+AddRandomizedConnections (struct nnet *net, uint64_t * rndstate,
+                          int fromstart, int fromend, int tostart, int toend)
 {
   // int wt = 0;
   int newcount =
@@ -620,7 +629,7 @@ AddRandomizedConnections (struct nnet *net, int fromstart, int fromend,
     {
       printf
         ("Runtime error: Allocation failure in AddRandomizedConnections.\n");
-      exit (1);
+      Fail (1);
     }
   for (int from = fromstart; from <= fromend; from++)
     for (int to = tostart; to <= toend; to++)
@@ -629,7 +638,7 @@ AddRandomizedConnections (struct nnet *net, int fromstart, int fromend,
         net->dests[net->synapsecount] = to;
         // FIXME: at some future stage of development auto-optimize the random ranges per Bengio & Glorot's paper, and Hinton's addendum to that paper.
         // And/or punt to the user and ask/allow THEM to specify a range for initialization.
-        net->weights[net->synapsecount++] = randomfloat (-0.5, +0.5);
+        net->weights[net->synapsecount++] = randomfloat (rndstate, -0.5, +0.5);
       }
 }
 
@@ -683,7 +692,7 @@ convertnetwork (struct _network *oldnet)
     {                           // if unable to allocate
       free (newval->weights);
       free (newval->sources);
-      free (newval->weights);
+      free (newval->dests);
       free (newval->transfer);
       free (newval->accum);
       free (newval);
@@ -751,3 +760,127 @@ convertnetwork (struct _network *oldnet)
       }
   return (newval);
 }
+
+// The parser prepends plans and data sets, so their lists are in reverse script order.  These return arrays of the
+// *count elements of a list in script order, for the caller to free, leaving the lists themselves alone so they can be
+// read concurrently (by the checkpoint writer, for one).
+struct plans **
+PlansInOrder (struct plans *list, size_t *count)
+{
+  assert (count != NULL);
+  struct plans **order;
+  struct plans *pl;
+  *count = 0;
+  for (pl = list; pl != NULL; pl = pl->next)
+    (*count)++;
+  order = (struct plans **) malloc ((*count + 1) * sizeof (struct plans *));
+  if (order == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in PlansInOrder.\n");
+      Fail (1);
+    }
+  size_t index = *count;
+  for (pl = list; pl != NULL; pl = pl->next)
+    order[--index] = pl;
+  return (order);
+}
+
+struct cases **
+CasesInOrder (struct cases *list, size_t *count)
+{
+  assert (count != NULL);
+  struct cases **order;
+  struct cases *dat;
+  *count = 0;
+  for (dat = list; dat != NULL; dat = dat->next)
+    (*count)++;
+  order = (struct cases **) malloc ((*count + 1) * sizeof (struct cases *));
+  if (order == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in CasesInOrder.\n");
+      Fail (1);
+    }
+  size_t index = *count;
+  for (dat = list; dat != NULL; dat = dat->next)
+    order[--index] = dat;
+  return (order);
+}
+
+// returns nonzero if node saves signal across activation sequences (it sends before it receives).
+int
+IsRecurrentNode (const struct nnet *net, const struct topology *tp,
+                 unsigned int node)
+{
+  return (tp->usage[node] >= 4 && node < net->nodecount - net->outputcount);
+}
+
+// returns nonzero if node will be activated more than once per activation sequence.
+int
+IsMultiActivatedNode (const struct nnet *net, const struct topology *tp,
+                      unsigned int node)
+{
+  return (tp->usage[node] == 7
+          || (tp->usage[node] > 4
+              && node >= net->nodecount - net->outputcount));
+}
+
+// summarize the topology of net in one pass over its synapses and one over its nodes.
+struct topology *
+SummarizeTopology (const struct nnet *net)
+{
+  assert (net != NULL);
+  struct topology *tp = (struct topology *) malloc (sizeof (struct topology));
+  if (tp != NULL)
+    {
+      tp->indegree =
+        (unsigned int *) calloc (net->nodecount + 1, sizeof (unsigned int));
+      tp->outdegree =
+        (unsigned int *) calloc (net->nodecount + 1, sizeof (unsigned int));
+      tp->usage = (unsigned char *) calloc (net->nodecount + 1, 1);
+    }
+  if (tp == NULL || tp->indegree == NULL || tp->outdegree == NULL
+      || tp->usage == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in SummarizeTopology.\n");
+      Fail (1);
+    }
+  // next usage state of a node used as a source, and as a destination, indexed by its current state.
+  static const unsigned char assource[8] = { 3, 2, 2, 3, 6, 7, 6, 7 };
+  static const unsigned char asdest[8] = { 1, 1, 5, 4, 4, 5, 7, 7 };
+  tp->nodecount = net->nodecount;
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      unsigned int from = net->sources[conn];
+      unsigned int to = net->dests[conn];
+      tp->outdegree[from]++;
+      tp->indegree[to]++;
+      tp->usage[from] = assource[tp->usage[from]];
+      tp->usage[to] = asdest[tp->usage[to]];
+    }
+  tp->silent = tp->deaf = tp->recurrent = tp->multiactivated = 0;
+  for (unsigned int node = 1; node < net->nodecount; node++)
+    {
+      if (node < net->nodecount - net->outputcount
+          && tp->outdegree[node] == 0)
+        tp->silent++;
+      if (node > net->inputcount && tp->indegree[node] == 0)
+        tp->deaf++;
+    }
+  for (unsigned int node = 0; node < net->nodecount; node++)
+    {
+      tp->recurrent += IsRecurrentNode (net, tp, node);
+      tp->multiactivated += IsMultiActivatedNode (net, tp, node);
+    }
+  return (tp);
+}
+
+void
+FreeTopology (struct topology *tp)
+{
+  if (tp == NULL)
+    return;
+  free (tp->indegree);
+  free (tp->outdegree);
+  free (tp->usage);
+  free (tp);
+}
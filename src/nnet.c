@@ -25,29 +25,67 @@
 #include "defines.h"
 #include "parser.h"
 #include "save.h"
+#include "plans.h"
+#include "casefile.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "netcache.h"
 
-#define HELPSTRING  "usage: nnet <filename> | nnet -v | nnet -h | nnet -H | nnet -l \nOptions:\n\
+#define HELPSTRING  "usage: nnet [-d] [-k] [-p | -P <n>] <filename> | nnet -c <filename> | nnet -v | nnet -h | nnet -H | nnet -l \nOptions:\n\
+  -c, --convert:   write the script's data sets to binary case files, and exit.\n\
+  -d, --debug:     echo the script with line numbers while reading it.\n\
+  -k, --cache:     start from filename.nnb, the parsed script, while the script is unchanged.\n\
+  -p, --profile:   report where the run's time goes with each plan's results.\n\
+  -P, --profile-nodes <n>: as -p, also timing each transfer function and each range of n nodes.\n\
   -h, -?, --help:  print this help and exit.\n\
   -H, --manpage:   print a manual fully describing nnet.\n\
   -l, --language:  print a manual describing the nnet script language.\n\
   -v, --version:   version and copyright information.\n"
 
+// handle options that print something and exit (returning 0), set *convert if asked to convert data sets, and set
+// *flags for options that change how the script is processed.  *ranges is set to the size of the node ranges -P times.
 int
-HandleOptions (int argc, char **argv)
+HandleOptions (int argc, char **argv, int *convert, unsigned int *flags,
+               unsigned int *ranges)
 {                               // name, args, NULL, returnval
   static struct option options[] = {
     {"help", no_argument, NULL, 'h'}, {"version", no_argument, NULL, 'v'},
     {"manpage", no_argument, NULL, 'H'}, {"language", no_argument, NULL, 'l'},
+    {"convert", no_argument, NULL, 'c'}, {"debug", no_argument, NULL, 'd'},
+    {"cache", no_argument, NULL, 'k'}, {"profile", no_argument, NULL, 'p'},
+    {"profile-nodes", required_argument, NULL, 'P'},
     {"?", no_argument, NULL, '?'}, {0, 0, 0, 0}
   };
   int opt;
   opterr = 0;
-  while ((opt = getopt_long (argc, argv, "hvHl", options, NULL)) != -1)
+  while ((opt = getopt_long (argc, argv, "hvHlcdkpP:", options, NULL)) != -1)
     switch (opt)
       {
+      case 'c':
+        *convert = 1;
+        break;
+      case 'd':
+        *flags |= DEBUG_ECHO;
+        break;
+      case 'k':
+        *flags |= CACHE_NETWORK;
+        break;
+      case 'p':
+        *flags |= PROFILE_RUN;
+        break;
+      case 'P':
+        *flags |= PROFILE_RUN;
+        *ranges = (unsigned int) strtoul (optarg, NULL, 10);
+        if (*ranges == 0)
+          {
+            fprintf (stderr,
+                     "-P needs a positive number of nodes to time together.\n");
+            exit (1);
+          }
+        break;
       case 'v':
         printf
-          ("nnet 0.0.1\nCopyright(C) 2016-2017 gneural_network developers\nLicense LGPLv3+. For information about copying, modifying, "
+          ("nnet 0.0.1 (" FLOTYPE_NAME " precision)\nCopyright(C) 2016-2017 gneural_network developers\nLicense LGPLv3+. For information about copying, modifying, "
            "and distribution see <http://gnu.org/licenses/lgpl.html>.\n");
         return (0);
       case 'H':
@@ -121,42 +159,6 @@ GetFileNames (char *readname, struct conf *config, const char *arg)
 }
 
 
-// if not serializing, filename = config->savename.
-// if serializing & there is a dot in the filename, last dot in filename is replaced with dot,++serial,dot
-// if serializing & there is no dot in the filename, the filename is extended with dot-serial.
-// if serializing, increment serial number in config.
-// filename is a 256-char buffer.
-void
-NameOutputFile (char *filename, struct conf *config)
-{
-  size_t lastdot = 0;
-  size_t len = strlen (config->savename);
-  size_t index = len;
-  size_t writeindex = 0;
-  if ((config->flags & SAVE_SERIALIZE) == 0)
-    {
-      strncpy (filename, config->savename, 255);
-      return;
-    }
-  for (index = 1; index <= len && config->savename[len - index] != '.';
-       index++);
-  lastdot = (config->savename[len - index] == '.') ? len - index : len;
-  for (index = 0; (index <= len) && writeindex < 256; index++)
-    if (index != lastdot)
-      {
-        filename[writeindex++] = config->savename[index];
-        if (index + 1 == len && lastdot == len)
-          writeindex +=
-            snprintf (&(filename[writeindex]), 255 - index, ".%d",
-                      ++(config->serialnum));
-      }
-    else
-      writeindex +=
-        snprintf (&(filename[writeindex]), 255 - index, ".%d.",
-                  ++(config->serialnum));
-  filename[writeindex] = 0;
-}
-
 int
 main (int argc, char **argv)
 {
@@ -166,13 +168,16 @@ main (int argc, char **argv)
   char fname[256];
   fname[0] = 0;
   char *filename = &(fname[0]);
-  if (!HandleOptions (argc, argv))
+  int convert = 0;
+  unsigned int optflags = 0;
+  unsigned int ranges = 0;
+  if (!HandleOptions (argc, argv, &convert, &optflags, &ranges))
     exit (0);
-  if (argc > 2)
+  if (argc - optind > 1)
     fprintf (stderr,
              "%s does not process more than one nnet script in a single invocation.\n",
              argv[0]);
-  if (argc != 2)
+  if (argc - optind != 1)
     {
       fprintf (stderr,
                "Usage:  %s [filename] where 'filename.nnet' is the name of a nnet script.\n",
@@ -182,13 +187,39 @@ main (int argc, char **argv)
   memset (&newt, 0, sizeof (struct nnet));
   memset (&bf, 0, sizeof (struct slidingbuffer));
   memset (&netconf, 0, sizeof (struct conf));
-  GetFileNames (filename, &netconf, argv[1]);
+  netconf.flags = optflags;
+  GetFileNames (filename, &netconf, argv[optind]);
   if (NULL == (bf.input = fopen (filename, "r")))
     {
       fprintf (stderr, "unable to open %s\n", filename);
       exit (1);
     }
-  nnetparser (&newt, &netconf, &bf);
+  if ((optflags & PROFILE_RUN) != 0)
+    newt.profile = StartProfile (ranges);
+  double began = PROFILE_START (&newt);
+  int caching = (optflags & (CACHE_NETWORK | DEBUG_ECHO)) == CACHE_NETWORK;       // -d echoes the script as it's read.
+  char cachename[256];
+  uint64_t scripthash = 0;
+  uint64_t scriptlength = 0;
+  if (caching)
+    {                           // filename ends in .nnet; the cache is named for it.
+      strcpy (cachename, filename);
+      strcpy (&(cachename[strlen (cachename) - 5]), NETCACHE_EXT);
+      scripthash = HashScript (bf.input, &scriptlength);
+    }
+  if (!caching
+      || !LoadNetCache (cachename, scripthash, scriptlength, &newt, &netconf,
+                        &bf))
+    {
+      nnetparser (&newt, &netconf, &bf);
+      if (caching)
+        SaveNetCache (cachename, scripthash, scriptlength, &newt, &netconf,
+                      &bf);
+    }
+  if (newt.profile != NULL)     // validating and compiling, counted on their own, are left out of parsing.
+    ProfileCount (newt.profile, PROF_PARSE,
+                  began + newt.profile->seconds[PROF_VALIDATE] +
+                  newt.profile->seconds[PROF_COMPILE]);
   fflush (stdout);
   PrintWarnings (&bf);
   if ((netconf.flags & SILENCE_DEBUG) != 0)
@@ -210,15 +241,17 @@ main (int argc, char **argv)
     }
   fclose (bf.input);
   bf.input = NULL;
-  NameOutputFile (filename, &netconf);
-  FILE *outf = fopen (filename, "w");
-  if (outf == NULL)
+  if (convert)
     {
-      fprintf (stderr, "unable to open %s", filename);
-      exit (1);
+      ConvertDataSets (&newt, filename);
+      exit (0);
     }
+  struct checkpointer *saver = StartCheckpoints (&newt, &netconf);
+  ExecutePlans (&newt, &netconf, saver);
   if ((netconf.flags & SILENCE_DEBUG) != 0)
     debugnnet (&newt);
-  nnetwriter (&newt, &netconf, outf);
-  fclose (outf);
+  Checkpoint (saver);           // the final save, after all plans are carried out.
+  FinishCheckpoints (saver);
+  ProfileReport (&newt, stdout, "Finish");
+  FreeProfile (newt.profile);
 }
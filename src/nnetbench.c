@@ -0,0 +1,563 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+// nnetbench: times both engines over synthetic networks of several sizes, for 'make bench'.  Every measurement is
+// repeated BENCH_REPS times, each run lasting at least BENCH_RUNTIME seconds, and the median rate is reported with the
+// spread between the quartile runs.  Where perf_event_open permits, each run also counts cycles, instructions, cache
+// misses and branch misses, reported per synapse (or per byte or iteration) to show what bounds each kernel.
+
+#include <unistd.h>
+#include <errno.h>
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "parser.h"
+#include "save.h"
+#include "error.h"
+#include "feedforward.h"
+#include "randomize.h"
+#include "backprop.h"
+#include "profile.h"
+#include "benchmark.h"
+#include "netcache.h"
+#include "testnet.h"
+
+#define BENCH_REPS     9
+#define BENCH_RUNTIME  0.05
+#define BENCH_BATCH    256
+#define BENCH_FANIN    8        // sources of each node of a sparse network.
+#define BENCH_WINDOW   8        // steps a recurrent network is trained through.
+#define BENCH_CACHE    "nnetbench" NETCACHE_EXT  // written in the current directory, and removed when measured.
+
+static int reps = BENCH_REPS;
+static double runtime = BENCH_RUNTIME;
+static struct counters counters;
+static int counting;            // whether any hardware counter could be opened.
+
+// a measurement runs some number of units of work and returns how many it ran.
+typedef size_t (*benchfn) (void *, size_t);
+
+static int
+CompareDoubles (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return ((x > y) - (x < y));
+}
+
+// print the median of the reps values of a counter metric, or a dash for a counter that couldn't be opened.
+static void
+PrintMetric (double *values, int event, const char *format,
+             const char *label)
+{
+  if (counters.fd[event] < 0)
+    printf (" %10s %s", "-", label);
+  else
+    {
+      qsort (values, reps, sizeof (double), CompareDoubles);
+      printf (format, values[reps / 2]);
+      printf (" %s", label);
+    }
+}
+
+// run fn often enough that one run takes at least runtime seconds, then time reps runs and print the median number of
+// units per second (divided by scale) under name.  With hardware counters, a second line gives their median counts
+// per piece of work, each unit of work being work pieces called workname.
+static void
+Measure (const char *name, const char *units, double scale, benchfn fn,
+         void *arg, double work, const char *workname)
+{
+  double rates[BENCH_REPS];
+  double metrics[COUNTERS][BENCH_REPS];
+  size_t count = 1;
+  for (;;)
+    {                           // find how many units make a run long enough to time.
+      double began = ProfileClock ();
+      fn (arg, count);
+      double elapsed = ProfileClock () - began;
+      if (elapsed >= runtime)
+        break;
+      count = elapsed > runtime / 64 ? (size_t) (count * 1.2 * runtime /
+                                                 elapsed) + 1 : count * 8;
+    }
+  for (int rep = 0; rep < reps; rep++)
+    {
+      StartCounters (&counters);
+      double began = ProfileClock ();
+      size_t done = fn (arg, count);
+      double elapsed = ProfileClock () - began;
+      StopCounters (&counters);
+      rates[rep] = done / elapsed / scale;
+      const double pieces = done * work;
+      metrics[COUNTER_CYCLES][rep] = counters.value[COUNTER_CYCLES] / pieces;
+      metrics[COUNTER_INSTRUCTIONS][rep] =
+        (double) counters.value[COUNTER_INSTRUCTIONS] /
+        MAX (counters.value[COUNTER_CYCLES], 1);
+      metrics[COUNTER_LLC_MISSES][rep] =
+        counters.value[COUNTER_LLC_MISSES] / pieces;
+      metrics[COUNTER_BRANCH_MISSES][rep] =
+        counters.value[COUNTER_BRANCH_MISSES] / pieces;
+    }
+  qsort (rates, reps, sizeof (double), CompareDoubles);
+  double median = rates[reps / 2];
+  printf ("  %-44s %12.5g %-14s +-%.1f%%\n", name, median, units,
+          50.0 * (rates[(3 * reps) / 4] - rates[reps / 4]) / median);
+  if (counting)
+    {
+      printf ("    per %-9s", workname);
+      PrintMetric (metrics[COUNTER_CYCLES], COUNTER_CYCLES, " %10.4g",
+                   "cycles");
+      PrintMetric (metrics[COUNTER_INSTRUCTIONS], COUNTER_INSTRUCTIONS,
+                   " %10.3f", "IPC");
+      PrintMetric (metrics[COUNTER_LLC_MISSES], COUNTER_LLC_MISSES,
+                   " %10.4g", "cache misses");
+      PrintMetric (metrics[COUNTER_BRANCH_MISSES], COUNTER_BRANCH_MISSES,
+                   " %10.4g", "branch misses");
+      printf ("\n");
+    }
+  fflush (stdout);
+}
+
+/* ---------------------------------------------------------------------------------------------------------------- */
+/* the gneural_network engine: layered networks written in its own script language                                 */
+
+struct layered
+{
+  network *nn;
+  network_config *config;
+  int method;                   // enum optimization_method being timed.
+};
+
+static size_t
+RunFeedforward (void *arg, size_t count)
+{
+  struct layered *lay = (struct layered *) arg;
+  for (size_t n = 0; n < count; n++)
+    feedforward (lay->nn);
+  return (count);
+}
+
+static size_t
+RunError (void *arg, size_t count)
+{
+  struct layered *lay = (struct layered *) arg;
+  for (size_t n = 0; n < count; n++)
+    error (lay->nn, lay->config);
+  return (count);
+}
+
+// run the optimizer for count of its iterations.  The accuracy is set out of reach so that none stops early.
+static size_t
+RunOptimizer (void *arg, size_t count)
+{
+  struct layered *lay = (struct layered *) arg;
+  network_config *config = lay->config;
+  config->verbosity = OFF;
+  config->accuracy = 1.e-300;
+  count = SetOptimizer (config, lay->method, count);
+  randomize (lay->nn, config);
+  Quiet ();
+  network_run_algorithm (lay->nn, config);
+  Loud ();
+  return (count);
+}
+
+static void
+BenchLayered (const int *sizes, int layers)
+{
+  static const struct
+  {
+    int method;
+    const char *name;
+    const char *units;
+    const char *unit;
+  } optimizers[] = {
+    {RANDOM_SEARCH, "random search", "attempts/s", "attempt"},
+    {SIMULATED_ANNEALING, "simulated annealing", "temps/s", "temp"},
+    {GRADIENT_DESCENT, "gradient descent", "steps/s", "step"},
+    {GENETIC_ALGORITHM, "genetic algorithm", "generations/s", "generation"},
+    {MSMCO, "multi-scale Monte Carlo", "iterations/s", "iteration"}
+  };
+  struct layered lay;
+  char label[64];
+  int used = 0;
+  for (int layer = 0; layer < layers; layer++)
+    used += snprintf (&(label[used]), sizeof (label) - used,
+                      layer == 0 ? "%d" : "-%d", sizes[layer]);
+  char *script = LayeredScript (sizes, layers);
+  FILE *in = fmemopen (script, strlen (script), "r");
+  lay.nn = network_alloc ();
+  lay.config = network_config_alloc_default ();
+  if (in == NULL || lay.nn == NULL || lay.config == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in BenchLayered.\n");
+      exit (1);
+    }
+  Quiet ();
+  parser (lay.nn, lay.config, in);
+  Loud ();
+  fclose (in);
+  randomize (lay.nn, lay.config);
+  double synapses = 0;
+  for (int id = 0; id < lay.nn->num_of_neurons; id++)
+    synapses += lay.nn->neurons[id].num_input;
+  printf ("gneural_network %s (%u neurons):\n", label, lay.nn->num_of_neurons);
+  Measure ("feedforward()", "calls/s", 1.0, RunFeedforward, &lay, synapses,
+           "synapse");
+  Measure ("error() over 8 cases", "calls/s", 1.0, RunError, &lay,
+           synapses * lay.config->num_cases, "synapse");
+  for (size_t index = 0; index < sizeof (optimizers) / sizeof (optimizers[0]);
+       index++)
+    {
+      lay.method = optimizers[index].method;
+      Measure (optimizers[index].name, optimizers[index].units, 1.0,
+               RunOptimizer, &lay, 1.0, optimizers[index].unit);
+    }
+  network_free (lay.nn);
+  network_config_free (lay.config);
+  free (script);
+}
+
+/* ---------------------------------------------------------------------------------------------------------------- */
+/* the nnet engine: dense, sparse and recurrent networks written in the nnet script language                       */
+
+#define TOPOLOGY_DENSE      0
+#define TOPOLOGY_SPARSE     1
+#define TOPOLOGY_RECURRENT  2
+
+struct scripted
+{
+  const char *script;
+  size_t length;
+  struct nnet *net;
+  struct slidingbuffer *bf;
+  size_t written;               // bytes nnetwriter writes for net.
+  flotype *inputs;              // BENCH_BATCH cases, node-major.
+  flotype *targets;
+};
+
+static void
+ConnectRange (FILE * out, unsigned int from, unsigned int fromcount,
+              unsigned int to, unsigned int tocount)
+{
+  fprintf (out, "    Connect({%u %u} {%u %u} [", from, from + fromcount - 1,
+           to, to + tocount - 1);
+  for (unsigned int count = 0; count < fromcount * tocount; count++)
+    fprintf (out, count == 0 ? "%.9g" : " %.9g", Uniform (-0.3, 0.3));
+  fprintf (out, "])\n");
+}
+
+// write an nnet script for inputs -> width -> width -> outputs with the given topology.  Dense networks connect every
+// node of a layer to every node of the next, sparse ones each node to BENCH_FANIN random nodes of the layer before,
+// and recurrent ones are dense with the second hidden layer feeding the first on the next step.
+static char *
+NnetScript (int topology, unsigned int inputs, unsigned int width,
+            unsigned int outputs, size_t *length)
+{
+  char *text = NULL;
+  FILE *out = open_memstream (&text, length);
+  const unsigned int first[4] = { 1, 1 + inputs, 1 + inputs + width,
+    1 + inputs + 2 * width
+  };
+  const unsigned int sizes[4] = { inputs, width, width, outputs };
+  fprintf (out, "StartNodes\n    CreateInput(%u None Identity)\n"
+           "    CreateHidden(%u Add Tanh)\n    CreateHidden(%u Add Tanh)\n"
+           "    CreateOutput(%u Add Identity)\nEndNodes\n\nStartConnections\n",
+           inputs, width, width, outputs);
+  for (int layer = 1; layer < 4; layer++)
+    {
+      ConnectRange (out, 0, 1, first[layer], sizes[layer]);
+      if (topology != TOPOLOGY_SPARSE
+          || sizes[layer - 1] <= BENCH_FANIN)
+        ConnectRange (out, first[layer - 1], sizes[layer - 1], first[layer],
+                      sizes[layer]);
+      else
+        for (unsigned int to = 0; to < sizes[layer]; to++)
+          for (unsigned int syn = 0; syn < BENCH_FANIN; syn++)
+            fprintf (out, "    Connect(%u %u %.9g)\n",
+                     first[layer - 1] + (unsigned int) (random () %
+                                                        sizes[layer - 1]),
+                     first[layer] + to, Uniform (-0.3, 0.3));
+    }
+  if (topology == TOPOLOGY_RECURRENT)
+    ConnectRange (out, first[2], width, first[1], width);
+  fprintf (out, "EndConnections\n");
+  fclose (out);
+  return (text);
+}
+
+// parse text into a network of its own.  The network's arrays are released by FreeNnet.
+static struct nnet *
+ParseScript (const char *text, size_t length, struct slidingbuffer *bf)
+{
+  struct nnet *net = (struct nnet *) calloc (1, sizeof (struct nnet));
+  struct conf config;
+  memset (&config, 0, sizeof (struct conf));
+  memset (bf, 0, sizeof (struct slidingbuffer));
+  config.flags = SILENCE_BIAS | SILENCE_RECURRENCE | SILENCE_NODEINPUT |
+    SILENCE_NODEOUTPUT | SILENCE_MULTIACTIVATION;
+  bf->input = fmemopen ((void *) text, length, "r");
+  if (net == NULL || bf->input == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in ParseScript.\n");
+      exit (1);
+    }
+  nnetparser (net, &config, bf);
+  fclose (bf->input);
+  free (bf->warnings);
+  free (config.openingcomment);
+  return (net);
+}
+
+static size_t
+RunParser (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  for (size_t n = 0; n < count; n++)
+    FreeNnet (ParseScript (sc->script, sc->length, sc->bf));
+  return (count * sc->length);
+}
+
+// what nnet -k does in place of parsing: hash the script and read its network cache.
+static size_t
+RunCacheLoad (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  struct conf config;
+  uint64_t length;
+  for (size_t n = 0; n < count; n++)
+    {
+      struct nnet *net = (struct nnet *) calloc (1, sizeof (struct nnet));
+      FILE *script = fmemopen ((void *) sc->script, sc->length, "r");
+      if (net == NULL || script == NULL)
+        {
+          fprintf (stderr,
+                   "Runtime Error: Allocation failure in RunCacheLoad.\n");
+          exit (1);
+        }
+      memset (&config, 0, sizeof (struct conf));
+      memset (sc->bf, 0, sizeof (struct slidingbuffer));
+      uint64_t hash = HashScript (script, &length);
+      fclose (script);
+      if (!LoadNetCache (BENCH_CACHE, hash, length, net, &config, sc->bf))
+        {
+          fprintf (stderr, "unable to read back %s\n", BENCH_CACHE);
+          exit (1);
+        }
+      free (sc->bf->warnings);
+      free (config.openingcomment);
+      FreeNnet (net);
+    }
+  return (count * sc->length);
+}
+
+static size_t
+RunWriter (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  struct conf config;
+  memset (&config, 0, sizeof (struct conf));
+  FILE *out = fopen ("/dev/null", "w");
+  if (out == NULL)
+    {
+      fprintf (stderr, "unable to open /dev/null\n");
+      exit (1);
+    }
+  for (size_t n = 0; n < count; n++)
+    nnetwriter (sc->net, &config, out);
+  fclose (out);
+  return (count * sc->written);
+}
+
+static size_t
+RunFwdprop (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  const struct nnet *net = sc->net;
+  sigtype *acts = (sigtype *) alloca (sizeof (sigtype) * net->nodecount);
+  flotype *outs = (flotype *) alloca (sizeof (flotype) * net->outputcount);
+  flotype *ins = (flotype *) alloca (sizeof (flotype) * net->inputcount);
+  init_activations (net, acts);
+  for (size_t n = 0; n < count; n++)
+    {
+      for (size_t in = 0; in < net->inputcount; in++)
+        ins[in] = sc->inputs[in * BENCH_BATCH + n % BENCH_BATCH];
+      fwdprop (net, ins, acts, NULL, outs);
+    }
+  return (count);
+}
+
+static size_t
+RunFwdpropBatch (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  const struct nnet *net = sc->net;
+  sigtype *acts = (sigtype *) malloc (sizeof (sigtype) * net->nodecount *
+                                      BENCH_BATCH);
+  flotype *outs = (flotype *) malloc (sizeof (flotype) * net->outputcount *
+                                      BENCH_BATCH);
+  flotype *history = (flotype *) malloc (sizeof (flotype) * net->nodecount *
+                                         BENCH_BATCH);
+  if (acts == NULL || outs == NULL || history == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in RunFwdpropBatch.\n");
+      exit (1);
+    }
+  size_t batches = (count + BENCH_BATCH - 1) / BENCH_BATCH;
+  for (size_t n = 0; n < batches; n++)
+    {
+      init_activations_batch (net, acts, BENCH_BATCH);
+      fwdprop_batch (net, BENCH_BATCH, sc->inputs, acts, history, outs);
+    }
+  free (acts);
+  free (outs);
+  free (history);
+  return (batches * BENCH_BATCH);
+}
+
+// train by gradient descent, as a TrainingPlan(GradientDescent) with a BatchSize of 1 would: windows of one step, or
+// of BENCH_WINDOW steps for recurrent networks.
+static size_t
+RunTraining (void *arg, size_t count)
+{
+  struct scripted *sc = (struct scripted *) arg;
+  struct nnet *net = sc->net;
+  const int recurrent = net->topology->recurrent != 0;
+  const size_t window = recurrent ? BENCH_WINDOW : 1;
+  struct bptt *bp = StartBptt (net, window, 1);
+  flotype *ins = (flotype *) alloca (sizeof (flotype) * net->inputcount);
+  flotype *target = (flotype *) alloca (sizeof (flotype) * net->outputcount);
+  for (size_t n = 0; n < count; n++)
+    {
+      for (size_t in = 0; in < net->inputcount; in++)
+        ins[in] = sc->inputs[in * BENCH_BATCH + n % BENCH_BATCH];
+      for (size_t out = 0; out < net->outputcount; out++)
+        target[out] = sc->targets[out * BENCH_BATCH + n % BENCH_BATCH];
+      BpttStep (bp, ins, target);
+      if (bp->steps == 0)
+        DescendGradient (bp, (flotype) 1e-4);
+    }
+  FinishBptt (bp);
+  return (count);
+}
+
+static void
+BenchScripted (int topology, unsigned int inputs, unsigned int width,
+               unsigned int outputs)
+{
+  static const char *names[3] = { "dense", "sparse", "recurrent" };
+  struct scripted sc;
+  char *written = NULL;
+  memset (&sc, 0, sizeof (struct scripted));
+  sc.bf = (struct slidingbuffer *) malloc (sizeof (struct slidingbuffer));
+  sc.inputs = (flotype *) malloc (sizeof (flotype) * inputs * BENCH_BATCH);
+  sc.targets = (flotype *) malloc (sizeof (flotype) * outputs * BENCH_BATCH);
+  if (sc.bf == NULL || sc.inputs == NULL || sc.targets == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in BenchScripted.\n");
+      exit (1);
+    }
+  for (size_t value = 0; value < inputs * BENCH_BATCH; value++)
+    sc.inputs[value] = Uniform (-1.0, 1.0);
+  for (size_t value = 0; value < outputs * BENCH_BATCH; value++)
+    sc.targets[value] = Uniform (-0.5, 0.5);
+  char *script = NnetScript (topology, inputs, width, outputs, &sc.length);
+  sc.script = script;
+  sc.net = ParseScript (script, sc.length, sc.bf);
+  FILE *out = open_memstream (&written, &sc.written);
+  struct conf config;
+  memset (&config, 0, sizeof (struct conf));
+  nnetwriter (sc.net, &config, out);
+  fclose (out);
+  free (written);
+  printf ("nnet %s %u-%u-%u-%u (%u nodes, %u synapses, %.2f MB script):\n",
+          names[topology], inputs, width, width, outputs, sc.net->nodecount,
+          sc.net->synapsecount, sc.length / 1e6);
+  const double synapses = sc.net->synapsecount;
+  Measure ("nnetparser", "MB/s", 1e6, RunParser, &sc, 1.0, "byte");
+  FILE *in = fmemopen (script, sc.length, "r");
+  uint64_t scriptlength = 0;
+  uint64_t scripthash = in != NULL ? HashScript (in, &scriptlength) : 0;
+  if (in != NULL)
+    fclose (in);
+  sc.bf->warnings = NULL;       // ParseScript freed them.
+  SaveNetCache (BENCH_CACHE, scripthash, scriptlength, sc.net, &config,
+                sc.bf);
+  if (access (BENCH_CACHE, R_OK) == 0)
+    Measure ("network cache (nnet -k)", "MB/s", 1e6, RunCacheLoad, &sc, 1.0,
+             "byte");
+  else
+    printf ("  network cache: unable to write %s here\n", BENCH_CACHE);
+  remove (BENCH_CACHE);
+  Measure ("nnetwriter", "MB/s", 1e6, RunWriter, &sc, 1.0, "byte");
+  Measure ("fwdprop()", "cases/s", 1.0, RunFwdprop, &sc, synapses,
+           "synapse");
+  Measure ("fwdprop_batch() of 256 cases", "cases/s", 1.0, RunFwdpropBatch,
+           &sc, synapses, "synapse");
+  Measure ("GradientDescent training", "cases/s", 1.0, RunTraining, &sc,
+           synapses, "synapse");
+  FreeNnet (sc.net);
+  free (script);
+  free (sc.bf);
+  free (sc.inputs);
+  free (sc.targets);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int layered[][MAX_NUM_LAYERS] = { {1, 4, 1}, {4, 8, 4},
+  {8, 16, 8}
+  };
+  static const unsigned int widths[] = { 16, 64, 256 };
+  int opt;
+  while ((opt = getopt (argc, argv, "q")) != -1)
+    switch (opt)
+      {
+      case 'q':                // a quick pass, to check that every benchmark runs.
+        reps = 3;
+        runtime = BENCH_RUNTIME / 10;
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-q]\n", argv[0]);
+        exit (1);
+      }
+  srandom (1);
+  printf ("nnetbench (" FLOTYPE_NAME
+          " precision): median rate of %d runs of at least %g s, +- half the spread of the middle runs\n",
+          reps, runtime);
+  counting = OpenCounters (&counters) > 0;
+  if (!counting)
+    printf ("no hardware counters (%s); timing only\n", strerror (errno));
+  for (size_t index = 0; index < sizeof (layered) / sizeof (layered[0]);
+       index++)
+    BenchLayered (layered[index], 3);
+  for (int topology = TOPOLOGY_DENSE; topology <= TOPOLOGY_RECURRENT;
+       topology++)
+    for (size_t index = 0; index < sizeof (widths) / sizeof (widths[0]);
+         index++)
+      BenchScripted (topology, widths[index] / 4, widths[index], 4);
+  CloseCounters (&counters);
+  return (0);
+}
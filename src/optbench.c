@@ -0,0 +1,403 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+// optbench: how fast each of the old engine's optimizers reaches the accuracy a problem asks for.  Every method runs
+// on every problem, once per seed and thread count, with the same budget of error() calls.  Each time a run finds a
+// lower error than it had seen, the error is recorded against the wall time and the error() calls spent so far.  A
+// table of medians goes to stdout and the records themselves to a CSV file.
+
+#include <unistd.h>
+#include <omp.h>
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "parser.h"
+#include "error.h"
+#include "feedforward.h"
+#include "randomize.h"
+#include "rnd.h"
+#include "profile.h"
+#include "benchmark.h"
+
+#define OPT_SEEDS     5
+#define OPT_BUDGET    20000     // error() calls each run may spend.
+#define OPT_ACCURACY  0.1       // root mean square error per output value the generated problems ask for.
+#define OPT_MAXTHREADS 16
+
+struct problem
+{
+  char name[64];
+  network *nn;
+  network_config *config;
+  double accuracy;
+};
+
+// what one run has seen of its errors, kept up to date by Observe.
+struct run
+{
+  const char *problem;
+  const char *method;
+  int threads;
+  unsigned int seed;
+  network_config *config;
+  double accuracy;
+  double began;
+  double best;                  // the lowest error seen.
+  int reached;                  // whether best has come within accuracy.
+  unsigned long reachedcalls;   // error() calls spent when it did.
+  double reachedseconds;
+  FILE *csv;
+};
+
+static void
+Observe (void *arg, double err)
+{
+  struct run *run = (struct run *) arg;
+  if (err >= run->best)
+    return;
+  double seconds = ProfileClock () - run->began;
+  run->best = err;
+  if (!run->reached && err <= run->accuracy)
+    {
+      run->reached = 1;
+      run->reachedcalls = run->config->error_calls;
+      run->reachedseconds = seconds;
+    }
+  if (run->csv != NULL)
+    fprintf (run->csv, "%s,%s,%d,%u,%lu,%.6f,%.9g\n", run->problem,
+             run->method, run->threads, run->seed, run->config->error_calls,
+             seconds, err);
+}
+
+static int
+CompareDoubles (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return ((x > y) - (x < y));
+}
+
+// median of the count values, which it sorts.
+static double
+Median (double *values, int count)
+{
+  qsort (values, count, sizeof (double), CompareDoubles);
+  if (count % 2 == 1)
+    return (values[count / 2]);
+  return ((values[count / 2 - 1] + values[count / 2]) / 2);
+}
+
+static void
+LoadProblem (struct problem *pr, const char *filename)
+{
+  const char *base = strrchr (filename, '/');
+  FILE *in = fopen (filename, "r");
+  if (in == NULL)
+    {
+      fprintf (stderr, "optbench: unable to open %s\n", filename);
+      exit (1);
+    }
+  snprintf (pr->name, sizeof (pr->name), "%s", base ? base + 1 : filename);
+  if (strrchr (pr->name, '.') != NULL)
+    *strrchr (pr->name, '.') = '\0';
+  pr->nn = network_alloc ();
+  pr->config = network_config_alloc_default ();
+  if (pr->nn == NULL || pr->config == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in LoadProblem.\n");
+      exit (1);
+    }
+  Quiet ();
+  parser (pr->nn, pr->config, in);
+  Loud ();
+  fclose (in);
+  pr->accuracy = pr->config->accuracy;
+}
+
+// a problem known to be solvable: a layered network learning the outputs of another of its shape with random weights.
+static void
+TeacherProblem (struct problem *pr, const int *sizes, int layers)
+{
+  char *script = LayeredScript (sizes, layers);
+  FILE *in = fmemopen (script, strlen (script), "r");
+  int used = snprintf (pr->name, sizeof (pr->name), "teacher ");
+  for (int layer = 0; layer < layers; layer++)
+    used += snprintf (&(pr->name[used]), sizeof (pr->name) - used,
+                      layer == 0 ? "%d" : "-%d", sizes[layer]);
+  pr->nn = network_alloc ();
+  pr->config = network_config_alloc_default ();
+  if (in == NULL || pr->nn == NULL || pr->config == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in TeacherProblem.\n");
+      exit (1);
+    }
+  Quiet ();
+  parser (pr->nn, pr->config, in);
+  Loud ();
+  fclose (in);
+  free (script);
+  network *nn = pr->nn;
+  network_config *config = pr->config;
+  layer *last = &(nn->layers[nn->num_of_layers - 1]);
+  randomize (nn, config);
+  for (int c = 0; c < config->num_cases; c++)
+    {
+      for (int i = 0; i < nn->layers[0].num_of_neurons; i++)
+        {
+          neuron *ne = &(nn->layers[0].neurons[i]);
+          ne->output = config->cases_x[c][ne->global_id][0];
+        }
+      feedforward (nn);
+      for (int j = 0; j < last->num_of_neurons; j++)
+        config->cases_y[c][last->neurons[j].global_id] =
+          last->neurons[j].output;
+    }
+  // error() is the root of the summed squares, not their mean.
+  pr->accuracy = OPT_ACCURACY * sqrt (config->num_cases *
+                                      last->num_of_neurons);
+}
+
+// run method on the problem with its weights randomized from seed, recording its progress in run.
+static void
+RunOnce (struct problem *pr, int method, size_t iterations, struct run *run)
+{
+  network_config *config = pr->config;
+  srnd (config, run->seed);
+  randomize (pr->nn, config);
+  SetOptimizer (config, method, iterations);
+  config->verbosity = OFF;
+  config->accuracy = run->accuracy;
+  config->error_calls = 0;
+  config->error_seen = Observe;
+  config->error_seen_arg = run;
+  run->best = HUGE_VAL;
+  run->reached = 0;
+  omp_set_num_threads (run->threads);
+  run->began = ProfileClock ();
+  Quiet ();
+  network_run_algorithm (pr->nn, config);
+  Loud ();
+  config->error_seen = NULL;
+}
+
+// error() calls one iteration of method costs on the problem, found by running two iterations.
+static double
+CallsPerIteration (struct problem *pr, int method)
+{
+  network_config *config = pr->config;
+  srnd (config, 0);
+  randomize (pr->nn, config);
+  size_t iterations = SetOptimizer (config, method, 2);
+  config->verbosity = OFF;
+  config->accuracy = 0.0;
+  config->error_calls = 0;
+  Quiet ();
+  network_run_algorithm (pr->nn, config);
+  Loud ();
+  return ((double) config->error_calls / iterations);
+}
+
+static void
+BenchProblem (struct problem *pr, unsigned long budget, int seeds,
+              const int *threadcounts, int threadcountcount, FILE * csv)
+{
+  static const struct
+  {
+    int method;
+    const char *name;
+    int parallel;               // runs error() on several threads at once.
+  } optimizers[] = {
+    {RANDOM_SEARCH, "random_search", 0},
+    {SIMULATED_ANNEALING, "simulated_annealing", 0},
+    {GRADIENT_DESCENT, "gradient_descent", 0},
+    {GENETIC_ALGORITHM, "genetic_algorithm", 0},
+    {MSMCO, "msmco", 1}
+  };
+  double *seconds = (double *) malloc (sizeof (double) * seeds);
+  double *calls = (double *) malloc (sizeof (double) * seeds);
+  double *finals = (double *) malloc (sizeof (double) * seeds);
+  double *runtimes = (double *) malloc (sizeof (double) * seeds);
+  if (seconds == NULL || calls == NULL || finals == NULL || runtimes == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in BenchProblem.\n");
+      exit (1);
+    }
+  for (size_t index = 0; index < sizeof (optimizers) / sizeof (optimizers[0]);
+       index++)
+    {
+      const int method = optimizers[index].method;
+      double per = CallsPerIteration (pr, method);
+      size_t iterations = MAX (1, (size_t) (budget / per));
+      for (int tc = 0; tc < threadcountcount; tc++)
+        {
+          // the other methods run on one thread whatever the thread count.
+          if (tc > 0 && !optimizers[index].parallel)
+            break;
+          struct run run;
+          int reached = 0;
+          memset (&run, 0, sizeof (struct run));
+          run.problem = pr->name;
+          run.method = optimizers[index].name;
+          run.threads = optimizers[index].parallel ? threadcounts[tc] : 1;
+          run.config = pr->config;
+          run.accuracy = pr->accuracy;
+          run.csv = csv;
+          for (int seed = 0; seed < seeds; seed++)
+            {
+              run.seed = seed + 1;
+              RunOnce (pr, method, iterations, &run);
+              runtimes[seed] = ProfileClock () - run.began;
+              if (csv != NULL)  // where the run ended, so every curve runs to its end.
+                fprintf (csv, "%s,%s,%d,%u,%lu,%.6f,%.9g\n", run.problem,
+                         run.method, run.threads, run.seed,
+                         pr->config->error_calls, runtimes[seed], run.best);
+              finals[seed] = error (pr->nn, pr->config);
+              if (run.reached)
+                {
+                  seconds[reached] = run.reachedseconds;
+                  calls[reached] = run.reachedcalls;
+                  reached++;
+                }
+            }
+          printf ("%-34s %-20s %7d %4d/%-4d", pr->name, run.method,
+                  run.threads, reached, seeds);
+          if (reached > 0)
+            printf (" %12.4g %12.0f", Median (seconds, reached),
+                    Median (calls, reached));
+          else
+            printf (" %12s %12s", "-", "-");
+          printf (" %12.4g %10.4g\n", Median (finals, seeds),
+                  Median (runtimes, seeds));
+          fflush (stdout);
+        }
+    }
+  free (seconds);
+  free (calls);
+  free (finals);
+  free (runtimes);
+}
+
+static void
+Usage (const char *progname)
+{
+  fprintf (stderr,
+           "usage: %s [-g] [-a accuracy] [-n calls] [-s seeds] [-t threads,...] [-c file.csv] [file.input ...]\n"
+           "  -g  also run on generated problems (the default with no files)\n"
+           "  -a  accuracy to reach on every problem, instead of each script's own\n"
+           "  -n  error() calls each run may spend (%d)\n"
+           "  -s  seeds to run each method with (%d)\n"
+           "  -t  thread counts to run msmco with (1 and the processor count)\n"
+           "  -c  write each improvement of each run to file.csv\n",
+           progname, OPT_BUDGET, OPT_SEEDS);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int generated[][MAX_NUM_LAYERS] = { {2, 4, 1}, {4, 8, 4},
+  {8, 16, 8}
+  };
+  unsigned long budget = OPT_BUDGET;
+  int seeds = OPT_SEEDS;
+  int threadcounts[OPT_MAXTHREADS];
+  int threadcountcount = 0;
+  int generate = 0;
+  double accuracy = 0.0;
+  FILE *csv = NULL;
+  int opt;
+  while ((opt = getopt (argc, argv, "ga:n:s:t:c:")) != -1)
+    switch (opt)
+      {
+      case 'g':
+        generate = 1;
+        break;
+      case 'a':
+        accuracy = atof (optarg);
+        break;
+      case 'n':
+        budget = strtoul (optarg, NULL, 10);
+        break;
+      case 's':
+        seeds = atoi (optarg);
+        break;
+      case 't':
+        for (char *count = strtok (optarg, ",");
+             count != NULL && threadcountcount < OPT_MAXTHREADS;
+             count = strtok (NULL, ","))
+          threadcounts[threadcountcount++] = MAX (1, atoi (count));
+        break;
+      case 'c':
+        csv = fopen (optarg, "w");
+        if (csv == NULL)
+          {
+            fprintf (stderr, "optbench: unable to write %s\n", optarg);
+            exit (1);
+          }
+        fprintf (csv, "problem,method,threads,seed,calls,seconds,error\n");
+        break;
+      default:
+        Usage (argv[0]);
+      }
+  if (budget == 0 || seeds <= 0 || accuracy < 0.0)
+    Usage (argv[0]);
+  if (threadcountcount == 0)
+    {
+      threadcounts[threadcountcount++] = 1;
+      if (omp_get_num_procs () > 1)
+        threadcounts[threadcountcount++] = omp_get_num_procs ();
+    }
+  if (optind == argc)
+    generate = 1;
+  srandom (1);
+  printf ("optbench: %d seeds, %lu error() calls per run\n", seeds, budget);
+  printf ("%-34s %-20s %7s %9s %12s %12s %12s %10s\n", "problem", "method",
+          "threads", "reached", "s to reach", "calls", "final error",
+          "s per run");
+  for (int arg = optind; arg < argc; arg++)
+    {
+      struct problem pr;
+      LoadProblem (&pr, argv[arg]);
+      if (accuracy > 0.0)
+        pr.accuracy = accuracy;
+      BenchProblem (&pr, budget, seeds, threadcounts, threadcountcount, csv);
+      network_free (pr.nn);
+      network_config_free (pr.config);
+    }
+  if (generate)
+    for (size_t index = 0; index < sizeof (generated) / sizeof (generated[0]);
+         index++)
+      {
+        struct problem pr;
+        TeacherProblem (&pr, generated[index], 3);
+        if (accuracy > 0.0)
+          pr.accuracy = accuracy;
+        BenchProblem (&pr, budget, seeds, threadcounts, threadcountcount,
+                      csv);
+        network_free (pr.nn);
+        network_config_free (pr.config);
+      }
+  if (csv != NULL)
+    fclose (csv);
+  return (0);
+}
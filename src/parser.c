@@ -25,6 +25,11 @@
 #include "includes.h"
 #include "parser.h"
 #include "network.h"
+#include "weightfile.h"
+#include "netbuilder.h"
+#include "profile.h"
+#include "quantize.h"
+#include "fail.h"
 
 enum main_token_id
 {
@@ -104,7 +109,7 @@ find_id (char *name, const char *type, const char **array, int last)
     if (strcmp (name, array[id]) == 0)
       return id;
   printf (" -> '%s' not supported as '%s' token\n", name, type);
-  exit (-1);
+  Fail (-1);
 }
 
 static int
@@ -115,18 +120,18 @@ get_positive_number (FILE * fp, const char *token_n)
 
   ret = fscanf (fp, "%lf", &tmp);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
 
   num = (int) (tmp);
   if (tmp != num)
     {
       printf ("%s must be an integer number! (%f)\n", token_n, tmp);
-      exit (-1);
+      Fail (-1);
     }
   if (num < 0)
     {
       printf ("%s must be a positive number! (%d)\n ", token_n, num);
-      exit (-1);
+      Fail (-1);
     }
   //printf(" -> %s = %d [OK]\n", token_n, num);
   return num;
@@ -139,7 +144,7 @@ get_strictly_positive_number (FILE * fp, const char *token_n)
   if (num == 0)
     {
       printf ("%s must be a strictly positive number! (%d)\n ", token_n, num);
-      exit (-1);
+      Fail (-1);
     }
   return num;
 }
@@ -158,7 +163,7 @@ get_switch_value (FILE * fp, const char *name)
   char s[128];
   ret = fscanf (fp, "%126s", s);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
   return find_id (s, name, switch_n, switch_n_size);
 }
 
@@ -168,7 +173,7 @@ get_double_number (FILE * fp)
   double tmp;
   int ret = fscanf (fp, "%lf", &tmp);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
   return tmp;
 }
 
@@ -179,7 +184,7 @@ get_double_positive_number (FILE * fp, const char *msg)
   if (tmp > 0)
     return tmp;
   printf ("%s must be greater than 0!", msg);
-  exit (-1);
+  Fail (-1);
 }
 
 /*
@@ -233,12 +238,12 @@ sub_neuron_parser (network * nn, network_config * config, FILE * fp)
   if (index > (nn->num_of_neurons - 1))
     {
       printf ("neuron id out of range!\n");
-      exit (-1);
+      Fail (-1);
     };
 
   ret = fscanf (fp, "%126s", s);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
   sub_token = find_id (s, "NEURON sub-token",
                        neuron_sub_token_n, neuron_sub_token_count);
 
@@ -279,12 +284,12 @@ sub_neuron_parser (network * nn, network_config * config, FILE * fp)
         if (connection_id > (nn->num_of_neurons - 1))
           {
             printf ("the connection index is out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         if (connection_id > (nn->neurons[index].num_input - 1))
           {
             printf ("the connection index is out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
 
         int global_neuron_id_2 =
@@ -292,7 +297,7 @@ sub_neuron_parser (network * nn, network_config * config, FILE * fp)
         if (global_neuron_id_2 > (nn->num_of_neurons - 1))
           {
             printf ("the global index of neuron #2 is out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         printf ("NEURON %d CONNECTION %d %d [OK]\n",
                 index, connection_id, global_neuron_id_2);
@@ -327,7 +332,7 @@ sub_network_parser (network * nn, network_config * config, FILE * fp)
    */
   ret = fscanf (fp, "%126s", s);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
   sub_token = find_id (s, "NETWORK sub-token",
                        network_sub_token_n, network_sub_token_count);
   switch (sub_token)
@@ -347,13 +352,13 @@ sub_network_parser (network * nn, network_config * config, FILE * fp)
         if (ind > (nn->num_of_layers - 1))
           {
             printf ("layer index is out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         ret = fscanf (fp, "%126s", s);
         if (strcmp (s, "NUMBER_OF_NEURONS") != 0)
           {
             printf ("syntax error!\nNUMBER_OF_NEURONS expected!\n");
-            exit (-1);
+            Fail (-1);
           }
         int num = get_positive_number (fp, "NUMBER_OF_NEURONS");
         if (num > nn->num_of_neurons)
@@ -361,7 +366,7 @@ sub_network_parser (network * nn, network_config * config, FILE * fp)
             printf
               ("the number of neurons in the layer is grater the the total number of neurons!\n");
             printf ("please check your configuration!\n");
-            exit (-1);
+            Fail (-1);
           }
         nn->layers[ind].num_of_neurons = num;
         printf ("NETWORK LAYER %d NUMBER_OF_NEURONS %d [OK]\n", ind, num);
@@ -375,21 +380,21 @@ sub_network_parser (network * nn, network_config * config, FILE * fp)
         if (layer_id > (nn->num_of_layers - 1))
           {
             printf ("layer index out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         int local_neuron_id =
           get_positive_number (fp, "ASSIGN_NEURON_TO_LAYER 2.");
         if (local_neuron_id > (nn->layers[layer_id].num_of_neurons - 1))
           {
             printf ("local neuron index out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         int global_neuron_id =
           get_positive_number (fp, "ASSIGN_NEURON_TO_LAYER 3.");
         if (global_neuron_id > (nn->num_of_neurons - 1))
           {
             printf ("global neuron index out of range!\n");
-            exit (-1);
+            Fail (-1);
           }
         printf ("NETWORK ASSIGN_NEURON_TO_LAYER %d %d %d [OK]\n",
                 layer_id, local_neuron_id, global_neuron_id);
@@ -400,7 +405,7 @@ sub_network_parser (network * nn, network_config * config, FILE * fp)
       break;
     default:
       printf ("the specified network feature is unknown!\n");
-      exit (-1);
+      Fail (-1);
       break;
     }
 
@@ -422,7 +427,7 @@ sub_training_method_parser (network * nn, network_config * config, FILE * fp)
   char s[128];
   ret = fscanf (fp, "%126s", s);
   if (ret < 0)
-    exit (-1);
+    Fail (-1);
 
   method_id =
     find_id (s, "TRAINING_METHOD", sub_method_token_n,
@@ -445,7 +450,7 @@ sub_training_method_parser (network * nn, network_config * config, FILE * fp)
         if (mmax < 2)
           {
             printf ("MMAX must be greater than 1!\n");
-            exit (-1);
+            Fail (-1);
           }
         int nmax = get_positive_number (fp, "simulated annealing nmax");
         double kbtmin = get_double_number (fp);
@@ -453,7 +458,7 @@ sub_training_method_parser (network * nn, network_config * config, FILE * fp)
         if (kbtmin >= kbtmax)
           {
             printf ("KBTMIN must be smaller then KBTMAX!\n");
-            exit (-1);
+            Fail (-1);
           }
         double eps = get_double_positive_number (fp, "ACCURACY");
         printf ("TRAINING METHOD = SIMULATED ANNEALING %d %d %g %g %g [OK]\n",
@@ -622,7 +627,7 @@ processing the input file\n\
                 printf ("NUMBER_OF_TRAINING_CASES is too large!\n");
                 printf
                   ("please increase MAX_TRAINING_CASES and recompile!\n");
-                exit (-1);
+                Fail (-1);
               }
             printf ("NUMBER_OF_TRAINING_CASES = %d [OK]\n", ncase);
             config->num_cases = ncase;
@@ -646,7 +651,7 @@ processing the input file\n\
                   if (ind > (config->num_cases - 1))
                     {
                       printf ("training data index out of range!\n");
-                      exit (-1);
+                      Fail (-1);
                     }
                   int neu =
                     get_positive_number (fp, "TRAINING_CASE neuron index");
@@ -655,7 +660,7 @@ processing the input file\n\
                     {
                       printf
                         ("TRAINING_CASE IN neuron index out of range!\n");
-                      exit (-1);
+                      Fail (-1);
                     }
 
                   int conn =
@@ -665,7 +670,7 @@ processing the input file\n\
                     {
                       printf
                         ("TRAINING_CASE connection index out of range!\n");
-                      exit (-1);
+                      Fail (-1);
                     }
                   tmp = get_double_number (fp);
                   printf ("TRAINING_CASE IN %d %d %d %f [OK]\n",
@@ -679,7 +684,7 @@ processing the input file\n\
                   if (ind > (config->num_cases - 1))
                     {
                       printf ("training data index out of range!\n");
-                      exit (-1);
+                      Fail (-1);
                     }
                   int neu =
                     get_positive_number (fp,
@@ -688,7 +693,7 @@ processing the input file\n\
                     {
                       printf
                         ("TRAINING_CASE OUT neuron index out of range!\n");
-                      exit (-1);
+                      Fail (-1);
                     }
                   tmp = get_double_number (fp);
                   printf ("TRAINING_CASE OUT %d %d %f [OK]\n", ind, neu, tmp);
@@ -739,7 +744,7 @@ processing the input file\n\
                 {
                   printf ("NUMBER_OF_INPUT_CASES is too large!\n");
                   printf ("please increase MAX_NUM_CASES and recompile!\n");
-                  exit (-1);
+                  Fail (-1);
                 }
               printf ("NUMBER OF INPUT CASES = %d [OK]\n", num);
               config->num_of_cases = num;
@@ -753,7 +758,7 @@ processing the input file\n\
               if (num > (config->num_of_cases - 1))
                 {
                   printf ("NETWORK_INPUT case index out of range!\n");
-                  exit (-1);
+                  Fail (-1);
                 }
 
               int neu =
@@ -761,14 +766,14 @@ processing the input file\n\
               if (neu > nn->layers[0].num_of_neurons - 1)
                 {
                   printf ("NETWORK_INPUT neuron index out of range!\n");
-                  exit (-1);
+                  Fail (-1);
                 }
               int conn =
                 get_positive_number (fp, "NETWORK_INPUT connection index");
               if (conn > (nn->neurons[neu].num_input - 1))
                 {
                   printf ("NETWORK_INPUT connection index out of range!\n");
-                  exit (-1);
+                  Fail (-1);
                 }
               double val = get_double_number (fp);
               printf ("NETWORK INPUT CASE #%d %d %d = %g [OK]\n",
@@ -846,12 +851,16 @@ ErrStopParsing (struct slidingbuffer *bf, const char *msg, void *free1)
   assert (msg != NULL);
   free (free1);
   fflush (stdout);
-  fclose (bf->input);
   if (bf == NULL)
-    fprintf (stderr, "\n %s\n", msg);
+    Complain ("\n %s\n", msg);
   else
-    fprintf (stderr, "\nLine %d Col %d : %s\n", bf->line, bf->col, msg);
-  exit (1);
+    {
+      if (bf->input != NULL)
+        fclose (bf->input);
+      bf->input = NULL;         // closed, so that a libgneural call failing here doesn't close it again.
+      Complain ("\nLine %d Col %d : %s\n", bf->line, bf->col, msg);
+    }
+  Fail (1);
 }
 
 // Add a warning to the slidingbuffer - don't output it yet.
@@ -859,11 +868,20 @@ void
 AddWarning (struct slidingbuffer *bf, const char *msg)
 {
   assert (msg != NULL);
-  int warnlen = bf->warnings == NULL ? 0 : strlen (bf->warnings);
-  int size = warnlen + strlen (msg) + 50;
-  bf->warnings = (char *) realloc (bf->warnings, size);
-  char *cursor = &(bf->warnings[warnlen]);
-  snprintf (cursor, size, "Line %3d Col %3d : %s\n", bf->line, bf->col, msg);
+  size_t size = strlen (msg) + 50;
+  if (bf->warnlen + size > bf->warncap)
+    {                           // grow geometrically; large networks can draw a warning per node.
+      bf->warncap = MAX (2 * bf->warncap, bf->warnlen + size);
+      bf->warnings = (char *) realloc (bf->warnings, bf->warncap);
+      if (bf->warnings == NULL)
+        {
+          Complain ("Runtime Error: Allocation failure in AddWarning.\n");
+          Fail (1);
+        }
+    }
+  bf->warnlen += snprintf (&(bf->warnings[bf->warnlen]), size,
+                           "Line %3d Col %3d : %s\n", bf->line, bf->col,
+                           msg);
 }
 
 // Print all warning messages so far saved in the slidingbuffer. Called from nnet.c
@@ -871,17 +889,29 @@ void
 PrintWarnings (struct slidingbuffer *bf)
 {
   if (bf->warnings != NULL)
-    fprintf (stderr, "\n%s", bf->warnings);
+    Complain ("\n%s", bf->warnings);
 }
 
 // Ensure that there are at least min characters available in buffer.  Return 0 on fail, #chars available on success.
+// The input is read a block at a time: the unread tail is slid to the front of the buffer and the rest refilled by one
+// fread.
 int
 ChAvailable (struct slidingbuffer *bf, int min)
 {
   assert (bf != NULL);
-  if (bf->head - bf->end < min)
-    while (!feof (bf->input) && (bf->head - bf->end < BFLEN))
-      bf->buffer[(bf->head++) % BFLEN] = fgetc (bf->input);
+  assert (min <= BFLEN);
+  if (bf->head - bf->end < min && !bf->atend)
+    {
+      int unread = bf->head - bf->end;
+      memmove (bf->buffer, &(bf->buffer[bf->end]), unread);
+      bf->end = 0;
+      bf->head = unread;
+      size_t want = BFLEN - unread;
+      size_t got = fread (&(bf->buffer[bf->head]), 1, want, bf->input);
+      bf->head += got;
+      if (got < want)
+        bf->atend = 1;
+    }
   if (bf->head - bf->end < min)
     return (0);
   return (bf->head - bf->end);
@@ -893,45 +923,45 @@ NextCh (struct slidingbuffer *bf)
 {
   assert (bf != NULL);
   if (ChAvailable (bf, 1))
-    return (bf->buffer[bf->end % BFLEN]);
+    return (bf->buffer[bf->end]);
   else
     return (0);
 }
 
-// accept the specified number of characters updating the line & column counts.  Return #characters accepted.  Error messages give line numbers, so for verbose
-// debugging this routine outputs accepted lines prefixed with line numbers.
+// accept the specified number of characters updating the line & column counts.  Return #characters accepted.  Error
+// messages give line numbers, so when debugging (nnet -d) this routine also echoes accepted lines prefixed with line
+// numbers, unless the script says Silence(Echo).
 int
 AcceptCh (struct slidingbuffer *bf, struct conf *config, int len)
 {
   assert (bf != NULL);
   assert (config != NULL);
   assert (len > 0);
-  char next;
-  static int AnnouncedLineZero = 0;
-  if (!AnnouncedLineZero++)
-    printf ("    0: ");
-  if (ChAvailable (bf, len))
+  int echo = (config->flags & (DEBUG_ECHO | SILENCE_ECHO)) == DEBUG_ECHO;
+  if (!ChAvailable (bf, len))
+    return (0);
+  const char *span = &(bf->buffer[bf->end]);
+  if (echo && !bf->announced)
     {
-      for (int cn = 0; cn < len; cn++)
-        {
-          next = NextCh (bf);
-          if ('\n' == next)
-            {
-              if ((config->flags & SILENCE_ECHO) == 0)
-                printf ("\n %4d: ", ++(bf->line));
-              bf->col = 0;
-            }
-          else
-            {
-              if ((config->flags & SILENCE_ECHO) == 0)
-                printf ("%c", next);
-              bf->col++;
-            }
-          bf->end++;
-        }
-      return (len);
+      bf->announced = 1;
+      printf ("    0: ");
     }
-  return (0);
+  for (int cn = 0; cn < len; cn++)
+    if ('\n' == span[cn])
+      {
+        ++(bf->line);
+        bf->col = 0;
+        if (echo)
+          printf ("\n %4d: ", bf->line);
+      }
+    else
+      {
+        bf->col++;
+        if (echo)
+          putchar (span[cn]);
+      }
+  bf->end += len;
+  return (len);
 }
 
 // return tokenlength iff a given token is ready to read from bf, 0 otherwise.
@@ -943,9 +973,8 @@ TokenAvailable (struct slidingbuffer *bf, const char *token)
   int goal = strlen (token);
   if (!ChAvailable (bf, goal))
     return (0);
-  for (int ct = 0; ct < goal; ct++)
-    if (bf->buffer[(bf->end + ct) % BFLEN] != token[ct])
-      return (0);
+  if (memcmp (&(bf->buffer[bf->end]), token, goal) != 0)
+    return (0);
   return (goal);
 }
 
@@ -975,7 +1004,7 @@ SkipComment (struct slidingbuffer *bf, struct conf *config)
   assert (bf != NULL);
   assert (config != NULL);
   if (TokenAvailable (bf, "#"))
-    while (NextCh (bf) != '\n')
+    while (ChAvailable (bf, 1) && NextCh (bf) != '\n')
       AcceptCh (bf, config, 1);
 }
 
@@ -1033,7 +1062,68 @@ ReadInteger (struct slidingbuffer *bf, struct conf *config)
   return ((1 - (2 * negate)) * atoi (buf));
 }
 
-// Read and return the number.  Controlled fail with helpful message if none available or wrong syntax.  You must call 'NumberAvailable' first.
+// Exact powers of ten representable in a double, for the fast path of ScanDecimal.
+static const double exactpow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Convert the validated decimal text span[0..len) to the nearest double.  When the significant digits fit in 53 bits
+// and the power of ten is exact (Clinger's fast path) one multiply or divide gives the correctly rounded result, the
+// same one strtod gives; anything else goes to strtod.
+static double
+ScanDecimal (const char *span, int len)
+{
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exp10 = 0;
+  int negative = 0;
+  int fraction = 0;
+  int pos = 0;
+  char buf[len + 1];
+  if (span[pos] == '-' || span[pos] == '+')
+    negative = (span[pos++] == '-');
+  for (; pos < len && span[pos] != 'e' && span[pos] != 'E'; pos++)
+    {
+      if (span[pos] == '.')
+        {
+          fraction = 1;
+          continue;
+        }
+      if (digits != 0 || span[pos] != '0')
+        {
+          if (++digits > 19)
+            break;
+          mantissa = mantissa * 10 + (span[pos] - '0');
+        }
+      exp10 -= fraction;
+    }
+  if (digits <= 19 && pos < len)
+    {
+      int expneg = 0;
+      int expval = 0;
+      pos++;
+      if (span[pos] == '-' || span[pos] == '+')
+        expneg = (span[pos++] == '-');
+      for (; pos < len && expval < 10000; pos++)
+        expval = expval * 10 + (span[pos] - '0');
+      exp10 += expneg ? -expval : expval;
+    }
+  if (digits <= 19 && mantissa <= (UINT64_C (1) << 53)
+      && exp10 >= -22 && exp10 <= 22)
+    {
+      double value = (double) mantissa;
+      value = exp10 < 0 ? value / exactpow10[-exp10] : value * exactpow10[exp10];
+      return (negative ? -value : value);
+    }
+  memcpy (buf, span, len);
+  buf[len] = 0;
+  return (strtod (buf, NULL));
+}
+
+// Read and return the number.  Controlled fail with helpful message if none available or wrong syntax.  You must call
+// 'NumberAvailable' first.  The number is validated and converted where it lies in the input buffer, then accepted in
+// one step.
 flotype
 ReadFloatingPoint (struct slidingbuffer * bf, struct conf * config)
 {
@@ -1041,79 +1131,58 @@ ReadFloatingPoint (struct slidingbuffer * bf, struct conf * config)
   assert (config != 0);
   assert (NumberAvailable (bf));
   static const int maxlen = 1085;       // max decimal length for (negative, denormalized, 64-bit) double is 1079!!  That's CRAZY!
-  char buf[maxlen];
-  int count = 0;
+  int pos = 0;
   int before = 0;
   int after = 0;
+  int non0digits = 0;
+  const char *span;
+  int avail;
   if (!TokenAvailable (bf, "+") && !TokenAvailable (bf, "-")
       && !isdigit (NextCh (bf)))
     return (0);
-  if (ChAvailable (bf, 1) && (NextCh (bf) == '-' || NextCh (bf) == '+'))
-    {
-      buf[count++] = NextCh (bf);
-      AcceptCh (bf, config, 1);
-    }
-  if (!ChAvailable (bf, 1) || !isdigit (NextCh (bf)))
-    ErrStopParsing (bf, "Expected Floating Point Value.", NULL);
-  while (ChAvailable (bf, 1) && isdigit (NextCh (bf)) && count < maxlen - 1)
+  ChAvailable (bf, maxlen);     // may come up short at end of input; that's fine.
+  avail = bf->head - bf->end;
+  span = &(bf->buffer[bf->end]);
+#define FAIL_AT(msg) do { if (pos > 0) AcceptCh (bf, config, pos); ErrStopParsing (bf, msg, NULL); } while (0)
+  if (span[pos] == '-' || span[pos] == '+')
+    pos++;
+  if (pos >= avail || !isdigit (span[pos]))
+    FAIL_AT ("Expected Floating Point Value.");
+  for (; pos < avail && isdigit (span[pos]) && pos < maxlen - 1; pos++)
     {
       before = 1;
-      buf[count++] = NextCh (bf);
-      AcceptCh (bf, config, 1);
-    }
-  if (!ChAvailable (bf, 1) || NextCh (bf) != '.')
-    ErrStopParsing (bf, "Floating-point values must have a decimal point.",
-                    NULL);
-  else
-    {
-      buf[count++] = NextCh (bf);
-      AcceptCh (bf, config, 1);
+      non0digits += (span[pos] != '0');
     }
-  while (ChAvailable (bf, 1) && isdigit (NextCh (bf)) && count < maxlen - 1)
+  if (pos >= avail || span[pos] != '.')
+    FAIL_AT ("Floating-point values must have a decimal point.");
+  pos++;
+  for (; pos < avail && isdigit (span[pos]) && pos < maxlen - 1; pos++)
     {
       after = 1;
-      buf[count++] = NextCh (bf);
-      AcceptCh (bf, config, 1);
+      non0digits += (span[pos] != '0');
     }
   if (before == 0 || after == 0)
-    ErrStopParsing (bf,
-                    "Floating-point values must have digits before and after decimal.",
-                    NULL);
-  if (ChAvailable (bf, 2) && count < (maxlen - 2)
-      && (AcceptToken (bf, config, "e") || AcceptToken (bf, config, "E")))
+    FAIL_AT ("Floating-point values must have digits before and after decimal.");
+  if (pos + 1 < avail && pos < maxlen - 2
+      && (span[pos] == 'e' || span[pos] == 'E'))
     {
-      buf[count++] = 'e';
-      if (count < maxlen - 2 && (NextCh (bf) == '+' || NextCh (bf) == '-'))
-        {
-          buf[count++] = NextCh (bf);
-          AcceptCh (bf, config, 1);
-        }
-      if (!isdigit (NextCh (bf)))
-        ErrStopParsing (bf,
-                        "Scientific notation floats must have digits in exponent.",
-                        NULL);
-      else
-        while (count < maxlen - 2 && ChAvailable (bf, 1)
-               && isdigit (NextCh (bf)))
-          {
-            buf[count++] = NextCh (bf);
-            AcceptCh (bf, config, 1);
-          }
+      pos++;
+      if (pos < maxlen - 2 && (span[pos] == '+' || span[pos] == '-'))
+        pos++;
+      if (pos >= avail || !isdigit (span[pos]))
+        FAIL_AT ("Scientific notation floats must have digits in exponent.");
+      for (; pos < maxlen - 2 && pos < avail && isdigit (span[pos]); pos++);
     }
-  if (count >= maxlen - 2)
-    ErrStopParsing (bf, "Floating-point value is too long.", NULL);
-  buf[count] = 0;
-  int non0digits = 0;
-  for (; --count >= 0;)
-    non0digits +=
-      buf[count] == 'e' ? -non0digits : (int) (isdigit (buf[count])
-                                               && buf[count] != '0');
-  double retval = atof (buf);
-  if (retval == 0.0 && non0digits != 0)
+  if (pos >= maxlen - 2)
+    FAIL_AT ("Floating-point value is too long.");
+#undef FAIL_AT
+  double retval = ScanDecimal (span, pos);
+  AcceptCh (bf, config, pos);
+  if ((flotype) retval == ZERO && non0digits != 0)     // checked after narrowing, so float builds catch float underflow.
     ErrStopParsing (bf,
                     "Nonzero float in source was rounded to zero on read.",
                     NULL);
-  if (retval == HUGE_VAL)
+  if (isinf ((flotype) retval))  // also after narrowing, so float builds take decimals that round to FLT_MAX.
     ErrStopParsing (bf, "Float value in source exceeds float range.", NULL);
   return ((flotype) retval);
 }
@@ -1212,9 +1281,9 @@ ReadQuotedString (struct slidingbuffer *bf, struct conf *config,
           retval = (char *) realloc (retval, allocsize * sizeof (char));        //increase allocation.
           if (retval == NULL)
             {
-              fprintf (stderr,
-                       "Runtime Error: Allocation Failure(1) in ReadQuotedString\n");
-              exit (1);
+              Complain
+                ("Runtime Error: Allocation Failure(1) in ReadQuotedString\n");
+              Fail (1);
             }
         }
       if (AcceptToken (bf, config, "\""))
@@ -1223,9 +1292,9 @@ ReadQuotedString (struct slidingbuffer *bf, struct conf *config,
           *retstring = realloc (retval, index * sizeof (char)); //reduce allocation to size actually used.
           if (retval == NULL)
             {
-              fprintf (stderr,
-                       "Runtime Error: Allocation Failure(2) in ReadQuotedString\n");
-              exit (1);
+              Complain
+                ("Runtime Error: Allocation Failure(2) in ReadQuotedString\n");
+              Fail (1);
             }
           return (1);
         }
@@ -1254,18 +1323,19 @@ ReadQuotedString (struct slidingbuffer *bf, struct conf *config,
           AcceptCh (bf, config, 1);
         }
     }
-  fprintf (stderr, "Program Error: Unhandled case in ReadQuotedString.\n");
-  exit (1);
+  Complain ("Program Error: Unhandled case in ReadQuotedString.\n");
+  Fail (1);
 }
 
 #define WARNSIZE 256
 
 int
 ReadCreateNodeStmt (struct slidingbuffer *bf, struct conf *config,
-                    struct nnet *net)
+                    struct netbuilder *nb)
 {
   assert (bf != NULL);
-  assert (net != NULL);
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
   int in_hid_out = 0;
   int NumToCreate = 0;
   int Accum = 0;
@@ -1310,9 +1380,9 @@ ReadCreateNodeStmt (struct slidingbuffer *bf, struct conf *config,
       snprintf (&(warnstring[printed]), WARNSIZE - printed, ".");
       if (ct != ACCUMCOUNT)
         {
-          fprintf (stderr,
-                   "Program Error: warnstring too small to hold list of input functions in ReadCreateNodeStmt.\n");
-          exit (1);
+          Complain
+            ("Program Error: warnstring too small to hold list of input functions in ReadCreateNodeStmt.\n");
+          Fail (1);
         }
       ErrStopParsing (bf, warnstring, NULL);
     }
@@ -1338,9 +1408,9 @@ ReadCreateNodeStmt (struct slidingbuffer *bf, struct conf *config,
       snprintf (&(warnstring[printed]), WARNSIZE - printed, ".");
       if (ct != OUTPUTCOUNT)
         {
-          fprintf (stderr,
-                   "Program Error: warnstring too small to hold list of activation functions in ReadCreateNodeStmt.\n");
-          exit (1);
+          Complain
+            ("Program Error: warnstring too small to hold list of activation functions in ReadCreateNodeStmt.\n");
+          Fail (1);
         }
       ErrStopParsing (bf, warnstring, NULL);
     }
@@ -1358,20 +1428,20 @@ ReadCreateNodeStmt (struct slidingbuffer *bf, struct conf *config,
   switch (in_hid_out)
     {
     case 1:
-      AddInputNodes (net, NumToCreate, Transfer, Accum, unitwidth);
-      if ((config->flags & SILENCE_RENUMBER) != 0
-          && net->nodecount > net->inputcount)
+      BuildNodes (nb, GROUP_INPUT, NumToCreate, Transfer, Accum, unitwidth);
+      if ((config->flags & SILENCE_RENUMBER) == 0
+          && net->nodecount > net->inputcount + 1)
         {
           snprintf (warnstring, WARNSIZE,
                     "Warning: New Input nodes are numbered %d to %d.  Existing hidden and output nodes have been renumbered %d to %d.",
-                    net->inputcount - NumToCreate, net->inputcount - 1,
-                    net->inputcount, net->nodecount - 1);
+                    net->inputcount - NumToCreate + 1, net->inputcount,
+                    net->inputcount + 1, net->nodecount - 1);
           AddWarning (bf, warnstring);
         }
       break;
     case 2:
-      AddHiddenNodes (net, NumToCreate, Transfer, Accum, unitwidth);
-      if ((config->flags & SILENCE_RENUMBER) != 0 && net->outputcount > 0)
+      BuildNodes (nb, GROUP_HIDDEN, NumToCreate, Transfer, Accum, unitwidth);
+      if ((config->flags & SILENCE_RENUMBER) == 0 && net->outputcount > 0)
         {
           snprintf (warnstring, WARNSIZE,
                     "Warning: New Hidden nodes are numbered %d to %d.  Existing output nodes have been renumbered %d to %d.",
@@ -1382,22 +1452,90 @@ ReadCreateNodeStmt (struct slidingbuffer *bf, struct conf *config,
         }
       break;
     case 3:
-      AddOutputNodes (net, NumToCreate, Transfer, Accum, unitwidth);
+      BuildNodes (nb, GROUP_OUTPUT, NumToCreate, Transfer, Accum, unitwidth);
       break;
     default:
-      fprintf (stderr,
-               "Program Error: Unhandled case in ReadCreateNodeStmt.\n");
-      exit (1);
+      Complain ("Program Error: Unhandled case in ReadCreateNodeStmt.\n");
+      Fail (1);
+    }
+  return (1);
+}
+
+// reads a reference to weights in a weight file: FromWeightFile ["filename"] [position], the Connect statement's
+// weights being count consecutive weights of the file starting at position.  Without a filename, the file named by the
+// section's last WeightFile statement is read; without a position, reading continues where the last reference to the
+// same file left off.
+static void
+ReadWeightFileRef (struct slidingbuffer *bf, struct conf *config,
+                   struct weightfile **mapped, struct weightfile *current,
+                   flotype * target, size_t count)
+{
+  char *fname = NULL;
+  char error[512];
+  struct weightfile *wf = current;
+  size_t first;
+  SkipToNext (bf, config);
+  if (ReadQuotedString (bf, config, &fname))
+    {
+      wf = OpenWeightFile (mapped, fname, error, sizeof (error));
+      free (fname);
+      if (wf == NULL)
+        ErrStopParsing (bf, error, target);
+      SkipToNext (bf, config);
     }
+  else if (wf == NULL)
+    ErrStopParsing (bf,
+                    "FromWeightFile needs a file name in \"quotes\" when no WeightFile statement precedes it.",
+                    target);
+  first = wf->next;
+  if (NumberAvailable (bf))
+    {
+      int position = ReadInteger (bf, config);
+      if (position < 0)
+        ErrStopParsing (bf, "Weight file positions cannot be negative.",
+                        target);
+      first = position;
+    }
+  if (!CopyWeights (wf, first, count, target))
+    ErrStopParsing (bf,
+                    "Weight file does not hold that many weights at that position.",
+                    target);
+}
+
+// WeightFile("filename") names the weight file that FromWeightFile reads in the rest of the StartConnections section.
+static int
+ReadWeightFileStmt (struct slidingbuffer *bf, struct conf *config,
+                    struct weightfile **mapped, struct weightfile **current)
+{
+  char *fname = NULL;
+  char error[512];
+  SkipToNext (bf, config);
+  if (!AcceptToken (bf, config, "WeightFile"))
+    return (0);
+  SkipToNext (bf, config);
+  if (!AcceptToken (bf, config, "("))
+    ErrStopParsing (bf, "Expected Open Parenthesis", NULL);
+  SkipToNext (bf, config);
+  if (!ReadQuotedString (bf, config, &fname))
+    ErrStopParsing (bf, "Expected weight file name in \"quotes\".", NULL);
+  SkipToNext (bf, config);
+  if (!AcceptToken (bf, config, ")"))
+    ErrStopParsing (bf, "Expected Close Parenthesis", fname);
+  *current = OpenWeightFile (mapped, fname, error, sizeof (error));
+  free (fname);
+  if (*current == NULL)
+    ErrStopParsing (bf, error, NULL);
   return (1);
 }
 
 int
 ReadConnectStmt (struct slidingbuffer *bf, struct conf *config,
-                 struct nnet *net)
+                 struct netbuilder *nb, struct weightfile **mapped,
+                 struct weightfile *current)
 {
   assert (bf != NULL);
-  assert (net != NULL);
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
   int firstlow;
   int secondlow;
   int firsthigh;
@@ -1437,15 +1575,28 @@ ReadConnectStmt (struct slidingbuffer *bf, struct conf *config,
       weightlist = (flotype *) malloc (sizeof (flotype) * weightcount);
       if (weightlist == NULL)
         {
-          fprintf (stderr,
-                   "Runtime Error: Allocation Failure in ReadConnectStmt\n");
-          exit (1);
+          Complain ("Runtime Error: Allocation Failure in ReadConnectStmt\n");
+          Fail (1);
         }
       imm_rnd_matrix = 2;
       ReadWeightMatrix (bf, config, weightlist, weightcount);
     }
+  else if (AcceptToken (bf, config, "FromWeightFile"))
+    {
+      weightcount = (1 + firsthigh - firstlow) * (1 + secondhigh - secondlow);
+      weightlist = (flotype *) malloc (sizeof (flotype) * weightcount);
+      if (weightlist == NULL)
+        {
+          Complain ("Runtime Error: Allocation Failure in ReadConnectStmt\n");
+          Fail (1);
+        }
+      imm_rnd_matrix = 2;
+      ReadWeightFileRef (bf, config, mapped, current, weightlist,
+                         weightcount);
+    }
   else
-    ErrStopParsing (bf, "Expected floating point value, 'Randomize', or '['",
+    ErrStopParsing (bf,
+                    "Expected floating point value, 'Randomize', '[', or 'FromWeightFile'",
                     NULL);
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
@@ -1463,22 +1614,21 @@ ReadConnectStmt (struct slidingbuffer *bf, struct conf *config,
   switch (imm_rnd_matrix)
     {
     case 0:
-      AddConnections (net, firstlow, firsthigh, secondlow, secondhigh,
-                      &weight);
+      BuildConnections (nb, firstlow, firsthigh, secondlow, secondhigh,
+                        &weight, 1);
       break;
     case 1:
-      AddRandomizedConnections (net, firstlow, firsthigh, secondlow,
-                                secondhigh);
+      BuildConnections (nb, firstlow, firsthigh, secondlow, secondhigh, NULL,
+                        0);
       break;
     case 2:
-      AddConnections (net, firstlow, firsthigh, secondlow, secondhigh,
-                      weightlist);
+      BuildConnections (nb, firstlow, firsthigh, secondlow, secondhigh,
+                        weightlist, weightcount);
       break;
     default:
       {
-        fprintf (stderr,
-                 "Program Error: unhandled case in ReadConnectStmt.\n");
-        exit (1);
+        Complain ("Program Error: unhandled case in ReadConnectStmt.\n");
+        Fail (1);
       }
     }
   free (weightlist);
@@ -1508,13 +1658,13 @@ ReadOpeningComment (struct slidingbuffer *bf, struct conf *config)
   config->openingcomment = (char *) malloc (allocsize * sizeof (char));
   if (config->openingcomment == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure(1) in ReadOpeningComment.\n");
-      exit (1);
+      Complain
+        ("Runtime Error: Allocation failure(1) in ReadOpeningComment.\n");
+      Fail (1);
     }
   while (TokenAvailable (bf, "#"))
     {
-      while ('\n' != (ch2Add = NextCh (bf)))
+      while (ChAvailable (bf, 1) && '\n' != (ch2Add = NextCh (bf)))
         {
           AcceptCh (bf, config, 1);
           if (allocsize <= index + 2)
@@ -1524,9 +1674,9 @@ ReadOpeningComment (struct slidingbuffer *bf, struct conf *config)
                 realloc (config->openingcomment, allocsize);
               if (config->openingcomment == NULL)
                 {
-                  fprintf (stderr,
-                           "Runtime Error: Allocation failure(2) in ReadOpeningComment.\n");
-                  exit (1);
+                  Complain
+                    ("Runtime Error: Allocation failure(2) in ReadOpeningComment.\n");
+                  Fail (1);
                 }
             }
           config->openingcomment[index++] = ch2Add;
@@ -1607,6 +1757,8 @@ ReadSaveStatement (struct slidingbuffer *bf, struct conf *config)
         return (1);
       else if (AcceptToken (bf, config, "Serialize"))
         config->flags |= SAVE_SERIALIZE;
+      else if (AcceptToken (bf, config, "WeightFile"))
+        config->flags |= SAVE_WEIGHTFILE;
       else if (ReadQuotedString (bf, config, &fname))
         {
           free (config->savename);
@@ -1616,7 +1768,7 @@ ReadSaveStatement (struct slidingbuffer *bf, struct conf *config)
         config->savecount = ReadInteger (bf, config);
       else
         ErrStopParsing (bf,
-                        "Expected close parenthesis, the keyword 'Serialize', a count of saves to make, or savefile name(in \"quotes\").",
+                        "Expected close parenthesis, the keyword 'Serialize' or 'WeightFile', a count of saves to make, or savefile name(in \"quotes\").",
                         fname);
     }
 }
@@ -1696,9 +1848,9 @@ ReadImmediateCase (struct slidingbuffer *bf, struct conf *config,
     }
   if (dat->data == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure (1) in ReadImmediateCase.\n");
-      exit (1);
+      Complain
+        ("Runtime Error: Allocation failure (1) in ReadImmediateCase.\n");
+      Fail (1);
     }
   else if (casenumber == dat->entrycount)
     {
@@ -1709,21 +1861,36 @@ ReadImmediateCase (struct slidingbuffer *bf, struct conf *config,
     }
   if (dat->data == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure (2) in ReadImmediateCase.\n");
-      exit (1);
+      Complain
+        ("Runtime Error: Allocation failure (2) in ReadImmediateCase.\n");
+      Fail (1);
     }
-  if (dat->inputcount == 0 || dat->outputcount == 0)
+  return (ReadCaseValues
+          (bf, config, dat->inputcount, dat->outputcount,
+           &(dat->data[startingpoint])));
+}
+
+// Read one case, in the same grammar as ReadImmediateCase, into target (which has room for inputcount + outputcount values).
+// Returns 0 without consuming anything if no case starts at the head of input.  Shared with the streaming reader in casestream.c.
+int
+ReadCaseValues (struct slidingbuffer *bf, struct conf *config,
+                size_t inputcount, size_t outputcount, flotype * target)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (target != NULL);
+  SkipToNext (bf, config);
+  if (!TokenAvailable (bf, "["))
+    return (0);
+  if (inputcount == 0 || outputcount == 0)
     {
-      ReadIOVals (bf, config, &(dat->data[startingpoint]), casesize);
+      ReadIOVals (bf, config, target, inputcount + outputcount);
       return (1);
     }
   AcceptToken (bf, config, "[");
-  if (!ReadIOVals (bf, config, &(dat->data[startingpoint]), dat->inputcount))
+  if (!ReadIOVals (bf, config, target, inputcount))
     ErrStopParsing (bf, "Input Sequence must begin with '['.", NULL);
-  if (!ReadIOVals
-      (bf, config, &(dat->data[startingpoint + dat->inputcount]),
-       dat->outputcount))
+  if (!ReadIOVals (bf, config, &(target[inputcount]), outputcount))
     ErrStopParsing (bf, "Output Sequence must begin with '['.", NULL);
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, "]"))
@@ -1812,7 +1979,8 @@ ReadDataStatement (struct slidingbuffer *bf, struct conf *config,
          || TokenAvailable (bf, "ReadNoInput")
          || TokenAvailable (bf, "ReadNoOutput")
          || TokenAvailable (bf, "WriteNoInput")
-         || TokenAvailable (bf, "WriteNoOutput"))
+         || TokenAvailable (bf, "WriteNoOutput")
+         || TokenAvailable (bf, "Sequence"))
     {
       if (AcceptToken (bf, config, "NoInput")
           || AcceptToken (bf, config, "ReadNoInput"))
@@ -1830,8 +1998,18 @@ ReadDataStatement (struct slidingbuffer *bf, struct conf *config,
         newdata->flags |= DATA_NOWRITEINPUT;
       else if (AcceptToken (bf, config, "WriteNoOutput"))
         newdata->flags |= DATA_NOWRITEOUTPUT;
+      else if (AcceptToken (bf, config, "Sequence"))
+        newdata->flags |= DATA_SEQUENCE;
       SkipToNext (bf, config);
     }
+  if ((newdata->flags & DATA_SEQUENCE) != 0x0)
+    {
+      if ((newdata->flags & DATA_FROMPIPE) != 0x0)
+        ErrStopParsing (bf,
+                        "Sequence data can't be read FromPipe; each request to a deployment server is answered on its own.",
+                        newdata);
+      newdata->inputcount++;    // the sequence marker is read as the first input value.
+    }
   if ((newdata->flags & DATA_NOINPUT) != 0x0
       && (newdata->flags & DATA_NOOUTPUT) != 0x0)
     ErrStopParsing (bf,
@@ -1878,16 +2056,18 @@ ReadDataStatement (struct slidingbuffer *bf, struct conf *config,
     while (ReadImmediateCase (bf, config, newdata, casecount))
       casecount++;
   newdata->entrycount = casecount;
-  newdata->data =
-    (flotype *) realloc (newdata->data,
-                         casecount * sizeof (flotype) * (newdata->inputcount +
-                                                         newdata->
-                                                         outputcount));
-  if (newdata->data == NULL)
+  if (casecount != 0)           // sources other than Immediate are read when a plan uses them (see casestream.c).
     {
-      fprintf (stderr,
-               "Runtime Error: Reallocation failure in ReadDataStatement.\n");
-      exit (1);
+      newdata->data =
+        (flotype *) realloc (newdata->data,
+                             casecount * sizeof (flotype) *
+                             (newdata->inputcount + newdata->outputcount));
+      if (newdata->data == NULL)
+        {
+          Complain
+            ("Runtime Error: Reallocation failure in ReadDataStatement.\n");
+          Fail (1);
+        }
     }
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
@@ -1907,12 +2087,43 @@ DeleteFirstData (struct cases *arg)
     return (NULL);
   free (arg->inname);
   free (arg->outname);
-  free (arg->data);             // not doing fcloses here as files are not yet open when this is called.
+  if ((arg->flags & DATA_MAPPED) == 0)
+    free (arg->data);           // not doing fcloses here as files are not yet open when this is called.
   struct cases *nxt = arg->next;
   free (arg);
   return nxt;
 }
 
+// release a network made by nnetparser and everything it holds: its data statements (whose files must not be open),
+// plans, topology, and the int8 weights and profile a run may have added.
+void
+FreeNnet (struct nnet *net)
+{
+  if (net == NULL)
+    return;
+  free (net->transfer);
+  free (net->accum);
+  free (net->transferwidths);
+  free (net->weights);
+  free (net->sources);
+  free (net->dests);
+  while (net->data != NULL)
+    net->data = DeleteFirstData (net->data);
+  while (net->plan != NULL)
+    {
+      struct plans *next = net->plan->next;
+      free (net->plan->outputdest);
+      free (net->plan->reportdest);
+      free (net->plan->inputsrc);
+      free (net->plan);
+      net->plan = next;
+    }
+  FreeTopology (net->topology);
+  FreeQuantized (net->quantized);
+  FreeProfile (net->profile);
+  free (net);
+}
+
 // Data section: Specifies inline data, or data locations (files and/or writable pipes).  Training data (readable inputs and outputs) Testing data (readable
 // inputs and outputs) Validation data (readable inputs and outputs) Production input (readable inputs) Production output (writable outputs)
 int
@@ -1942,11 +2153,12 @@ ReadDataSection (struct slidingbuffer *bf, struct conf *config,
 // Node definition statements, until 'EndNodes'
 int
 ReadNodeSection (struct slidingbuffer *bf, struct conf *config,
-                 struct nnet *net)
+                 struct netbuilder *nb)
 {
   assert (bf != NULL);
   assert (config != NULL);
-  assert (net != NULL);
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, "StartNodes"))
     return (0);
@@ -1954,8 +2166,8 @@ ReadNodeSection (struct slidingbuffer *bf, struct conf *config,
     ErrStopParsing (bf,
                     "Only one Node Definition section is allowed in a configuration file.",
                     NULL);
-  if (ReadCreateNodeStmt (bf, config, net))
-    while (ReadCreateNodeStmt (bf, config, net));
+  if (ReadCreateNodeStmt (bf, config, nb))
+    while (ReadCreateNodeStmt (bf, config, nb));
   else
     ErrStopParsing (bf,
                     "No node definitions found. Expected 'CreateInput','CreateHidden' or 'CreateOutput'.",
@@ -1967,6 +2179,7 @@ ReadNodeSection (struct slidingbuffer *bf, struct conf *config,
                     NULL);
   if (net->nodecount == 0)
     ErrStopParsing (bf, "\nNo nodes created.", NULL);
+  CompactNetwork (nb);
   return (1);
 }
 
@@ -1999,6 +2212,103 @@ ReadTrReportFile (struct slidingbuffer *bf, struct conf *config,
   return (1);
 }
 
+// 'Quantize' deploys with int8 weights, calibrated on the Validation or Testing data.
+int
+ReadDpQuantize (struct slidingbuffer *bf, struct conf *config,
+                struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "Quantize"))
+    return (0);
+  pl->planflags |= PLAN_QUANTIZE;
+  return (1);
+}
+
+int
+ReadPrBelow (struct slidingbuffer *bf, struct conf *config, struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "PruneBelow"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->prunebelow = ReadFloatingPoint (bf, config);
+  else
+    ErrStopParsing (bf,
+                    "A weight magnitude (a real number) must follow 'PruneBelow'.",
+                    NULL);
+  if (pl->prunebelow < ZERO)
+    ErrStopParsing (bf, "'PruneBelow' can not be negative.", NULL);
+  return (1);
+}
+
+int
+ReadPrKeepTop (struct slidingbuffer *bf, struct conf *config,
+               struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "KeepTop"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->keeptop = ReadInteger (bf, config);
+  else
+    ErrStopParsing (bf,
+                    "An integer number of synapses per node must follow 'KeepTop'.",
+                    NULL);
+  return (1);
+}
+
+int
+ReadTrPruneEvery (struct slidingbuffer *bf, struct conf *config,
+                  struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "PruneEvery"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->pruneevery = ReadInteger (bf, config);
+  else
+    ErrStopParsing (bf,
+                    "An integer number of epochs must follow 'PruneEvery'.",
+                    NULL);
+  return (1);
+}
+
+// 'Precision Fast' runs the plan with approximate transfer functions; 'Precision Exact' (the default) with libm.
+int
+ReadPlPrecision (struct slidingbuffer *bf, struct conf *config,
+                 struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "Precision"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (AcceptToken (bf, config, "Fast"))
+    pl->planflags |= PLAN_PRECISION_FAST;
+  else if (AcceptToken (bf, config, "Exact"))
+    pl->planflags &= ~PLAN_PRECISION_FAST;
+  else
+    ErrStopParsing (bf, "'Precision' must be followed by 'Fast' or 'Exact'.",
+                    NULL);
+  return (1);
+}
+
 int
 ReadTrMaxEpochs (struct slidingbuffer *bf, struct conf *config,
                  struct plans *pl)
@@ -2095,6 +2405,26 @@ ReadTrBatchSize (struct slidingbuffer *bf, struct conf *config,
   return (1);
 }
 
+int
+ReadDpLatency (struct slidingbuffer *bf, struct conf *config,
+               struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "LatencyWindow"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->latency = ReadInteger (bf, config);
+  else
+    ErrStopParsing (bf,
+                    "An integer number of microseconds must follow 'LatencyWindow'.",
+                    NULL);
+  return (1);
+}
+
 int
 ReadTrEpochSize (struct slidingbuffer *bf, struct conf *config,
                  struct plans *pl)
@@ -2102,7 +2432,7 @@ ReadTrEpochSize (struct slidingbuffer *bf, struct conf *config,
   assert (bf != NULL);
   assert (config != NULL);
   assert (pl != NULL);
-  if (!AcceptToken (bf, config, "Goal"))
+  if (!AcceptToken (bf, config, "EpochSize"))
     return (0);
   else
     SkipToNext (bf, config);
@@ -2112,6 +2442,49 @@ ReadTrEpochSize (struct slidingbuffer *bf, struct conf *config,
     ErrStopParsing (bf,
                     "A an integer number of batches must follow 'EpochSize'.",
                     NULL);
+  if (pl->epochsize == 0)
+    ErrStopParsing (bf, "An epoch must have at least one batch.", NULL);
+  return (1);
+}
+
+int
+ReadTrWindow (struct slidingbuffer *bf, struct conf *config,
+              struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "Window"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->window = ReadInteger (bf, config);
+  else
+    ErrStopParsing (bf, "An integer number of steps must follow 'Window'.",
+                    NULL);
+  if (pl->window == 0)
+    ErrStopParsing (bf, "A window must hold at least one step.", NULL);
+  return (1);
+}
+
+int
+ReadTrStoreEvery (struct slidingbuffer *bf, struct conf *config,
+                  struct plans *pl)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  if (!AcceptToken (bf, config, "StoreEvery"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  if (NumberAvailable (bf))
+    pl->storeevery = ReadInteger (bf, config);
+  else
+    ErrStopParsing (bf,
+                    "An integer number of steps must follow 'StoreEvery'.",
+                    NULL);
   return (1);
 }
 
@@ -2122,7 +2495,8 @@ ReadGradientDescentArg (struct slidingbuffer *bf, struct conf *config,
   assert (bf != NULL);
   assert (config != NULL);
   assert (pl != NULL);
-  if (ReadTrBatchSize (bf, config, pl) || ReadTrLearnRate (bf, config, pl))
+  if (ReadTrBatchSize (bf, config, pl) || ReadTrLearnRate (bf, config, pl)
+      || ReadTrWindow (bf, config, pl) || ReadTrStoreEvery (bf, config, pl))
     return (1);
   return (0);
 }
@@ -2156,11 +2530,17 @@ ReadTrainingPlan (struct slidingbuffer *bf, struct conf *config,
       ret->goal = PLAN_DEFAULT_GOAL;
       ret->trainrate = PLAN_DEFAULT_RATE;
       ret->epochmax = PLAN_DEFAULT_MAXEP;
+      ret->window = PLAN_DEFAULT_WINDOW;
       ret->planflags |= PLAN_GRAD_DESCENT;
       while (ReadGradientDescentArg (bf, config, ret)
+             || ReadTrEpochSize (bf, config, ret)
              || ReadTrMaxEpochs (bf, config, ret)
              || ReadTrMinEpochs (bf, config, ret)
              || ReadTrReportFile (bf, config, ret)
+             || ReadPlPrecision (bf, config, ret)
+             || ReadTrPruneEvery (bf, config, ret)
+             || ReadPrBelow (bf, config, ret)
+             || ReadPrKeepTop (bf, config, ret)
              || ReadTrGoal (bf, config, ret))
         SkipToNext (bf, config);
     }
@@ -2172,14 +2552,17 @@ ReadTrainingPlan (struct slidingbuffer *bf, struct conf *config,
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
     ErrStopParsing (bf,
-                    "Expected 'TrainingGoal', 'LearningRate', 'BatchSize', 'EpochSize','ReportTo', 'MaxEpoch', 'MinEpoch', or closing parenthesis.",
+                    "Expected 'TrainingGoal', 'LearningRate', 'BatchSize', 'EpochSize', 'Window', 'StoreEvery', 'ReportTo', 'Precision', 'PruneEvery', 'PruneBelow', 'KeepTop', 'MaxEpoch', 'MinEpoch', or closing parenthesis.",
+                    NULL);
+  if (ret->pruneevery != 0 && ret->prunebelow == ZERO && ret->keeptop == 0)
+    ErrStopParsing (bf,
+                    "'PruneEvery' needs 'PruneBelow' or 'KeepTop' to say which synapses to prune.",
                     NULL);
   ret = (struct plans *) malloc (sizeof (struct plans));
   if (ret == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure in ReadTrainingPlan.\n");
-      exit (1);
+      Complain ("Runtime Error: Allocation failure in ReadTrainingPlan.\n");
+      Fail (1);
     }
   memcpy ((void *) ret, (void *) &buf, sizeof (struct plans));
   ret->next = net->plan;
@@ -2207,18 +2590,18 @@ ReadTestingPlan (struct slidingbuffer *bf, struct conf *config,
                     NULL);
   else
     SkipToNext (bf, config);
-  if (ReadTrReportFile (bf, config, ret))
+  while (ReadTrReportFile (bf, config, ret)
+         || ReadPlPrecision (bf, config, ret))
     SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
     ErrStopParsing (bf,
-                    "Testing Plans may have 'ReportTo' arguments, or end with closing parenthesis.",
+                    "Testing Plans may have 'ReportTo' or 'Precision' arguments, and end with closing parenthesis.",
                     NULL);
   ret = (struct plans *) malloc (sizeof (struct plans));
   if (ret == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure in ReadTestingPlan.\n");
-      exit (1);
+      Complain ("Runtime Error: Allocation failure in ReadTestingPlan.\n");
+      Fail (1);
     }
   memcpy ((void *) ret, (void *) &buf, sizeof (struct plans));
   ret->next = net->plan;
@@ -2246,18 +2629,61 @@ ReadValidationPlan (struct slidingbuffer *bf, struct conf *config,
                     NULL);
   else
     SkipToNext (bf, config);
-  if (ReadTrReportFile (bf, config, ret))
+  while (ReadTrReportFile (bf, config, ret)
+         || ReadPlPrecision (bf, config, ret))
     SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
     ErrStopParsing (bf,
-                    "Validation Plans may have 'ReportTo' arguments, or end with closing parenthesis.",
+                    "Validation Plans may have 'ReportTo' or 'Precision' arguments, and end with closing parenthesis.",
                     NULL);
   ret = (struct plans *) malloc (sizeof (struct plans));
   if (ret == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure in ReadValidationPlan.\n");
-      exit (1);
+      Complain ("Runtime Error: Allocation failure in ReadValidationPlan.\n");
+      Fail (1);
+    }
+  memcpy ((void *) ret, (void *) &buf, sizeof (struct plans));
+  ret->next = net->plan;
+  net->plan = ret;
+  return (1);
+}
+
+int
+ReadPruningPlan (struct slidingbuffer *bf, struct conf *config,
+                 struct nnet *net)
+{
+  assert (bf != NULL);
+  assert (config != NULL);
+  assert (net != NULL);
+  struct plans buf = {0};
+  struct plans *ret = &buf;
+  if (!AcceptToken (bf, config, "PruningPlan"))
+    return (0);
+  else
+    SkipToNext (bf, config);
+  ret->planflags |= PLAN_PRUNE;
+  if (!AcceptToken (bf, config, "("))
+    ErrStopParsing (bf,
+                    "'PruningPlan' must be followed by an open parenthesis.",
+                    NULL);
+  else
+    SkipToNext (bf, config);
+  while (ReadTrReportFile (bf, config, ret)
+         || ReadPrBelow (bf, config, ret) || ReadPrKeepTop (bf, config, ret))
+    SkipToNext (bf, config);
+  if (!AcceptToken (bf, config, ")"))
+    ErrStopParsing (bf,
+                    "Pruning Plans may have 'PruneBelow', 'KeepTop', or 'ReportTo' arguments, and end with closing parenthesis.",
+                    NULL);
+  if (ret->prunebelow == ZERO && ret->keeptop == 0)
+    ErrStopParsing (bf,
+                    "A Pruning Plan needs 'PruneBelow' or 'KeepTop' to say which synapses to prune.",
+                    NULL);
+  ret = (struct plans *) malloc (sizeof (struct plans));
+  if (ret == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in ReadPruningPlan.\n");
+      Fail (1);
     }
   memcpy ((void *) ret, (void *) &buf, sizeof (struct plans));
   ret->next = net->plan;
@@ -2279,24 +2705,28 @@ ReadDeploymentPlan (struct slidingbuffer *bf, struct conf *config,
   else
     SkipToNext (bf, config);
   ret->planflags |= PLAN_DEPLOY;
+  ret->latency = PLAN_DEFAULT_LATENCY;
   if (!AcceptToken (bf, config, "("))
     ErrStopParsing (bf,
                     "'DeploymentPlan' must be followed by an open parenthesis.",
                     NULL);
   else
     SkipToNext (bf, config);
-  if (ReadTrReportFile (bf, config, ret))
+  while (ReadTrReportFile (bf, config, ret)
+         || ReadTrBatchSize (bf, config, ret)
+         || ReadDpLatency (bf, config, ret)
+         || ReadPlPrecision (bf, config, ret)
+         || ReadDpQuantize (bf, config, ret))
     SkipToNext (bf, config);
   if (!AcceptToken (bf, config, ")"))
     ErrStopParsing (bf,
-                    "Deployment Plans may have 'ReportTo' arguments, and end with closing parenthesis.",
+                    "Deployment Plans may have 'ReportTo', 'BatchSize', 'LatencyWindow', 'Precision', or 'Quantize' arguments, and end with closing parenthesis.",
                     NULL);
   ret = (struct plans *) malloc (sizeof (struct plans));
   if (ret == NULL)
     {
-      fprintf (stderr,
-               "Runtime Error: Allocation failure in ReadDeploymentPlan.\n");
-      exit (1);
+      Complain ("Runtime Error: Allocation failure in ReadDeploymentPlan.\n");
+      Fail (1);
     }
   memcpy ((void *) ret, (void *) &buf, sizeof (struct plans));
   ret->next = net->plan;
@@ -2318,11 +2748,12 @@ ReadPlanSection (struct slidingbuffer *bf, struct conf *config,
   while (ReadTrainingPlan (bf, config, net)
          || ReadTestingPlan (bf, config, net)
          || ReadValidationPlan (bf, config, net)
+         || ReadPruningPlan (bf, config, net)
          || ReadDeploymentPlan (bf, config, net))
     SkipToNext (bf, config);
   if (!AcceptToken (bf, config, "EndPlan"))
     ErrStopParsing (bf,
-                    "Expected 'TestPlan', 'TrainingPlan', 'ValidationPlan', 'DeploymentPlan',  or 'EndPlan'.",
+                    "Expected 'TestPlan', 'TrainingPlan', 'ValidationPlan', 'PruningPlan', 'DeploymentPlan',  or 'EndPlan'.",
                     NULL);
   return (1);
 }
@@ -2338,145 +2769,90 @@ ValidateConnections (struct slidingbuffer *bf, struct conf *config,
   assert (bf != NULL);
   assert (config != NULL);
   assert (net != NULL);
-  int indexconn = 0;
   int indexnode = 1;
   char wstr[WARNSIZE];
+  double began = PROFILE_START (net);
+  FreeTopology (net->topology);
+  struct topology *tp = net->topology = SummarizeTopology (net);
   if ((config->flags & SILENCE_BIAS) == 0)
     {
-      while (net->sources[indexconn] != 0 && ++indexconn < net->synapsecount);
-      if (indexconn == net->synapsecount)
+      if (tp->outdegree[0] == 0)
         AddWarning (bf,
                     "Warning:  Are you sure you wanted to define a network with no bias connections (connections with source 0)?");
-      for (indexconn = 0;
-           indexconn < net->synapsecount && net->dests[indexconn] != 0;
-           indexconn++);
-      if (indexconn != net->synapsecount)
+      if (tp->indegree[0] != 0)
         AddWarning (bf,
                     "Warning: Connections whose destination is the bias node (node zero) are being ignored.");
     }
-  if ((config->flags & SILENCE_NODEOUTPUT) == 0)
+  if ((config->flags & SILENCE_NODEOUTPUT) == 0 && tp->silent != 0)
     for (indexnode = 1; indexnode < net->nodecount - net->outputcount;
          indexnode++)
+      if (tp->outdegree[indexnode] == 0)
+        {
+          if (indexnode <= net->inputcount)
+            snprintf (wstr, WARNSIZE,
+                      "Warning: node %d is an input node but does not send any signals.",
+                      indexnode);
+          else
+            snprintf (wstr, WARNSIZE,
+                      "Warning: node %d is a hidden node that does not send any signals.",
+                      indexnode);
+          AddWarning (bf, wstr);
+        }
+  if ((config->flags & SILENCE_NODEINPUT) == 0 && tp->deaf != 0)
+    for (indexnode = net->inputcount + 1; indexnode < net->nodecount;
+         indexnode++)
+      if (tp->indegree[indexnode] == 0)
+        {
+          if (indexnode >= net->nodecount - net->outputcount)
+            snprintf (wstr, WARNSIZE,
+                      "Warning: node %d is an output node but does not receive any signals.",
+                      indexnode);
+          else
+            snprintf (wstr, WARNSIZE,
+                      "Warning: node %d is a hidden node that does not receive any signals.",
+                      indexnode);
+          AddWarning (bf, wstr);
+        }
+  if ((config->flags & SILENCE_OUTPUT) == 0 && net->outputcount == 0)
+    AddWarning (bf, "Warning: the network as defined has no output nodes.");
+  if ((config->flags & SILENCE_INPUT) == 0 && net->inputcount == 0)
+    AddWarning (bf, "Warning: the network as defined has no input nodes.");
+  if (((config->flags & SILENCE_MULTIACTIVATION) == 0
+       && tp->multiactivated != 0)
+      || ((config->flags & SILENCE_RECURRENCE) == 0 && tp->recurrent != 0))
+    for (indexnode = 0; indexnode < net->nodecount; indexnode++)
       {
-        for (indexconn = 0;
-             indexconn < net->synapsecount
-             && net->sources[indexconn] != indexnode; indexconn++);
-        if (indexconn == net->synapsecount)
+        if ((config->flags & SILENCE_MULTIACTIVATION) == 0
+            && IsMultiActivatedNode (net, tp, indexnode))
           {
-            if (indexnode <= net->inputcount)
-              snprintf (wstr, WARNSIZE,
-                        "Warning: node %d is an input node but does not send any signals.",
-                        indexnode);
-            else
-              snprintf (wstr, WARNSIZE,
-                        "Warning: node %d is a hidden node that does not send any signals.",
-                        indexnode);
+            snprintf (wstr, WARNSIZE,
+                      "Warning: node %d will be activated more than once per activation sequence.",
+                      indexnode);
             AddWarning (bf, wstr);
           }
-      }
-  if ((config->flags & SILENCE_NODEINPUT) == 0)
-    for (indexnode = net->inputcount + 1; indexnode < net->nodecount;
-         indexnode++)
-      {
-        for (indexconn = 0;
-             indexconn < net->synapsecount
-             && net->dests[indexconn] != indexnode; indexconn++);
-        if (indexconn == net->synapsecount)
+        if ((config->flags & SILENCE_RECURRENCE) == 0
+            && IsRecurrentNode (net, tp, indexnode))
           {
-            if (indexnode >= net->nodecount - net->outputcount)
-              snprintf (wstr, WARNSIZE,
-                        "Warning: node %d is an output node but does not receive any signals.",
-                        indexnode);
-            else
-              snprintf (wstr, WARNSIZE,
-                        "Warning: node %d is a hidden node that does not receive any signals.",
-                        indexnode);
+            snprintf (wstr, WARNSIZE,
+                      "Warning: the network is recurrent because node %d saves signal across activation sequences.",
+                      indexnode);
             AddWarning (bf, wstr);
           }
       }
-  if ((config->flags & SILENCE_OUTPUT) == 0 && net->outputcount == 0)
-    AddWarning (bf, "Warning: the network as defined has no output nodes.");
-  if ((config->flags & SILENCE_INPUT) == 0 && net->inputcount == 0)
-    AddWarning (bf, "Warning: the network as defined has no input nodes.");
-  if ((config->flags & SILENCE_MULTIACTIVATION) == 0
-      || (config->flags & SILENCE_RECURRENCE) == 0)
-    {
-      int *checkbuf = calloc (net->nodecount, sizeof (int));
-      // checkbuf meanings = 0: no use yet recorded.  1: recorded as dest only.  2: recorded as dest then source.  3: recorded as source only.  4: recorded
-      // as source then dest. 5: recorded as dest then source then dest. 6: recorded as source then dest then source. 7: recorded as source / dest /
-      // source / dest OR dest / source / dest / source (multiactivation)
-      if (checkbuf != NULL)
-        {
-          for (indexconn = 0; indexconn < net->synapsecount; indexconn++)
-            {
-              switch (checkbuf[net->sources[indexconn]])
-                {
-                case 0:
-                  checkbuf[net->sources[indexconn]] = 3;
-                  break;
-                case 1:
-                  checkbuf[net->sources[indexconn]] = 2;
-                  break;
-                case 4:
-                  checkbuf[net->sources[indexconn]] = 6;
-                  break;
-                case 5:
-                  checkbuf[net->sources[indexconn]] = 7;
-                  break;
-                }
-              switch (checkbuf[net->dests[indexconn]])
-                {
-                case 0:
-                  checkbuf[net->dests[indexconn]] = 1;
-                  break;
-                case 2:
-                  checkbuf[net->dests[indexconn]] = 5;
-                  break;
-                case 3:
-                  checkbuf[net->dests[indexconn]] = 4;
-                  break;
-                case 6:
-                  checkbuf[net->dests[indexconn]] = 7;
-                  break;
-                }
-            }
-          for (indexnode = 0; indexnode < net->nodecount; indexnode++)
-            {
-              if ((config->flags & SILENCE_MULTIACTIVATION) == 0
-                  && (checkbuf[indexnode] == 7
-                      || (checkbuf[indexnode] > 4
-                          && indexnode >= net->nodecount - net->outputcount)))
-                {
-                  snprintf (wstr, WARNSIZE,
-                            "Warning: node %d will be activated more than once per activation sequence.",
-                            indexnode);
-                  AddWarning (bf, wstr);
-                }
-              if ((config->flags & SILENCE_RECURRENCE) == 0
-                  && checkbuf[indexnode] >= 4
-                  && indexnode < net->nodecount - net->outputcount)
-                {
-                  snprintf (wstr, WARNSIZE,
-                            "Warning: the network is recurrent because node %d saves signal across activation sequences.",
-                            indexnode);
-                  AddWarning (bf, wstr);
-                }
-            }
-          free (checkbuf);
-        }
-    }
-  return (1);                   // For now always returns 1.  TODO, maybe, a return code that indicates what topological reduction can be done on it.
+  PROFILE_STOP (net, PROF_VALIDATE, began);
+  return (1);                   // For now always returns 1.  net->topology holds what later stages need to know.
 }
 
 
 // Connection statements, until 'EndConnections'
 int
 ReadConnections (struct slidingbuffer *bf, struct conf *config,
-                 struct nnet *net)
+                 struct netbuilder *nb)
 {
   assert (bf != NULL);
   assert (config != NULL);
-  assert (net != NULL);
+  assert (nb != NULL);
+  struct nnet *net = nb->net;
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, "StartConnections"))
     return (0);
@@ -2484,18 +2860,25 @@ ReadConnections (struct slidingbuffer *bf, struct conf *config,
     ErrStopParsing (bf,
                     "Found 'StartConnections', expected 'StartNodes.' Nodes cannot be connected before they are defined.",
                     NULL);
+  struct weightfile *mapped = NULL;
+  struct weightfile *current = NULL;
+  unsigned int previous = net->synapsecount;
   SkipToNext (bf, config);
-  if (ReadConnectStmt (bf, config, net))
-    while (ReadConnectStmt (bf, config, net));
-  else
+  while (ReadWeightFileStmt (bf, config, &mapped, &current)
+         || ReadConnectStmt (bf, config, nb, &mapped, current));
+  if (net->synapsecount == previous)
     ErrStopParsing (bf, "No 'Connect' statement found.", NULL);
+  if (mapped != NULL)
+    bf->weightfiles = 1;
+  CloseWeightFiles (mapped);
   SkipToNext (bf, config);
   if (!AcceptToken (bf, config, "EndConnections"))
     ErrStopParsing (bf,
-                    "Expected 'Connect' statement or 'EndConnections' terminator.",
+                    "Expected 'Connect' statement, 'WeightFile' statement, or 'EndConnections' terminator.",
                     NULL);
   if (net->synapsecount == 0)
     ErrStopParsing (bf, "No connections created.", NULL);
+  CompactNetwork (nb);
   return (ValidateConnections (bf, config, net));
 }
 
@@ -2528,6 +2911,18 @@ debugnnet (struct nnet *net)
     printf ("#%d:%d(x" FLOFMT3 ")->%d  ", count, net->sources[count],
             net->weights[count], net->dests[count]);
   printf ("\n");
+  if (net->topology != NULL)
+    {
+      const struct topology *tp = net->topology;
+      printf ("Topology silent %u, deaf %u, recurrent %u, multiactivated %u\n",
+              tp->silent, tp->deaf, tp->recurrent, tp->multiactivated);
+      for (count = 0; count < tp->nodecount; count++)
+        printf ("   Node %d: in %u, out %u%s%s\n", count, tp->indegree[count],
+                tp->outdegree[count],
+                IsRecurrentNode (net, tp, count) ? ", recurrent" : "",
+                IsMultiActivatedNode (net, tp, count) ? ", multiactivated" :
+                "");
+    }
 }
 
 
@@ -2537,13 +2932,14 @@ nnetparser (struct nnet *net, struct conf *cfg, struct slidingbuffer *in)
   assert (net != NULL);
   assert (cfg != NULL);
   assert (in != NULL);
+  struct netbuilder *nb = in->builder = StartNetBuilder (net);
   ReadOpeningComment (in, cfg);
   SkipToNext (in, cfg);
-  if (ReadConfigSection (in, cfg, net) || ReadNodeSection (in, cfg, net)
-      || ReadConnections (in, cfg, net) || ReadPlanSection (in, cfg, net)
+  if (ReadConfigSection (in, cfg, net) || ReadNodeSection (in, cfg, nb)
+      || ReadConnections (in, cfg, nb) || ReadPlanSection (in, cfg, net)
       || ReadDataSection (in, cfg, net))
-    while (ReadConfigSection (in, cfg, net) || ReadNodeSection (in, cfg, net)
-           || ReadConnections (in, cfg, net) || ReadPlanSection (in, cfg, net)
+    while (ReadConfigSection (in, cfg, net) || ReadNodeSection (in, cfg, nb)
+           || ReadConnections (in, cfg, nb) || ReadPlanSection (in, cfg, net)
            || ReadDataSection (in, cfg, net))
       SkipToNext (in, cfg);
   else
@@ -2558,5 +2954,8 @@ nnetparser (struct nnet *net, struct conf *cfg, struct slidingbuffer *in)
     ErrStopParsing (in,
                     "No connections defined. A nonempty 'StartConnections' section is needed.",
                     NULL);
-  printf ("\n");
+  FinishNetBuilder (nb);
+  in->builder = NULL;
+  if ((cfg->flags & (DEBUG_ECHO | SILENCE_ECHO)) == DEBUG_ECHO)
+    printf ("\n");
 }
@@ -0,0 +1,462 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// carrying out the plans of an nnet script once it has been parsed.
+
+#include "includes.h"
+#include "defines.h"
+#include "feedforward.h"
+#include "casestream.h"
+#include "plans.h"
+#include "save.h"
+#include "sequence.h"
+#include "train.h"
+#include "prune.h"
+#include "quantize.h"
+#include "profile.h"
+#include "server.h"
+
+// open a file named in the script for appending.  "stdout" names standard output.
+static FILE *
+OpenDestination (const char *name)
+{
+  FILE *retval;
+  if (strcmp (name, "stdout") == 0)
+    return (stdout);
+  if (NULL == (retval = fopen (name, "a")))
+    {
+      fprintf (stderr, "unable to open %s\n", name);
+      exit (1);
+    }
+  return (retval);
+}
+
+static void
+CloseDestination (FILE * dest)
+{
+  if (dest != stdout)
+    fclose (dest);
+  else
+    fflush (stdout);
+}
+
+// the next batch of cases from a stream, counted as data input if net is profiled.
+static flotype *
+ReadCaseBatch (const struct nnet *net, struct casestream *cs, size_t *count)
+{
+  double began = PROFILE_START (net);
+  flotype *rows = NextCaseBatch (cs, count);
+  PROFILE_STOP (net, PROF_DATA, began);
+  return (rows);
+}
+
+// write one case in the [[inputs][outputs]] form used for Immediate data, with the outputs the network produced.  netout
+// holds the case's outputs stride values apart.
+void
+WriteResultCase (FILE * dest, const struct cases *dat, const flotype * row,
+                 const flotype * netout, size_t stride, size_t outputcount)
+{
+  int writein = (dat->flags & DATA_NOWRITEINPUT) == 0 && dat->inputcount > 0;
+  int writeout = (dat->flags & DATA_NOWRITEOUTPUT) == 0;
+  char flo[FLOTEXTMAX];
+  if (writein && writeout)
+    fputc ('[', dest);
+  if (writein)
+    {
+      fputc ('[', dest);
+      for (size_t in = 0; in < dat->inputcount; in++)
+        fprintf (dest, in == 0 ? "%s" : " %s", FloText (flo, row[in]));
+      fputc (']', dest);
+    }
+  if (writeout)
+    {
+      fputc ('[', dest);
+      for (size_t out = 0; out < outputcount; out++)
+        fprintf (dest, out == 0 ? "%s" : " %s",
+                 FloText (flo, netout[out * stride]));
+      fputc (']', dest);
+    }
+  if (writein && writeout)
+    fputc (']', dest);
+  fputc ('\n', dest);
+}
+
+// run every case of one data source through the network.  Returns the number of cases run, and adds the squared
+// error of every output that has a target value to *sqerr.
+static size_t
+RunDataSet (struct nnet *net, struct cases *dat, double *sqerr)
+{
+  size_t casesize = dat->inputcount + dat->outputcount;
+  size_t count;
+  size_t total = 0;
+  flotype *rows;
+  FILE *dest = NULL;
+  int scored = (dat->outputcount == net->outputcount && net->outputcount > 0);
+  flotype *ins =
+    (flotype *) calloc ((net->inputcount + 1) * STREAM_BATCH,
+                        sizeof (flotype));
+  flotype *outs =
+    (flotype *) malloc (sizeof (flotype) * (net->outputcount + 1) *
+                        STREAM_BATCH);
+  flotype *history =
+    (flotype *) malloc (sizeof (flotype) * net->nodecount * STREAM_BATCH);
+  sigtype *acts =
+    (sigtype *) malloc (sizeof (sigtype) * net->nodecount * STREAM_BATCH);
+  if (ins == NULL || outs == NULL || history == NULL || acts == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in RunDataSet.\n");
+      exit (1);
+    }
+  if (dat->outname != NULL)
+    dest = OpenDestination (dat->outname);
+  struct casestream *cs = OpenCaseStream (dat, STREAM_BATCH, STREAM_RING);
+  while ((rows = ReadCaseBatch (net, cs, &count)) != NULL)
+    {
+      // cases arrive row-major; fwdprop_batch wants inputs node-major.
+      if (dat->inputcount == net->inputcount)
+        for (size_t b = 0; b < count; b++)
+          for (size_t in = 0; in < net->inputcount; in++)
+            ins[in * count + b] = rows[b * casesize + in];
+      init_activations_batch (net, acts, count);
+      fwdprop_batch (net, count, ins, acts, history, outs);
+      for (size_t b = 0; b < count; b++)
+        {
+          const flotype *row = &(rows[b * casesize]);
+          if (scored)
+            for (size_t out = 0; out < net->outputcount; out++)
+              {
+                double diff = (double) outs[out * count + b] -
+                  (double) row[dat->inputcount + out];
+                *sqerr += diff * diff;
+              }
+          if (dest != NULL)
+            {
+              double began = PROFILE_START (net);
+              WriteResultCase (dest, dat, row, &(outs[b]), count,
+                               net->outputcount);
+              PROFILE_STOP (net, PROF_DATA, began);
+            }
+        }
+      total += count;
+    }
+  CloseCaseStream (cs);
+  if (dest != NULL)
+    CloseDestination (dest);
+  free (ins);
+  free (outs);
+  free (history);
+  free (acts);
+  return (total);
+}
+
+// run the cases of a Sequence data source through the network one time step per case, carrying the network's state
+// from step to step.  The first value of each case is the sequence marker: a nonzero marker starts a new sequence.
+// Returns the number of cases run, and adds the squared error of every output that has a target value to *sqerr.
+static size_t
+RunSequenceSet (struct nnet *net, struct cases *dat, double *sqerr)
+{
+  size_t casesize = dat->inputcount + dat->outputcount;
+  size_t count;
+  size_t total = 0;
+  flotype *rows;
+  FILE *dest = NULL;
+  int scored = (dat->outputcount == net->outputcount && net->outputcount > 0);
+  int fed = (dat->inputcount == net->inputcount + 1);
+  flotype *zeros = (flotype *) calloc (net->inputcount + 1, sizeof (flotype));
+  if (zeros == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in RunSequenceSet.\n");
+      exit (1);
+    }
+  struct sequencer *sq = StartSequencer (net);
+  if (dat->outname != NULL)
+    dest = OpenDestination (dat->outname);
+  struct casestream *cs = OpenCaseStream (dat, STREAM_BATCH, STREAM_RING);
+  while ((rows = ReadCaseBatch (net, cs, &count)) != NULL)
+    {
+      for (size_t b = 0; b < count; b++)
+        {
+          const flotype *row = &(rows[b * casesize]);
+          if (row[0] != ZERO)
+            ResetSequence (sq);
+          const flotype *outs = SequenceStep (sq, fed ? &(row[1]) : zeros);
+          if (scored)
+            for (size_t out = 0; out < net->outputcount; out++)
+              {
+                double diff = (double) outs[out] -
+                  (double) row[dat->inputcount + out];
+                *sqerr += diff * diff;
+              }
+          if (dest != NULL)
+            {
+              double began = PROFILE_START (net);
+              WriteResultCase (dest, dat, row, outs, 1, net->outputcount);
+              PROFILE_STOP (net, PROF_DATA, began);
+            }
+        }
+      total += count;
+    }
+  CloseCaseStream (cs);
+  if (dest != NULL)
+    CloseDestination (dest);
+  FinishSequencer (sq);
+  free (zeros);
+  return (total);
+}
+
+// what quantization is measured against over its calibration cases.
+struct calibration
+{
+  flotype *maxout;              // nodecount: the largest magnitude each node's output reaches in float.
+  size_t cases;
+  size_t scoredvals;
+  double sqdiff;                // squared difference of quantized outputs from float outputs.
+  double sqerr;                 // squared error of quantized outputs from the targets.
+  double floaterr;              // squared error of float outputs from the targets.
+};
+
+// run the cases of a data source through the network for calibration.  Without qn, the float outputs of every node are
+// measured into cal->maxout; with it, the float and quantized outputs are compared.
+static void
+CalibrateOnSet (struct nnet *net, struct cases *dat, struct quantized *qn,
+                struct calibration *cal)
+{
+  size_t casesize = dat->inputcount + dat->outputcount;
+  size_t count;
+  flotype *rows;
+  int scored = (dat->outputcount == net->outputcount && net->outputcount > 0);
+  flotype *ins = (flotype *) malloc (sizeof (flotype) * (net->inputcount + 1)
+                                     * STREAM_BATCH);
+  flotype *outs = (flotype *) malloc (sizeof (flotype) *
+                                      (net->outputcount + 1) * STREAM_BATCH);
+  flotype *qouts = (flotype *) malloc (sizeof (flotype) *
+                                       (net->outputcount + 1) * STREAM_BATCH);
+  flotype *history =
+    (flotype *) malloc (sizeof (flotype) * net->nodecount * STREAM_BATCH);
+  sigtype *acts =
+    (sigtype *) malloc (sizeof (sigtype) * net->nodecount * STREAM_BATCH);
+  if (ins == NULL || outs == NULL || qouts == NULL || history == NULL
+      || acts == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in CalibrateOnSet.\n");
+      exit (1);
+    }
+  struct casestream *cs = OpenCaseStream (dat, STREAM_BATCH, STREAM_RING);
+  while ((rows = ReadCaseBatch (net, cs, &count)) != NULL)
+    {
+      for (size_t b = 0; b < count; b++)
+        for (size_t in = 0; in < net->inputcount; in++)
+          ins[in * count + b] = rows[b * casesize + in];
+      init_activations_batch (net, acts, count);
+      fwdprop_batch (net, count, ins, acts, history, outs);
+      cal->cases += count;
+      if (qn == NULL)
+        {
+          for (size_t node = 0; node < net->nodecount; node++)
+            for (size_t b = 0; b < count; b++)
+              cal->maxout[node] = MAX (cal->maxout[node],
+                                       absolute (history[node * count + b]));
+          continue;
+        }
+      net->quantized = qn;
+      init_activations_batch (net, acts, count);
+      fwdprop_batch (net, count, ins, acts, history, qouts);
+      net->quantized = NULL;
+      for (size_t b = 0; b < count; b++)
+        for (size_t out = 0; out < net->outputcount; out++)
+          {
+            double quant = qouts[out * count + b];
+            double diff = quant - (double) outs[out * count + b];
+            cal->sqdiff += diff * diff;
+            if (scored)
+              {
+                double target = rows[b * casesize + dat->inputcount + out];
+                cal->sqerr += (quant - target) * (quant - target);
+                cal->floaterr += ((double) outs[out * count + b] - target) *
+                  ((double) outs[out * count + b] - target);
+                cal->scoredvals++;
+              }
+          }
+    }
+  CloseCaseStream (cs);
+  free (ins);
+  free (outs);
+  free (qouts);
+  free (history);
+  free (acts);
+}
+
+// quantize the network for a Deployment plan, calibrating with the Validation data, or the Testing data if there is no
+// Validation data, and report how far the quantized outputs are from the float ones.  Returns NULL, leaving the network
+// to run in float, if there is nothing to calibrate with.
+static struct quantized *
+QuantizeForDeployment (struct nnet *net, struct plans *pl)
+{
+  struct calibration cal;
+  uint32_t calflag = DATA_VALIDATION;
+  struct quantized *qn;
+  memset (&cal, 0, sizeof (struct calibration));
+  cal.maxout = (flotype *) calloc (net->nodecount, sizeof (flotype));
+  if (cal.maxout == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in QuantizeForDeployment.\n");
+      exit (1);
+    }
+  for (int tries = 0; tries < 2 && cal.cases == 0; tries++)
+    {
+      for (struct cases * dat = net->data; dat != NULL; dat = dat->next)
+        if ((dat->flags & calflag) != 0
+            && (dat->flags & (DATA_FROMPIPE | DATA_SEQUENCE)) == 0
+            && dat->inputcount == net->inputcount)
+          CalibrateOnSet (net, dat, NULL, &cal);
+      if (cal.cases == 0)
+        calflag = DATA_TESTING;
+    }
+  if (cal.cases == 0)
+    {
+      fprintf (stderr,
+               "Quantize needs Validation or Testing data to calibrate with; deploying in float.\n");
+      free (cal.maxout);
+      return (NULL);
+    }
+  qn = QuantizeNetwork (net, cal.maxout);
+  cal.cases = 0;
+  for (struct cases * dat = net->data; dat != NULL; dat = dat->next)
+    if ((dat->flags & calflag) != 0
+        && (dat->flags & (DATA_FROMPIPE | DATA_SEQUENCE)) == 0
+        && dat->inputcount == net->inputcount)
+      CalibrateOnSet (net, dat, qn, &cal);
+  FILE *report =
+    OpenDestination (pl->reportdest != NULL ? pl->reportdest : "stdout");
+  fprintf (report,
+           "Quantized: %u of %u synapses int8, RMS difference from float %.9g over %zu %s cases",
+           qn->intsynapses, net->synapsecount,
+           net->outputcount > 0 ?
+           sqrt (cal.sqdiff / ((double) cal.cases * net->outputcount)) : 0.0,
+           cal.cases, calflag == DATA_VALIDATION ? "Validation" : "Testing");
+  if (cal.scoredvals > 0)
+    fprintf (report, ", RMS error %.9g (float %.9g)",
+             sqrt (cal.sqerr / cal.scoredvals),
+             sqrt (cal.floaterr / cal.scoredvals));
+  fputc ('\n', report);
+  CloseDestination (report);
+  free (cal.maxout);
+  return (qn);
+}
+
+// run the data sets flagged with dataflag, and report the RMS error, and the profile if the run is profiled, to the
+// plan's ReportTo destination.  Without ReportTo, testing and validation report to stdout and deployment doesn't report.
+static void
+RunEvaluationPlan (struct nnet *net, struct plans *pl, uint32_t dataflag,
+                   const char *planname)
+{
+  double sqerr = 0.0;
+  size_t total = 0;
+  size_t scoredvals = 0;
+  FILE *report = NULL;
+  for (struct cases * dat = net->data; dat != NULL; dat = dat->next)
+    if ((dat->flags & dataflag) != 0 && (dat->flags & DATA_FROMPIPE) != 0)
+      {
+        if ((pl->planflags & PLAN_DEPLOY) != 0)
+          total += ServeDeployment (net, pl, dat);
+        else
+          fprintf (stderr,
+                   "FromPipe data is only read by Deployment plans; skipping \"%s\".\n",
+                   dat->inname);
+      }
+    else if ((dat->flags & dataflag) != 0)
+      {
+        if (net->quantized != NULL && (dat->flags & DATA_SEQUENCE) != 0)
+          fprintf (stderr,
+                   "Quantize does not apply to Sequence data; deploying it in float.\n");
+        size_t count = (dat->flags & DATA_SEQUENCE) != 0 ?
+          RunSequenceSet (net, dat, &sqerr) : RunDataSet (net, dat, &sqerr);
+        total += count;
+        if (dat->outputcount == net->outputcount)
+          scoredvals += count * net->outputcount;
+      }
+  if (pl->reportdest != NULL)
+    report = OpenDestination (pl->reportdest);
+  else if ((pl->planflags & PLAN_DEPLOY) == 0)
+    report = stdout;
+  if (report == NULL)
+    {
+      ProfileReport (net, NULL, planname);
+      return;
+    }
+  fprintf (report, "%s: %zu cases", planname, total);
+  if (scoredvals > 0)
+    fprintf (report, ", RMS error %.9g", sqrt (sqerr / scoredvals));
+  fputc ('\n', report);
+  ProfileReport (net, report, planname);
+  CloseDestination (report);
+}
+
+// prune the network, and report how many synapses remain to the plan's ReportTo destination or stdout.
+static void
+RunPruningPlan (struct nnet *net, struct plans *pl)
+{
+  unsigned int before = net->synapsecount;
+  unsigned int removed = PruneNetwork (net, pl->prunebelow, pl->keeptop);
+  FILE *report =
+    OpenDestination (pl->reportdest != NULL ? pl->reportdest : "stdout");
+  fprintf (report, "Pruning: removed %u of %u synapses, %u remain\n",
+           removed, before, net->synapsecount);
+  ProfileReport (net, report, "Pruning");
+  CloseDestination (report);
+}
+
+// carry out the plans in the order they appear in the script.  Training plans make their periodic saves through saver.
+void
+ExecutePlans (struct nnet *net, struct conf *config,
+              struct checkpointer *saver)
+{
+  assert (net != NULL);
+  assert (config != NULL);
+  size_t plancount;
+  struct plans **order = PlansInOrder (net->plan, &plancount);
+  for (size_t index = 0; index < plancount; index++)
+    {
+      struct plans *pl = order[index];
+      net->precision = (pl->planflags & PLAN_PRECISION_FAST) != 0 ?
+        PRECISION_FAST : PRECISION_EXACT;
+      if ((pl->planflags & PLAN_TRAIN) != 0)
+        TrainNetwork (net, config, pl, saver);
+      else if ((pl->planflags & PLAN_TEST) != 0)
+        RunEvaluationPlan (net, pl, DATA_TESTING, "Testing");
+      else if ((pl->planflags & PLAN_VALIDATE) != 0)
+        RunEvaluationPlan (net, pl, DATA_VALIDATION, "Validation");
+      else if ((pl->planflags & PLAN_PRUNE) != 0)
+        RunPruningPlan (net, pl);
+      else if ((pl->planflags & PLAN_DEPLOY) != 0)
+        {
+          if ((pl->planflags & PLAN_QUANTIZE) != 0)
+            net->quantized = QuantizeForDeployment (net, pl);
+          RunEvaluationPlan (net, pl, DATA_DEPLOYMENT, "Deployment");
+          FreeQuantized (net->quantized);
+          net->quantized = NULL;
+        }
+    }
+  net->precision = PRECISION_EXACT;
+  free (order);
+}
@@ -0,0 +1,162 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+// counting where the time of an nnet run goes, for nnet -p.
+
+#include "includes.h"
+#include "defines.h"
+#include "profile.h"
+#include "fail.h"
+
+static const char *phasenames[PROF_PHASES] = { "parse", "validate", "compile",
+  "forward", "backward", "update", "data", "checkpoint"
+};
+
+static const char *outtokens[OUTPUTCOUNT] = { OUTTOKENS };
+
+double
+ProfileClock (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return ((double) now.tv_sec + (double) now.tv_nsec * 1e-9);
+}
+
+// start counting.  rangesize is the number of nodes in each range timed on its own; zero times only the phases.
+struct profile *
+StartProfile (unsigned int rangesize)
+{
+  struct profile *prof = (struct profile *) calloc (1, sizeof (struct profile));
+  if (prof == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in StartProfile.\n");
+      Fail (1);
+    }
+  prof->rangesize = rangesize;
+  prof->since = ProfileClock ();
+  return (prof);
+}
+
+// count one call of phase, which began at start.
+void
+ProfileCount (struct profile *prof, int phase, double start)
+{
+  assert (prof != NULL);
+  assert (phase >= 0 && phase < PROF_PHASES);
+  prof->seconds[phase] += ProfileClock () - start;
+  prof->calls[phase]++;
+}
+
+// count the firing of the group of nodes starting at node, whose transfer function is fchoice, which began at start.
+void
+ProfileFiring (struct profile *prof, int fchoice, unsigned int node,
+               double start)
+{
+  assert (prof != NULL);
+  assert (prof->rangesize != 0);
+  const double elapsed = ProfileClock () - start;
+  const unsigned int range = node / prof->rangesize;
+  if (fchoice >= 0 && fchoice < OUTPUTCOUNT)
+    {
+      prof->transferseconds[fchoice] += elapsed;
+      prof->transfercalls[fchoice]++;
+    }
+  if (range >= prof->rangecount)
+    {
+      unsigned int count = MAX (range + 1, 2 * prof->rangecount);
+      double *seconds =
+        (double *) realloc (prof->rangeseconds, sizeof (double) * count);
+      unsigned long *calls = seconds == NULL ? NULL :
+        (unsigned long *) realloc (prof->rangecalls,
+                                   sizeof (unsigned long) * count);
+      if (calls == NULL)
+        {
+          Complain ("Runtime Error: Allocation failure in ProfileFiring.\n");
+          Fail (1);
+        }
+      memset (&(seconds[prof->rangecount]), 0,
+              sizeof (double) * (count - prof->rangecount));
+      memset (&(calls[prof->rangecount]), 0,
+              sizeof (unsigned long) * (count - prof->rangecount));
+      prof->rangeseconds = seconds;
+      prof->rangecalls = calls;
+      prof->rangecount = count;
+    }
+  prof->rangeseconds[range] += elapsed;
+  prof->rangecalls[range]++;
+}
+
+// write what has been counted since the last report to dest, headed by label, and start counting again.  Nothing is
+// written if net isn't being profiled, and the counts are dropped if dest is NULL.
+void
+ProfileReport (const struct nnet *net, FILE * dest, const char *label)
+{
+  assert (net != NULL);
+  struct profile *prof = net->profile;
+  if (prof == NULL)
+    return;
+  const double now = ProfileClock ();
+  if (dest != NULL)
+    {
+      fprintf (dest, "Profile (%s): %.6f s\n", label, now - prof->since);
+      for (int phase = 0; phase < PROF_PHASES; phase++)
+        if (prof->calls[phase] > 0)
+          fprintf (dest, "  %-20s %12.6f s %12lu calls\n", phasenames[phase],
+                   prof->seconds[phase], prof->calls[phase]);
+      for (int fchoice = 0; fchoice < OUTPUTCOUNT; fchoice++)
+        if (prof->transfercalls[fchoice] > 0)
+          fprintf (dest, "  transfer %-11s %12.6f s %12lu calls\n",
+                   outtokens[fchoice], prof->transferseconds[fchoice],
+                   prof->transfercalls[fchoice]);
+      for (unsigned int range = 0; range < prof->rangecount; range++)
+        if (prof->rangecalls[range] > 0)
+          {
+            char name[32];
+            snprintf (name, sizeof (name), "nodes %u-%u",
+                      range * prof->rangesize,
+                      (range + 1) * prof->rangesize - 1);
+            fprintf (dest, "  %-20s %12.6f s %12lu calls\n", name,
+                     prof->rangeseconds[range], prof->rangecalls[range]);
+          }
+      fflush (dest);
+    }
+  memset (prof->seconds, 0, sizeof (prof->seconds));
+  memset (prof->calls, 0, sizeof (prof->calls));
+  memset (prof->transferseconds, 0, sizeof (prof->transferseconds));
+  memset (prof->transfercalls, 0, sizeof (prof->transfercalls));
+  if (prof->rangecount > 0)
+    {
+      memset (prof->rangeseconds, 0, sizeof (double) * prof->rangecount);
+      memset (prof->rangecalls, 0, sizeof (unsigned long) * prof->rangecount);
+    }
+  prof->since = now;
+}
+
+void
+FreeProfile (struct profile *prof)
+{
+  if (prof == NULL)
+    return;
+  free (prof->rangeseconds);
+  free (prof->rangecalls);
+  free (prof);
+}
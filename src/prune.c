@@ -0,0 +1,185 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// magnitude pruning: removing the synapses of a trained network whose weights matter least.
+
+#include "includes.h"
+#include "defines.h"
+#include "prune.h"
+#include "fail.h"
+
+// whether a zero input leaves a node's accumulator unchanged, so a synapse into it with a near-zero weight is nearly a
+// no-op and may be removed.  Multiply and Max accumulators are changed by a zero, so synapses into them are kept.
+static int
+AbsorbsZero (int accum)
+{
+  return (accum != 2 && accum != 6);
+}
+
+// a synapse and the magnitude of its weight, sorted by ByMagnitude.
+struct ranked
+{
+  flotype magnitude;
+  unsigned int conn;
+};
+
+// order synapses by descending weight magnitude, ties in synapse order.
+static int
+ByMagnitude (const void *a, const void *b)
+{
+  const struct ranked *left = (const struct ranked *) a;
+  const struct ranked *right = (const struct ranked *) b;
+  if (left->magnitude != right->magnitude)
+    return (left->magnitude < right->magnitude ? 1 : -1);
+  return (left->conn < right->conn ? -1 : 1);
+}
+
+// mark the synapses that fail the pruning criteria: weight magnitude below threshold, or not among the keeptop largest
+// into their destination.  A zero threshold or keeptop disables that criterion.
+static void
+MarkCandidates (const struct nnet *net, flotype threshold,
+                unsigned int keeptop, unsigned char *candidate)
+{
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    candidate[conn] = AbsorbsZero (net->accum[net->dests[conn]])
+      && absolute (net->weights[conn]) < threshold;
+  if (keeptop == 0)
+    return;
+  unsigned int *first =
+    (unsigned int *) calloc (net->nodecount + 1, sizeof (unsigned int));
+  struct ranked *bydest =
+    (struct ranked *) malloc (sizeof (struct ranked) *
+                              (net->synapsecount + 1));
+  if (first == NULL || bydest == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in PruneNetwork.\n");
+      Fail (1);
+    }
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    first[net->dests[conn] + 1]++;
+  for (unsigned int node = 0; node < net->nodecount; node++)
+    first[node + 1] += first[node];
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      struct ranked *rk = &(bydest[first[net->dests[conn]]++]);
+      rk->magnitude = absolute (net->weights[conn]);
+      rk->conn = conn;
+    }
+  for (unsigned int node = 0, start = 0; node < net->nodecount; node++)
+    {                           // first[node] is now the end of node's run.
+      unsigned int end = first[node];
+      if (end - start > keeptop && AbsorbsZero (net->accum[node]))
+        {
+          qsort (&(bydest[start]), end - start, sizeof (struct ranked),
+                 ByMagnitude);
+          for (unsigned int index = start + keeptop; index < end; index++)
+            candidate[bydest[index].conn] = 1;
+        }
+      start = end;
+    }
+  free (bydest);
+  free (first);
+}
+
+// whether removing synapse conn would change when some node fires relative to the synapses into it.  Nodes fire
+// (their transfer functions run) in order, just before the first synapse whose source is at or past them, and a synapse
+// into a node that has already fired counts toward the next step.  If conn is what makes the nodes above lastsource
+// fire, removing it defers their firing to the next synapse that is surely kept and reaches as high; any synapse into
+// one of them in between would move from the next step to this one.
+static int
+MovesFiring (const struct nnet *net, const unsigned int *groupstart,
+             const unsigned char *candidate, unsigned int conn,
+             unsigned int lastsource)
+{
+  const unsigned int source = net->sources[conn];
+  if (groupstart[source] <= lastsource)
+    return (0);
+  for (unsigned int later = conn + 1; later < net->synapsecount; later++)
+    {
+      const unsigned int dest = groupstart[net->dests[later]];
+      if (dest > lastsource && dest <= source)
+        return (1);
+      if (!candidate[later] && net->sources[later] >= source)
+        return (0);
+    }
+  return (0);
+}
+
+// remove the synapses of net whose weights are smaller in magnitude than threshold, or that are not among the keeptop
+// largest into their destination (zero disables either test), compacting the synapse arrays in place.  Only synapses
+// whose removal does not change the network's firing sequence are removed, so the pruned network computes what the
+// original would with the removed weights set to zero.  Returns the number of synapses removed.
+unsigned int
+PruneNetwork (struct nnet *net, flotype threshold, unsigned int keeptop)
+{
+  assert (net != NULL);
+  if (net->synapsecount == 0 || (threshold <= ZERO && keeptop == 0))
+    return (0);
+  unsigned char *candidate = (unsigned char *) malloc (net->synapsecount);
+  unsigned int *groupstart =
+    (unsigned int *) malloc (sizeof (unsigned int) * net->nodecount);
+  if (candidate == NULL || groupstart == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in PruneNetwork.\n");
+      Fail (1);
+    }
+  groupstart[0] = 0;
+  for (unsigned int node = 1; node < net->nodecount;
+       node += net->transferwidths[node])
+    for (unsigned int unit = 0;
+         unit < net->transferwidths[node] && node + unit < net->nodecount;
+         unit++)
+      groupstart[node + unit] = node;
+  MarkCandidates (net, threshold, keeptop, candidate);
+  unsigned int kept = 0;
+  unsigned int lastsource = 0;  // highest group start fired by the synapses kept so far.
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      if (candidate[conn]
+          && !MovesFiring (net, groupstart, candidate, conn, lastsource))
+        continue;
+      lastsource = MAX (lastsource, groupstart[net->sources[conn]]);
+      net->weights[kept] = net->weights[conn];
+      net->sources[kept] = net->sources[conn];
+      net->dests[kept] = net->dests[conn];
+      kept++;
+    }
+  unsigned int removed = net->synapsecount - kept;
+  net->synapsecount = kept;
+  if (removed > 0 && kept > 0)
+    {                           // shrinking can't fail in practice; if it does the larger arrays are still good.
+      flotype *weights = realloc (net->weights, sizeof (flotype) * kept);
+      unsigned int *sources =
+        realloc (net->sources, sizeof (unsigned int) * kept);
+      unsigned int *dests = realloc (net->dests, sizeof (unsigned int) * kept);
+      net->weights = weights != NULL ? weights : net->weights;
+      net->sources = sources != NULL ? sources : net->sources;
+      net->dests = dests != NULL ? dests : net->dests;
+    }
+  if (removed > 0 && net->topology != NULL)
+    {                           // later stages read the summary, so it must describe the pruned synapses.
+      FreeTopology (net->topology);
+      net->topology = SummarizeTopology (net);
+    }
+  free (groupstart);
+  free (candidate);
+  return (removed);
+}
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// prunecheck: checks that pruning changes nothing but the synapses it removes.  Each of PRUNECHECK_NETWORKS random
+// recurrent networks, with wide transfers and every accumulator, is pruned by threshold, by KeepTop or by both; the
+// pruned and compacted network must then give bit-for-bit the same outputs, step after step, as the original with the
+// removed synapses' weights set to zero.  Run by 'make check'.
+
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "netbuilder.h"
+#include "feedforward.h"
+#include "prune.h"
+#include "testnet.h"
+
+#define PRUNECHECK_NETWORKS 400
+#define PRUNECHECK_STEPS    6
+
+// the synapses of the networks checked so far, before and after pruning.
+struct prunetally
+{
+  unsigned long before;
+  unsigned long after;
+};
+
+// a network of up to three inputs, up to eight hidden groups (single nodes, or two to four nodes under a wide transfer)
+// and up to two outputs, with three synapses per node joining random nodes, a third of them with tiny weights.
+static void
+RandomNetwork (struct nnet *net)
+{
+  static const int transfers[] = { 1, 2, 3, 5, 14, 15 };
+  struct netbuilder *nb = StartNetBuilder (net);
+  unsigned int inputs = 1 + random () % 3;
+  int groups = 1 + random () % 8;
+  int outputs = 1 + random () % 2;
+  BuildNodes (nb, GROUP_INPUT, inputs, 0, 1, 1);
+  for (int group = 0; group < groups; group++)
+    {
+      int transfer = transfers[random () % 6];
+      int width = transfer >= 14 ? 2 + random () % 3 : 1;
+      BuildNodes (nb, GROUP_HIDDEN, width, transfer, random () % 8, width);
+    }
+  BuildNodes (nb, GROUP_OUTPUT, outputs, 1, 1, 1);
+  RandomSynapses (nb, inputs + 1, 3 * net->nodecount, 1.0, 3);
+  FinishNetBuilder (nb);
+}
+
+// prune a copy of a random network and compare it with the original, adding the synapses before and after pruning to
+// the prunetally.  Returns 1 if they differ.
+static int
+CheckNetwork (int network, void *arg)
+{
+  struct prunetally *tally = (struct prunetally *) arg;
+  struct nnet original;
+  struct nnet pruned;
+  int differs = 0;
+  memset (&original, 0, sizeof (struct nnet));
+  RandomNetwork (&original);
+  CopyNetwork (&pruned, &original);
+  PruneNetwork (&pruned, network % 3 == 2 ? ZERO : network % 2 ? 0.05 : 0.3,
+                network % 3 == 0 ? 0 : 2);
+  tally->before += original.synapsecount;
+  tally->after += pruned.synapsecount;
+  // the kept synapses must be an ordered subsequence of the original ones; zero the weights of the rest.
+  unsigned int kept = 0;
+  for (unsigned int synapse = 0; synapse < original.synapsecount; synapse++)
+    if (kept < pruned.synapsecount
+        && pruned.sources[kept] == original.sources[synapse]
+        && pruned.dests[kept] == original.dests[synapse]
+        && pruned.weights[kept] == original.weights[synapse])
+      kept++;
+    else
+      original.weights[synapse] = ZERO;
+  if (kept != pruned.synapsecount)
+    {
+      printf ("prunecheck: network %d: pruning reordered or changed synapses\n",
+              network);
+      differs = 1;
+    }
+  sigtype *acts = malloc (sizeof (sigtype) * original.nodecount);
+  sigtype *prunedacts = malloc (sizeof (sigtype) * original.nodecount);
+  flotype *outs = malloc (sizeof (flotype) * (original.outputcount + 1));
+  flotype *prunedouts =
+    malloc (sizeof (flotype) * (original.outputcount + 1));
+  flotype *history = malloc (sizeof (flotype) * original.nodecount);
+  flotype inputs[3];
+  if (acts == NULL || prunedacts == NULL || outs == NULL
+      || prunedouts == NULL || history == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in CheckNetwork.\n");
+      exit (1);
+    }
+  init_activations (&original, acts);
+  init_activations (&pruned, prunedacts);
+  for (int step = 0; !differs && step < PRUNECHECK_STEPS; step++)
+    {
+      for (unsigned int in = 0; in < original.inputcount; in++)
+        inputs[in] = Uniform (-1.0, 1.0);
+      fwdprop (&original, inputs, acts, history, outs);
+      fwdprop (&pruned, inputs, prunedacts, history, prunedouts);
+      for (unsigned int out = 0; out < original.outputcount; out++)
+        if (memcmp (&(outs[out]), &(prunedouts[out]), sizeof (flotype)) != 0
+            && !(isnan (outs[out]) && isnan (prunedouts[out])))
+          {
+            printf ("prunecheck: network %d step %d output %u: %.17g, %.17g pruned\n",
+                    network, step, out, (double) outs[out],
+                    (double) prunedouts[out]);
+            differs = 1;
+            break;
+          }
+    }
+  free (acts);
+  free (prunedacts);
+  free (outs);
+  free (prunedouts);
+  free (history);
+  FreeNetwork (&original);
+  FreeNetwork (&pruned);
+  return (differs);
+}
+
+int
+main (void)
+{
+  struct prunetally tally = { 0, 0 };
+  int differing = CheckNetworks (PRUNECHECK_NETWORKS, CheckNetwork, &tally);
+  printf ("prunecheck (" FLOTYPE_NAME
+          "): %d networks, %lu of %lu synapses pruned, %d differ\n",
+          PRUNECHECK_NETWORKS, tally.before - tally.after, tally.before,
+          differing);
+  return (differing != 0);
+}
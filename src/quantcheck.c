@@ -0,0 +1,165 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// quantcheck: measures how far int8 quantization moves a network's outputs.  Each of QUANTCHECK_NETWORKS random layered
+// networks is calibrated and quantized as a Deployment plan with Quantize does it, over QUANTCHECK_CASES random cases,
+// and the RMS difference of its quantized outputs from its float outputs over those cases must stay within
+// QUANTCHECK_TOLERANCE of the RMS of the float outputs.  Run by 'make check'.
+
+#include "includes.h"
+#include "defines.h"
+#include "network.h"
+#include "netbuilder.h"
+#include "feedforward.h"
+#include "quantize.h"
+#include "testnet.h"
+
+#define QUANTCHECK_NETWORKS  100
+#define QUANTCHECK_CASES     256
+// each int8 weight is within half a step of 1/127 of the largest weight into its node, a few tenths of a percent of
+// each sum; the error grows through up to three layers and is multiplied in layers that multiply.
+#define QUANTCHECK_TOLERANCE 0.05
+
+// what the networks checked so far have found.
+struct quanttally
+{
+  unsigned long synapses;
+  unsigned long integer;        // synapses quantized to int8.
+  double worst;                 // worst RMS difference, relative to the float outputs.
+};
+
+// a network of up to eight inputs, one to three hidden layers of 4 to 32 nodes and up to three outputs, each layer fully
+// connected to the one before it and to the bias.  One hidden layer in six multiplies, and a few synapses run back to
+// an earlier layer, so that some synapses stay float.
+static void
+RandomNetwork (struct nnet *net)
+{
+  static const int transfers[] = { 0, 1, 2, 3, 5, 8 };
+  struct netbuilder *nb = StartNetBuilder (net);
+  int inputs = 1 + random () % 8;
+  int layers = 1 + random () % 3;
+  int outputs = 1 + random () % 3;
+  int first[4];
+  int width[4];
+  int layer;
+  first[0] = BuildNodes (nb, GROUP_INPUT, inputs, 0, 1, 1);
+  width[0] = inputs;
+  for (layer = 1; layer <= layers; layer++)
+    {
+      width[layer] = 4 + random () % 29;
+      first[layer] = BuildNodes (nb, GROUP_HIDDEN, width[layer],
+                                 transfers[random () % 6],
+                                 random () % 6 == 0 ? 2 : 1, 1);
+    }
+  int output = BuildNodes (nb, GROUP_OUTPUT, outputs, 0, 1, 1);
+  for (layer = 1; layer <= layers; layer++)
+    {
+      ConnectLayers (nb, 0, 1, first[layer], width[layer], 2.0);
+      ConnectLayers (nb, first[layer - 1], width[layer - 1], first[layer],
+                     width[layer], 2.0);
+    }
+  ConnectLayers (nb, 0, 1, output, outputs, 2.0);
+  ConnectLayers (nb, first[layers], width[layers], output, outputs, 2.0);
+  for (int back = random () % 4; back > 0; back--)
+    {
+      flotype weight = Uniform (-0.5, 0.5);
+      int from = output + random () % outputs;
+      layer = 1 + random () % layers;
+      int to = first[layer] + random () % width[layer];
+      BuildConnections (nb, from, from, to, to, &weight, 1);
+    }
+  FinishNetBuilder (nb);
+}
+
+// quantize a random network and find the RMS difference of its quantized outputs from its float outputs, relative to
+// the RMS of its float outputs, adding what it finds to the quanttally.  Returns 1 if the difference is over
+// QUANTCHECK_TOLERANCE.
+static int
+CheckNetwork (int network, void *arg)
+{
+  struct quanttally *tally = (struct quanttally *) arg;
+  struct nnet net;
+  memset (&net, 0, sizeof (struct nnet));
+  RandomNetwork (&net);
+  size_t cases = QUANTCHECK_CASES;
+  flotype *ins = malloc (sizeof (flotype) * (net.inputcount + 1) * cases);
+  flotype *outs = malloc (sizeof (flotype) * (net.outputcount + 1) * cases);
+  flotype *qouts =
+    malloc (sizeof (flotype) * (net.outputcount + 1) * cases);
+  flotype *history = malloc (sizeof (flotype) * net.nodecount * cases);
+  flotype *maxout = calloc (net.nodecount, sizeof (flotype));
+  sigtype *acts = malloc (sizeof (sigtype) * net.nodecount * cases);
+  if (ins == NULL || outs == NULL || qouts == NULL || history == NULL
+      || maxout == NULL || acts == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in CheckNetwork.\n");
+      exit (1);
+    }
+  for (size_t in = 0; in < net.inputcount * cases; in++)
+    ins[in] = Uniform (-1.0, 1.0);
+  init_activations_batch (&net, acts, cases);
+  fwdprop_batch (&net, cases, ins, acts, history, outs);
+  for (size_t node = 0; node < net.nodecount; node++)
+    for (size_t b = 0; b < cases; b++)
+      maxout[node] = MAX (maxout[node], absolute (history[node * cases + b]));
+  struct quantized *qn = QuantizeNetwork (&net, maxout);
+  net.quantized = qn;
+  init_activations_batch (&net, acts, cases);
+  fwdprop_batch (&net, cases, ins, acts, history, qouts);
+  net.quantized = NULL;
+  double sqdiff = 0.0;
+  double sqout = 0.0;
+  for (size_t out = 0; out < net.outputcount * cases; out++)
+    {
+      double diff = (double) qouts[out] - (double) outs[out];
+      sqdiff += diff * diff;
+      sqout += (double) outs[out] * (double) outs[out];
+    }
+  double difference = sqout > 0.0 ? sqrt (sqdiff / sqout) : sqrt (sqdiff);
+  tally->synapses += net.synapsecount;
+  tally->integer += qn->intsynapses;
+  if (!(difference <= tally->worst))
+    tally->worst = difference;
+  FreeQuantized (qn);
+  free (ins);
+  free (outs);
+  free (qouts);
+  free (history);
+  free (maxout);
+  free (acts);
+  FreeNetwork (&net);
+  if (difference <= QUANTCHECK_TOLERANCE)
+    return (0);
+  printf ("quantcheck: network %d: RMS difference %.3g of the float outputs\n",
+          network, difference);
+  return (1);
+}
+
+int
+main (void)
+{
+  struct quanttally tally = { 0, 0, 0.0 };
+  int failing = CheckNetworks (QUANTCHECK_NETWORKS, CheckNetwork, &tally);
+  printf ("quantcheck (" FLOTYPE_NAME
+          "): %d networks, %lu of %lu synapses int8, worst RMS difference %.3g of the float outputs, %d over %g\n",
+          QUANTCHECK_NETWORKS, tally.integer, tally.synapses, tally.worst,
+          failing, QUANTCHECK_TOLERANCE);
+  return (failing != 0);
+}
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// int8 quantization of network weights for deployment.
+
+#include "includes.h"
+#include "defines.h"
+#include "quantize.h"
+#include "fail.h"
+
+// quantize net's weights, given the largest magnitude each node's output reached over a set of calibration cases
+// (maxout[node]).  Integer synapses are those into Add nodes that have not fired yet when the synapse is applied, up
+// to QUANT_FANIN_MAX into each node; the rest stay float.  Node outputs are scaled so the largest calibration output
+// is QUANT_ACTIVITY_MAX steps, and each node's integer synapse weights so the largest is QUANT_WEIGHT_MAX steps.
+struct quantized *
+QuantizeNetwork (const struct nnet *net, const flotype * maxout)
+{
+  assert (net != NULL);
+  assert (maxout != NULL);
+  struct quantized *qn =
+    (struct quantized *) calloc (1, sizeof (struct quantized));
+  unsigned int *fanin =
+    (unsigned int *) calloc (net->nodecount, sizeof (unsigned int));
+  unsigned int *groupstart =
+    (unsigned int *) malloc (sizeof (unsigned int) * net->nodecount);
+  if (qn != NULL && fanin != NULL && groupstart != NULL)
+    {
+      qn->weights = (int8_t *) calloc (net->synapsecount + 1, 1);
+      qn->integer = (unsigned char *) calloc (net->synapsecount + 1, 1);
+      qn->quantizes = (unsigned char *) calloc (net->nodecount, 1);
+      qn->accumulates = (unsigned char *) calloc (net->nodecount, 1);
+      qn->actscale = (flotype *) malloc (sizeof (flotype) * net->nodecount);
+      qn->destscale = (flotype *) malloc (sizeof (flotype) * net->nodecount);
+    }
+  if (qn == NULL || fanin == NULL || groupstart == NULL
+      || qn->weights == NULL || qn->integer == NULL
+      || qn->quantizes == NULL || qn->accumulates == NULL
+      || qn->actscale == NULL || qn->destscale == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in QuantizeNetwork.\n");
+      Fail (1);
+    }
+  qn->net = net;
+  groupstart[0] = 0;
+  for (unsigned int node = 1; node < net->nodecount;
+       node += net->transferwidths[node])
+    for (unsigned int unit = 0;
+         unit < net->transferwidths[node] && node + unit < net->nodecount;
+         unit++)
+      groupstart[node + unit] = node;
+  for (unsigned int node = 0; node < net->nodecount; node++)
+    {
+      qn->actscale[node] = (node == 0 ? ONE : maxout[node]) / QUANT_ACTIVITY_MAX;
+      if (!(qn->actscale[node] > ZERO) || isinf (qn->actscale[node]))
+        qn->actscale[node] = ONE / QUANT_ACTIVITY_MAX;  // silent or unbounded nodes.
+      qn->destscale[node] = ZERO;
+    }
+  // choose the integer synapses, and find the largest magnitude each node's integer synapses bring it.
+  unsigned int fired = 0;       // nodes with group starts up to this one have fired.
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    {
+      const unsigned int source = net->sources[conn];
+      const unsigned int dest = net->dests[conn];
+      fired = MAX (fired, groupstart[source]);
+      if (net->accum[dest] != 1 || groupstart[dest] <= fired
+          || fanin[dest] >= QUANT_FANIN_MAX)
+        continue;
+      const flotype reach = absolute (net->weights[conn]) * qn->actscale[source];
+      if (isinf (reach) || isnan (reach))
+        continue;
+      fanin[dest]++;
+      qn->integer[conn] = 1;
+      qn->quantizes[source] = 1;
+      qn->accumulates[dest] = 1;
+      qn->destscale[dest] = MAX (qn->destscale[dest], reach);
+      qn->intsynapses++;
+    }
+  for (unsigned int node = 0; node < net->nodecount; node++)
+    qn->destscale[node] = qn->destscale[node] > ZERO ?
+      qn->destscale[node] / QUANT_WEIGHT_MAX : ONE;
+  for (unsigned int conn = 0; conn < net->synapsecount; conn++)
+    if (qn->integer[conn])
+      {
+        const flotype steps = net->weights[conn] *
+          qn->actscale[net->sources[conn]] / qn->destscale[net->dests[conn]];
+        qn->weights[conn] =
+          (int8_t) lrint (MAX (-QUANT_WEIGHT_MAX,
+                               MIN (QUANT_WEIGHT_MAX, steps)));
+      }
+  free (groupstart);
+  free (fanin);
+  return (qn);
+}
+
+// make room in qn's scratch space for batches of lanes cases.  The space only grows, so a deployment allocates it for
+// its largest batch and then runs every batch without allocating.
+void
+ReserveQuantized (struct quantized *qn, size_t lanes)
+{
+  assert (qn != NULL);
+  if (lanes <= qn->lanes)
+    return;
+  size_t count = (size_t) qn->net->nodecount * lanes;
+  free (qn->res);
+  free (qn->qres);
+  free (qn->acc);
+  qn->res = (flotype *) malloc (sizeof (flotype) * count);
+  qn->qres = (int16_t *) malloc (sizeof (int16_t) * count);
+  qn->acc = (int32_t *) calloc (count, sizeof (int32_t));
+  if (qn->res == NULL || qn->qres == NULL || qn->acc == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in ReserveQuantized.\n");
+      Fail (1);
+    }
+  qn->lanes = lanes;
+}
+
+void
+FreeQuantized (struct quantized *qn)
+{
+  if (qn == NULL)
+    return;
+  free (qn->res);
+  free (qn->qres);
+  free (qn->acc);
+  free (qn->weights);
+  free (qn->integer);
+  free (qn->quantizes);
+  free (qn->accumulates);
+  free (qn->actscale);
+  free (qn->destscale);
+  free (qn);
+}
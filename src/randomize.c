@@ -35,15 +35,17 @@ randomize (network * nn, network_config * config)
     for (i = 0; i < nn->neurons[n].num_input; i++)
       {
         nn->neurons[n].w[i] =
-          config->wmin + rnd () * (config->wmax - config->wmin);
+          config->wmin + rnd (config) * (config->wmax - config->wmin);
       }
 }
 
-// returns a random float (using random()) between min and max.
+// returns a random float between min and max, advancing the generator *state.  Each caller keeps a state of its own,
+// started at RANDOMFLOAT_SEED, so that networks built side by side draw from sequences of their own.
 double
-randomfloat (const double min, const double max)
+randomfloat (uint64_t * state, const double min, const double max)
 {
   if (max < min)
-    return randomfloat (max, min);
-  return (min + ((double) random () / RAND_MAX) * (max - min));
+    return randomfloat (state, max, min);
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (min + ((double) (*state >> 11) / 9007199254740992.0) * (max - min));
 }
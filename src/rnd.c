@@ -23,12 +23,19 @@
 #include "includes.h"
 #include "rnd.h"
 
+// the sequence is kept in the config, so networks trained side by side draw from sequences of their own.
 inline double
-rnd (void)
+rnd (network_config * config)
 {
-  static int ISEED = 38467.;
+  config->rndstate = fmod (1027. * config->rndstate, 1048576.);
 
-  ISEED = fmod (1027. * ISEED, 1048576.);
+  return config->rndstate / 1048576.;
+}
 
-  return ISEED / 1048576.;
+// restart the sequence rnd() returns; each seed gives a different sequence.  Seeds step by two from the default so the
+// state stays odd, as an even state would shorten the period.
+void
+srnd (network_config * config, unsigned int seed)
+{
+  config->rndstate = (RND_SEED + 2 * (seed % 524288)) % 1048576;
 }
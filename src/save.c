@@ -22,6 +22,8 @@
 #include "save.h"
 #include "feedforward.h"
 #include "parser.h"             // for acctokens and outtokens
+#include "weightfile.h"
+#include "fail.h"
 
 void
 network_save (network * nn, network_config * config)
@@ -35,7 +37,7 @@ network_save (network * nn, network_config * config)
   if (fp == NULL)
     {
       printf ("cannot save file %s!\n", config->save_network_file_name);
-      exit (-1);
+      Fail (-1);
     }
 
   // saves the description of every single neuron
@@ -104,7 +106,7 @@ network_save_final_curve (network * nn, network_config * config)
   if (fp == NULL)
     {
       printf ("cannot save file %s!\n", config->output_file_name);
-      exit (-1);
+      Fail (-1);
     }
 
   for (n = 0; n < config->num_of_cases; n++)
@@ -143,31 +145,216 @@ network_save_final_curve (network * nn, network_config * config)
 static const char *acctokens[ACCUMCOUNT] = { ACCTOKENS };
 static const char *outtokens[OUTPUTCOUNT] = { OUTTOKENS };
 
+// values per chunk when nnetwriter formats long weight lists and data sets in parallel.
+#define SAVE_CHUNK 4096
+// A growable text buffer, so that long sections are formatted in memory and written with one fwrite.
+struct textbuf
+{
+  char *text;
+  size_t len;
+  size_t cap;
+};
+
+static void
+TbReserve (struct textbuf *tb, size_t more)
+{
+  if (tb->len + more <= tb->cap)
+    return;
+  tb->cap = MAX (2 * tb->cap, tb->len + more + 4096);
+  tb->text = (char *) realloc (tb->text, tb->cap);
+  if (tb->text == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in TbReserve.\n");
+      Fail (1);
+    }
+}
+
+static void
+TbPutStr (struct textbuf *tb, const char *str)
+{
+  size_t len = strlen (str);
+  TbReserve (tb, len);
+  memcpy (&(tb->text[tb->len]), str, len);
+  tb->len += len;
+}
+
+// Lay out the first count of digits (value digits[0].digits[1]... times 10^exp10) in the form the nnet parser requires:
+// digits on both sides of a decimal point, then an optional exponent.  Returns the length.
+static int
+LayOutDigits (char *dst, int negative, const char *digits, int count,
+              int exp10)
+{
+  int len = 0;
+  if (negative)
+    dst[len++] = '-';
+  if (exp10 < -4 || exp10 >= FLOTYPE_DECIMAL_DIG)
+    {
+      dst[len++] = digits[0];
+      dst[len++] = '.';
+      if (count == 1)
+        dst[len++] = '0';
+      for (int i = 1; i < count; i++)
+        dst[len++] = digits[i];
+      len += sprintf (&(dst[len]), "e%+03d", exp10);
+      return (len);
+    }
+  if (exp10 < 0)
+    {
+      dst[len++] = '0';
+      dst[len++] = '.';
+      for (int i = -1; i > exp10; i--)
+        dst[len++] = '0';
+      for (int i = 0; i < count; i++)
+        dst[len++] = digits[i];
+    }
+  else
+    {
+      for (int i = 0; i <= exp10; i++)
+        dst[len++] = i < count ? digits[i] : '0';
+      dst[len++] = '.';
+      if (count <= exp10 + 1)
+        dst[len++] = '0';
+      for (int i = exp10 + 1; i < count; i++)
+        dst[len++] = digits[i];
+    }
+  dst[len] = 0;
+  return (len);
+}
+
+// Round the digits of a "d.ddd...e+xx" mantissa to count digits, upward or not, into digits and lay them out in dst.
+static int
+RoundDigits (char *dst, int negative, const char *mantissa, int exp10,
+             int count, int up)
+{
+  char digits[FLOTYPE_DECIMAL_DIG];
+  digits[0] = mantissa[0];
+  memcpy (&(digits[1]), &(mantissa[2]), count - 1);
+  if (up)
+    {
+      int i = count - 1;
+      while (i >= 0 && digits[i] == '9')
+        digits[i--] = '0';
+      if (i >= 0)
+        digits[i]++;
+      else
+        {
+          digits[0] = '1';      // 9.99... rounded up to 10.
+          exp10++;
+        }
+    }
+  while (count > 1 && digits[count - 1] == '0')
+    count--;
+  return (LayOutDigits (dst, negative, digits, count, exp10));
+}
+
+// Print v with the fewest significant digits that read back as exactly v.  The full FLOTYPE_DECIMAL_DIG digits are
+// printed once, and shorter roundings of them are tried from FLOTYPE_DIG digits up (any decimal that short which reads
+// back as v is such a rounding); a trailing 5 may itself have been rounded up, so both neighbors are tried then.  dst
+// must have room for FLOTEXTMAX characters.  Returns the length printed.
+static int
+FormatFlo (char *dst, flotype v)
+{
+  char full[FLOTEXTMAX];
+  int len;
+  if (!isfinite (v))
+    return (snprintf (dst, FLOTEXTMAX, "%g", (double) v));
+  snprintf (full, FLOTEXTMAX, "%.*e", FLOTYPE_DECIMAL_DIG - 1, (double) v);
+  int negative = full[0] == '-';
+  const char *mantissa = &(full[negative]);
+  int exp10 = atoi (&(mantissa[FLOTYPE_DECIMAL_DIG + 2]));
+  // subnormals carry fewer digits than FLOTYPE_DIG.
+  int count = fabs (v) < FLOTYPE_MIN ? 1 : FLOTYPE_DIG;
+  for (; count < FLOTYPE_DECIMAL_DIG; count++)
+    {
+      char next = mantissa[count + 1];  // the first digit dropped.
+      len = RoundDigits (dst, negative, mantissa, exp10, count, next >= '5');
+      if ((flotype) strtod (dst, NULL) == v)
+        return (len);
+      if (next != '5')
+        continue;
+      len = RoundDigits (dst, negative, mantissa, exp10, count, 0);
+      if ((flotype) strtod (dst, NULL) == v)
+        return (len);
+    }
+  return (RoundDigits (dst, negative, mantissa, exp10, count, 0));
+}
+
+static void
+TbPutFlo (struct textbuf *tb, flotype v)
+{
+  TbReserve (tb, FLOTEXTMAX);
+  tb->len += FormatFlo (&(tb->text[tb->len]), v);
+}
+
+// for single values in fprintf-built lines.  buf must have room for FLOTEXTMAX characters.
+const char *
+FloText (char *buf, flotype v)
+{
+  FormatFlo (buf, v);
+  return (buf);
+}
+
+// A formatter appends item number index of whatever ctx points to onto tb.
+typedef void (*itemformatter) (struct textbuf *, const void *, size_t);
+
+// Format count items and write them to out.  Long runs are split into chunks of SAVE_CHUNK items that the OpenMP threads
+// format concurrently; the chunks are then written in order.
+static void
+WriteItems (FILE * out, size_t count, itemformatter fmt, const void *ctx)
+{
+  size_t chunks = (count + SAVE_CHUNK - 1) / SAVE_CHUNK;
+  struct textbuf *bufs =
+    (struct textbuf *) calloc (chunks + 1, sizeof (struct textbuf));
+  if (bufs == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in WriteItems.\n");
+      Fail (1);
+    }
+#pragma omp parallel for schedule(dynamic) if (chunks > 1)
+  for (size_t chunk = 0; chunk < chunks; chunk++)
+    for (size_t item = chunk * SAVE_CHUNK;
+         item < count && item < (chunk + 1) * SAVE_CHUNK; item++)
+      fmt (&(bufs[chunk]), ctx, item);
+  for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+      fwrite (bufs[chunk].text, 1, bufs[chunk].len, out);
+      free (bufs[chunk].text);
+    }
+  free (bufs);
+}
+
+static void
+FormatWeight (struct textbuf *tb, const void *ctx, size_t index)
+{
+  TbPutFlo (tb, ((const flotype *) ctx)[index]);
+  TbPutStr (tb, " ");
+}
+
+static void
+FormatCase (struct textbuf *tb, const void *ctx, size_t entry)
+{
+  const struct cases *current = (const struct cases *) ctx;
+  size_t casesize = current->inputcount + current->outputcount;
+  int bracecontrol = MIN (current->inputcount, current->outputcount);
+  const flotype *row = &(current->data[entry * casesize]);
+  TbPutStr (tb, bracecontrol ? "\n        [[" : "\n        [");
+  for (size_t datum = 0; datum < casesize; datum++)
+    {
+      if (bracecontrol && datum == current->inputcount)
+        TbPutStr (tb, "][");
+      TbPutFlo (tb, row[datum]);
+      TbPutStr (tb, " ");
+    }
+  TbPutStr (tb, bracecontrol ? "]]" : "]");
+}
+
 void
 WriteImmediateCases (FILE * out, const struct cases *current)
 {
   assert (current != NULL);
   assert (out != NULL);
-  int entry;
-  int datum;
-  int casesize = current->inputcount + current->outputcount;
-  int bracecontrol = MIN (current->inputcount, current->outputcount);
-  assert (casesize > 0);
-  for (entry = 0; entry < current->entrycount; entry++)
-    {
-      fprintf (out, "\n        [");
-      if (bracecontrol)
-        fprintf (out, "[");
-      for (datum = 0; datum < current->inputcount; datum++)
-        fprintf (out, FLOFMT " ", current->data[entry * casesize + datum]);
-      if (bracecontrol)
-        fprintf (out, "][");
-      for (datum = current->inputcount; datum < casesize; datum++)
-        fprintf (out, FLOFMT " ", current->data[entry * casesize + datum]);
-      fprintf (out, "]");
-      if (bracecontrol)
-        fprintf (out, "]");
-    }
+  assert (current->inputcount + current->outputcount > 0);
+  WriteItems (out, current->entrycount, FormatCase, current);
 }
 
 
@@ -181,6 +368,7 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
   assert (net != NULL);
   assert (out != NULL);
   int start, end, width, acc, xfer;
+  char flo[FLOTEXTMAX];
   struct cases *currentcase;
   struct plans *currentplan;
   uint32_t currentmask;
@@ -189,9 +377,11 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
   if (net->plan != NULL)
     {
       fprintf (out, "StartPlan\n");
-      for (currentplan = net->plan; currentplan != NULL;
-           currentplan = currentplan->next)
+      size_t plancount;
+      struct plans **planorder = PlansInOrder (net->plan, &plancount);
+      for (size_t index = 0; index < plancount; index++)
         {
+          currentplan = planorder[index];
           if (0 != (currentplan->planflags & PLAN_TRAIN))
             {
               fprintf (out, "    TrainingPlan(");
@@ -199,23 +389,39 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
                 fprintf (out, "GradientDescent ");
               else
                 {
-                  fprintf (stderr,
-                           "Program Error: Unhandled case(1) in nnetwriter.\n");
-                  exit (1);
+                  Complain
+                    ("Program Error: Unhandled case(1) in nnetwriter.\n");
+                  Fail (1);
                 }
               if (currentplan->goal != PLAN_DEFAULT_GOAL)
-                fprintf (out, "TrainingGoal " FLOFMT " ", currentplan->goal);
+                fprintf (out, "TrainingGoal %s ",
+                         FloText (flo, currentplan->goal));
               if (currentplan->trainrate != PLAN_DEFAULT_RATE)
-                fprintf (out, "LearningRate " FLOFMT " ",
-                         currentplan->trainrate);
+                fprintf (out, "LearningRate %s ",
+                         FloText (flo, currentplan->trainrate));
               if (currentplan->batchsize != 1)
                 fprintf (out, "BatchSize %d ", currentplan->batchsize);
+              if (currentplan->epochsize != PLAN_DEFAULT_EPOCHS)
+                fprintf (out, "EpochSize %d ", currentplan->epochsize);
+              if (currentplan->window != PLAN_DEFAULT_WINDOW)
+                fprintf (out, "Window %d ", currentplan->window);
+              if (currentplan->storeevery != 0)
+                fprintf (out, "StoreEvery %d ", currentplan->storeevery);
+              if (currentplan->pruneevery != 0)
+                fprintf (out, "PruneEvery %d ", currentplan->pruneevery);
+              if (currentplan->prunebelow != ZERO)
+                fprintf (out, "PruneBelow %s ",
+                         FloText (flo, currentplan->prunebelow));
+              if (currentplan->keeptop != 0)
+                fprintf (out, "KeepTop %d ", currentplan->keeptop);
               if (currentplan->epochmin != 0)
-                fprintf (out, "EpochMin %d ", currentplan->epochmin);
+                fprintf (out, "MinEpoch %d ", currentplan->epochmin);
               if (currentplan->epochmax != PLAN_DEFAULT_MAXEP)
-                fprintf (out, "EpochMax %d ", currentplan->epochmax);
+                fprintf (out, "MaxEpoch %d ", currentplan->epochmax);
               if (currentplan->reportdest != NULL)
                 fprintf (out, "ReportTo \"%s\" ", currentplan->reportdest);
+              if (currentplan->planflags & PLAN_PRECISION_FAST)
+                fprintf (out, "Precision Fast ");
               fprintf (out, ")\n");
             }
           else if (0 != (currentplan->planflags & PLAN_TEST))
@@ -223,11 +429,27 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
               fprintf (out, "    TestingPlan(");
               if (currentplan->reportdest != NULL)
                 fprintf (out, "ReportTo \"%s\" ", currentplan->reportdest);
+              if (currentplan->planflags & PLAN_PRECISION_FAST)
+                fprintf (out, "Precision Fast ");
               fprintf (out, ")\n");
             }
           else if (0 != (currentplan->planflags & PLAN_VALIDATE))
             {
               fprintf (out, "    ValidationPlan(");
+              if (currentplan->reportdest != NULL)
+                fprintf (out, "ReportTo \"%s\" ", currentplan->reportdest);
+              if (currentplan->planflags & PLAN_PRECISION_FAST)
+                fprintf (out, "Precision Fast ");
+              fprintf (out, ")\n");
+            }
+          else if (0 != (currentplan->planflags & PLAN_PRUNE))
+            {
+              fprintf (out, "    PruningPlan(");
+              if (currentplan->prunebelow != ZERO)
+                fprintf (out, "PruneBelow %s ",
+                         FloText (flo, currentplan->prunebelow));
+              if (currentplan->keeptop != 0)
+                fprintf (out, "KeepTop %d ", currentplan->keeptop);
               if (currentplan->reportdest != NULL)
                 fprintf (out, "ReportTo \"%s\" ", currentplan->reportdest);
               fprintf (out, ")\n");
@@ -237,15 +459,23 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
               fprintf (out, "    DeploymentPlan(");
               if (currentplan->reportdest != NULL)
                 fprintf (out, "ReportTo \"%s\" ", currentplan->reportdest);
+              if (currentplan->planflags & PLAN_PRECISION_FAST)
+                fprintf (out, "Precision Fast ");
+              if (currentplan->batchsize != 0)
+                fprintf (out, "BatchSize %d ", currentplan->batchsize);
+              if (currentplan->latency != PLAN_DEFAULT_LATENCY)
+                fprintf (out, "LatencyWindow %d ", currentplan->latency);
+              if (currentplan->planflags & PLAN_QUANTIZE)
+                fprintf (out, "Quantize ");
               fprintf (out, ")\n");
             }
           else
             {
-              fprintf (stderr,
-                       "Program Error: Unhandled case(1) in nnetwriter.\n");
-              exit (1);
+              Complain ("Program Error: Unhandled case(1) in nnetwriter.\n");
+              Fail (1);
             }
         }
+      free (planorder);
       fprintf (out, "EndPlan\n");
     }
 
@@ -254,7 +484,7 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
      SILENCE_OUTPUT | SILENCE_NODEINPUT | SILENCE_NODEOUTPUT |
      SILENCE_MULTIACTIVATION | SILENCE_RECURRENCE | SILENCE_RENUMBER);
   if ((config->flags & currentmask) != 0
-      || (config->flags & SAVE_DEFAULT) != 0)
+      || (config->flags & SAVE_DEFAULT) == 0)
     {
       fprintf (out, "StartConfig\n");
       if ((config->flags & currentmask) != 0)
@@ -287,6 +517,8 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
           fprintf (out, "    Save(\"%s\"", config->savename);
           if ((config->flags & SAVE_SERIALIZE) != 0)
             fprintf (out, " Serialize");
+          if ((config->flags & SAVE_WEIGHTFILE) != 0)
+            fprintf (out, " WeightFile");
           if (config->savecount != 0)
             fprintf (out, " %d", config->savecount);
           fprintf (out, ")\n");
@@ -353,11 +585,16 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
   if (net->synapsecount != 0)
     {
       fprintf (out, "StartConnections\n");
+      if (config->weightname != NULL)
+        {                       // weight n of the file is the weight of synapse n.
+          WriteWeightFile (net, config->weightname);
+          fprintf (out, "    WeightFile(\"%s\")\n", config->weightname);
+        }
       // The logic in this while/switch construction is excessively intricate. Be careful and test a lot if you need to screw with it. - RD
-      int state, backtrack, conn, firstfrom, firstto, lastfrom, lastto, nex;
-      start = end = conn = firstfrom = firstto = lastfrom = lastto =
-        nex = 0;
-      state = conn >= net->synapsecount ? 4 : 0;
+      int backtrack = 0, conn = 0, firstfrom = 0, firstto = 0, lastfrom = 0,
+        lastto = 0, nex = 0;
+      int state = net->synapsecount == 0 ? 4 : 0;
+      start = end = 0;
       while (state != 4)
         switch (state)
           {
@@ -455,24 +692,25 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
               fprintf (out, "%d ", firstto);
             else
               fprintf (out, "{%d %d} ", firstto, lastto);
-            if (start != end)
+            if (config->weightname != NULL)
+              fprintf (out, "FromWeightFile %d)\n", start);
+            else if (start != end)
               {
                 fprintf (out, "[");
-                for (nex = start; nex <= end; nex++)
-                  fprintf (out, FLOFMT " ", net->weights[nex]);
+                WriteItems (out, 1 + end - start, FormatWeight,
+                            &(net->weights[start]));
                 fprintf (out, "])\n");
               }
             else
-              fprintf (out, FLOFMT "\n", net->weights[start]);
+              fprintf (out, "%s)\n", FloText (flo, net->weights[start]));
             conn = end + 1;
             state = conn >= net->synapsecount ? 4 : 0;
           case 4:
             break;
           default:
             {
-              fprintf (stderr,
-                       "Program Error: Unhandled case(2) in nnetwriter.\n");
-              exit (1);
+              Complain ("Program Error: Unhandled case(2) in nnetwriter.\n");
+              Fail (1);
             }
           }
       fprintf (out, "EndConnections\n");
@@ -482,9 +720,11 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
       fprintf (out, "StartData\n");
       currentmask =
         (DATA_IMMEDIATE | DATA_FROMFILE | DATA_FROMDIRECTORY | DATA_FROMPIPE);
-      for (currentcase = net->data; currentcase != NULL;
-           currentcase = currentcase->next)
+      size_t datacount;
+      struct cases **dataorder = CasesInOrder (net->data, &datacount);
+      for (size_t index = 0; index < datacount; index++)
         {
+          currentcase = dataorder[index];
           fprintf (out, "   Data(");
           switch (currentcase->flags & currentmask)
             {
@@ -501,9 +741,8 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
               fprintf (out, "FromPipe ");
               break;
             default:
-              fprintf (stderr,
-                       "Program Error: Unhandled case(3) in nnetwriter.\n");
-              exit (1);
+              Complain ("Program Error: Unhandled case(3) in nnetwriter.\n");
+              Fail (1);
             }
           if ((currentcase->flags & DATA_IMMEDIATE) == 0)
             fprintf (out, "\"%s\" ", currentcase->inname);
@@ -523,6 +762,8 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
             fprintf (out, "WriteNoInput ");
           if ((currentcase->flags & DATA_NOWRITEOUTPUT) != 0)
             fprintf (out, "WriteNoOutput ");
+          if ((currentcase->flags & DATA_SEQUENCE) != 0)
+            fprintf (out, "Sequence ");
           if ((currentcase->flags & DATA_WRITEFILE) != 0)
             fprintf (out, "ToFile ");
           if ((currentcase->flags & DATA_WRITEPIPE) != 0)
@@ -531,17 +772,18 @@ nnetwriter (struct nnet *net, struct conf *config, FILE * out)
             {
               if (currentcase->outname == NULL)
                 {
-                  fprintf (stderr,
-                           "Program Error: in nnetwriter, found network with missing outname.\n");
-                  exit (1);
+                  Complain
+                    ("Program Error: in nnetwriter, found network with missing outname.\n");
+                  Fail (1);
                 }
               else
-                fprintf (out, "\"%s  \"", currentcase->outname);
+                fprintf (out, "\"%s\" ", currentcase->outname);
             }
           if ((currentcase->flags & DATA_IMMEDIATE) != 0)
             WriteImmediateCases (out, currentcase);
           fprintf (out, ")\n");
         }
+      free (dataorder);
       fprintf (out, "EndData\n");
     }
 }
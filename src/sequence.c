@@ -0,0 +1,81 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// running networks over sequences of cases one time step at a time.
+
+#include "includes.h"
+#include "defines.h"
+#include "feedforward.h"
+#include "sequence.h"
+#include "fail.h"
+
+// start a sequencer for net.
+struct sequencer *
+StartSequencer (const struct nnet *net)
+{
+  assert (net != NULL);
+  struct sequencer *sq =
+    (struct sequencer *) calloc (1, sizeof (struct sequencer));
+  if (sq == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in StartSequencer.\n");
+      Fail (1);
+    }
+  sq->net = net;
+  sq->activations = (sigtype *) malloc (sizeof (sigtype) * net->nodecount);
+  sq->history = (flotype *) malloc (sizeof (flotype) * net->nodecount);
+  sq->outputs = (flotype *) malloc (sizeof (flotype) * (net->outputcount + 1));
+  if (sq->activations == NULL || sq->history == NULL || sq->outputs == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in StartSequencer.\n");
+      Fail (1);
+    }
+  ResetSequence (sq);
+  return (sq);
+}
+
+// start a new sequence: forget the activations carried by recurrent connections.
+void
+ResetSequence (struct sequencer *sq)
+{
+  assert (sq != NULL);
+  init_activations (sq->net, sq->activations);
+}
+
+// run one time step of the sequence with the given inputs.  Returns the step's outputs, which remain valid until the
+// next step.
+const flotype *
+SequenceStep (struct sequencer *sq, const flotype * inputs)
+{
+  assert (sq != NULL);
+  fwdprop (sq->net, inputs, sq->activations, sq->history, sq->outputs);
+  return (sq->outputs);
+}
+
+void
+FinishSequencer (struct sequencer *sq)
+{
+  if (sq == NULL)
+    return;
+  free (sq->activations);
+  free (sq->history);
+  free (sq->outputs);
+  free (sq);
+}
@@ -0,0 +1,562 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Deployment server: answers requests arriving on a named pipe or Unix socket, gathering the requests that arrive within
+// a plan's latency window into one batched forward pass.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "includes.h"
+#include "defines.h"
+#include "feedforward.h"
+#include "casestream.h"
+#include "plans.h"
+#include "server.h"
+#include "profile.h"
+
+// a socket client may fall this many bytes of answers behind before it is dropped.
+#define SERVER_REPLY_BACKLOG (1 << 20)
+
+// one source of requests: a connection on the socket, or the named pipe.  Requests are lines of input values (brackets
+// and commas are ignored); each gets one response line written to out, in the order the requests arrived.  A socket
+// client's answers are written to out in memory and sent from there as the client reads them, so that a client which
+// stops reading holds up nobody else.
+struct client
+{
+  int fd;                       // -1 once closed for reading.
+  FILE *out;                    // NULL until first response if out is a pipe that must be opened.
+  int outfd;                    // socket clients: where answers are sent, -1 once closed.
+  char *reply;                  // socket clients: out's buffer; the answers not yet sent start at reply[sent].
+  size_t replylen;
+  size_t sent;
+  char *buf;                    // bytes received but not yet taken as requests.
+  size_t len;
+  size_t cap;
+  size_t waiting;               // requests queued but not answered.
+};
+
+struct server
+{
+  struct nnet *net;
+  struct cases *dat;
+  size_t batchmax;
+  long latency;                 // nanoseconds
+  int listenfd;                 // -1 unless serving a socket.
+  struct client *clients;
+  size_t clientcount;
+  // the batch being gathered.
+  size_t pending;
+  flotype *rows;                // batchmax requests, row-major.
+  size_t *owner;                // client of each request.
+  int *valid;                   // request parsed to the right number of values.
+  struct timespec deadline;     // when the batch will be run whether or not it is full.
+  // scratch for the forward pass.
+  flotype *ins;
+  flotype *outs;
+  flotype *history;             // node outputs of the batch, so that batches run without allocating.
+  sigtype *acts;
+  size_t served;
+};
+
+static volatile sig_atomic_t StopServing = 0;
+
+static void
+HandleStop (int sig)
+{
+  StopServing = sig;
+}
+
+static void
+AddClient (struct server *sv, int fd, int outfd)
+{
+  struct client *grown = (struct client *) realloc (sv->clients,
+                                                    sizeof (struct client)
+                                                    * (sv->clientcount + 1));
+  if (grown == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in AddClient.\n");
+      exit (1);
+    }
+  sv->clients = grown;
+  memset (&(sv->clients[sv->clientcount]), 0, sizeof (struct client));
+  sv->clients[sv->clientcount].fd = fd;
+  sv->clients[sv->clientcount].outfd = outfd;
+  if (outfd >= 0)
+    {
+      struct client *cl = &(sv->clients[sv->clientcount]);
+      cl->out = open_memstream (&(cl->reply), &(cl->replylen));
+      if (cl->out == NULL)
+        {
+          fprintf (stderr, "Runtime Error: Allocation failure in AddClient.\n");
+          exit (1);
+        }
+    }
+  sv->clientcount++;
+}
+
+// stop answering socket client c and stop reading its requests; answers it is still owed are discarded.
+static void
+DropClient (struct server *sv, size_t c)
+{
+  struct client *cl = &(sv->clients[c]);
+  if (cl->fd >= 0)
+    close (cl->fd);
+  cl->fd = -1;
+  cl->len = 0;
+  if (cl->out != NULL)
+    fclose (cl->out);
+  cl->out = NULL;
+  if (cl->outfd >= 0)
+    close (cl->outfd);
+  cl->outfd = -1;
+  free (cl->reply);
+  cl->reply = NULL;
+  cl->replylen = cl->sent = 0;
+}
+
+// send socket client c as many of its answers as it will take without blocking.  A client that has gone away, or has
+// let SERVER_REPLY_BACKLOG bytes of answers pile up, is dropped.
+static void
+SendReplies (struct server *sv, size_t c)
+{
+  struct client *cl = &(sv->clients[c]);
+  if (cl->out == NULL)
+    return;
+  if (fflush (cl->out) != 0)
+    {
+      DropClient (sv, c);
+      return;
+    }
+  while (cl->sent < cl->replylen)
+    {
+      ssize_t put =
+        write (cl->outfd, &(cl->reply[cl->sent]), cl->replylen - cl->sent);
+      if (put < 0 && errno == EINTR)
+        continue;
+      if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (put <= 0)
+        {                       // the peer has gone away.
+          DropClient (sv, c);
+          return;
+        }
+      cl->sent += put;
+    }
+  if (cl->sent == cl->replylen)
+    {                           // all sent: write the next answers from the start of the buffer.
+      fseeko (cl->out, 0, SEEK_SET);
+      cl->sent = cl->replylen = 0;
+    }
+  else if (cl->replylen - cl->sent > SERVER_REPLY_BACKLOG)
+    DropClient (sv, c);
+}
+
+// parse one request line into target.  Returns 1 for a request, 0 for a blank line, -1 for a malformed request.
+static int
+ParseRequest (char *line, size_t inputcount, flotype * target)
+{
+  size_t count = 0;
+  char *end;
+  double value;
+  for (char *cursor = line; *cursor != 0; cursor++)
+    if (*cursor == '[' || *cursor == ']' || *cursor == ',')
+      *cursor = ' ';
+  for (;; line = end, count++)
+    {
+      value = strtod (line, &end);
+      if (end == line)
+        break;
+      if (fabs (value) > FLOTYPE_MAX)
+        return (-1);
+      if (count < inputcount)
+        target[count] = (flotype) value;
+    }
+  while (isspace (*line))
+    line++;
+  if (count == 0 && *line == 0)
+    return (0);
+  return ((count == inputcount && *line == 0) ? 1 : -1);
+}
+
+static int
+Later (const struct timespec *a, const struct timespec *b)
+{
+  return (a->tv_sec > b->tv_sec
+          || (a->tv_sec == b->tv_sec && a->tv_nsec > b->tv_nsec));
+}
+
+// move complete lines received from client c into the batch, while there is room.
+static void
+TakeRequests (struct server *sv, size_t c)
+{
+  struct client *cl = &(sv->clients[c]);
+  size_t start = 0;
+  char *newline;
+  while (sv->pending < sv->batchmax
+         && (newline = memchr (&(cl->buf[start]), '\n', cl->len - start)))
+    {
+      *newline = 0;
+      size_t slot = sv->pending;
+      int status = ParseRequest (&(cl->buf[start]), sv->dat->inputcount,
+                                 &(sv->rows[slot * sv->dat->inputcount]));
+      start = newline - cl->buf + 1;
+      if (status == 0)
+        continue;
+      if (sv->pending == 0)
+        {                       // first request of a batch starts the latency window.
+          clock_gettime (CLOCK_MONOTONIC, &(sv->deadline));
+          sv->deadline.tv_nsec += sv->latency;
+          sv->deadline.tv_sec += sv->deadline.tv_nsec / 1000000000L;
+          sv->deadline.tv_nsec %= 1000000000L;
+        }
+      if (status < 0)
+        memset (&(sv->rows[slot * sv->dat->inputcount]), 0,
+                sizeof (flotype) * sv->dat->inputcount);
+      sv->owner[slot] = c;
+      sv->valid[slot] = (status == 1);
+      sv->pending++;
+      cl->waiting++;
+    }
+  memmove (cl->buf, &(cl->buf[start]), cl->len - start);
+  cl->len -= start;
+}
+
+// read what client c has sent.  Returns 0 when the client has closed its end.
+static int
+ReceiveRequests (struct server *sv, size_t c)
+{
+  struct client *cl = &(sv->clients[c]);
+  if (cl->cap - cl->len < 4096)
+    {
+      cl->cap = cl->cap * 2 + 4096;
+      if (NULL == (cl->buf = (char *) realloc (cl->buf, cl->cap)))
+        {
+          fprintf (stderr,
+                   "Runtime Error: Allocation failure in ReceiveRequests.\n");
+          exit (1);
+        }
+    }
+  ssize_t got = read (cl->fd, &(cl->buf[cl->len]), cl->cap - cl->len - 1);
+  if (got < 0 && (errno == EINTR || errno == EAGAIN))
+    return (1);
+  if (got <= 0)
+    {
+      if (cl->len > 0)
+        cl->buf[cl->len++] = '\n';      // a last request may lack its newline.
+      return (0);
+    }
+  cl->len += got;
+  return (1);
+}
+
+// run the gathered batch through the network and answer each request, in order.
+static void
+RunBatch (struct server *sv)
+{
+  struct nnet *net = sv->net;
+  size_t count = sv->pending;
+  size_t width = sv->dat->inputcount;
+  // like RunDataSet, data without the network's inputs leaves them zero.
+  if (width == net->inputcount)
+    for (size_t b = 0; b < count; b++)
+      for (size_t in = 0; in < width; in++)
+        sv->ins[in * count + b] = sv->rows[b * width + in];
+  init_activations_batch (net, sv->acts, count);
+  fwdprop_batch (net, count, sv->ins, sv->acts, sv->history, sv->outs);
+  double began = PROFILE_START (net);   // answering counts as data output.
+  for (size_t b = 0; b < count; b++)
+    {
+      struct client *cl = &(sv->clients[sv->owner[b]]);
+      cl->waiting--;
+      if (cl->out == NULL)
+        {
+          if (sv->listenfd >= 0)
+            continue;           // connection closed before its answer was ready.
+          cl->out = fopen (sv->dat->outname, "a");
+          if (cl->out == NULL)
+            {
+              fprintf (stderr, "unable to open %s\n", sv->dat->outname);
+              exit (1);
+            }
+        }
+      if (!sv->valid[b])
+        {
+          fprintf (cl->out, "Error: expected %zu input values.\n", width);
+          continue;
+        }
+      WriteResultCase (cl->out, sv->dat, &(sv->rows[b * width]),
+                       &(sv->outs[b]), count, net->outputcount);
+      sv->served++;
+    }
+  for (size_t c = 0; c < sv->clientcount; c++)
+    if (sv->listenfd >= 0)
+      SendReplies (sv, c);
+    else if (sv->clients[c].out != NULL)
+      fflush (sv->clients[c].out);
+  PROFILE_STOP (net, PROF_DATA, began);
+  sv->pending = 0;
+  for (size_t c = 0; c < sv->clientcount; c++)
+    TakeRequests (sv, c);       // requests held back while the batch was full.
+}
+
+// forget socket clients that have closed and have no answers outstanding or unsent.
+static void
+ReapClients (struct server *sv)
+{
+  size_t keep = 0;
+  if (sv->pending != 0)
+    return;                     // owner indices into clients must stay put until the batch is answered.
+  for (size_t c = 0; c < sv->clientcount; c++)
+    {
+      struct client *cl = &(sv->clients[c]);
+      if (cl->fd < 0 && cl->waiting == 0 && sv->listenfd >= 0
+          && cl->sent == cl->replylen)
+        {
+          DropClient (sv, c);
+          free (cl->buf);
+        }
+      else
+        sv->clients[keep++] = *cl;
+    }
+  sv->clientcount = keep;
+}
+
+static int
+OpenListener (const char *path)
+{
+  struct sockaddr_un addr;
+  int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  memset (&addr, 0, sizeof (struct sockaddr_un));
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || strlen (path) >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "unable to create socket %s\n", path);
+      exit (1);
+    }
+  strcpy (addr.sun_path, path);
+  unlink (path);
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (struct sockaddr_un)) != 0
+      || listen (fd, 64) != 0)
+    {
+      fprintf (stderr, "unable to listen on socket %s\n", path);
+      exit (1);
+    }
+  fcntl (fd, F_SETFL, O_NONBLOCK);
+  return (fd);
+}
+
+// A named pipe is opened for writing as well as reading, so that it never reaches end of file when its writers close
+// it; the server then keeps waiting for the next writer.
+static int
+OpenRequestPipe (const char *name)
+{
+  struct stat st;
+  int fifo = (stat (name, &st) == 0 && S_ISFIFO (st.st_mode));
+  int fd = open (name, fifo ? O_RDWR : O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf (stderr, "unable to open %s\n", name);
+      exit (1);
+    }
+  return (fd);
+}
+
+// Serve the Deployment data set dat until its source is exhausted (a plain file), or until nnet is sent SIGINT or
+// SIGTERM.  Returns the number of requests answered.
+size_t
+ServeDeployment (struct nnet *net, struct plans *pl, struct cases *dat)
+{
+  assert (net != NULL);
+  assert (pl != NULL);
+  assert (dat != NULL);
+  struct server sv;
+  struct sigaction stop;
+  struct sigaction oldint;
+  struct sigaction oldterm;
+  struct sigaction oldpipe;
+  struct sigaction ignore;
+  const char *socketpath = NULL;
+  struct pollfd *polls = NULL;
+  memset (&sv, 0, sizeof (struct server));
+  sv.net = net;
+  sv.dat = dat;
+  sv.batchmax = pl->batchsize != 0 ? pl->batchsize : STREAM_BATCH;
+  sv.latency = (long) pl->latency * 1000L;
+  sv.listenfd = -1;
+  sv.rows = (flotype *) malloc (sizeof (flotype) * sv.batchmax *
+                                (dat->inputcount + 1));
+  sv.owner = (size_t *) malloc (sizeof (size_t) * sv.batchmax);
+  sv.valid = (int *) malloc (sizeof (int) * sv.batchmax);
+  sv.ins = (flotype *) calloc (sv.batchmax * (net->inputcount + 1),
+                               sizeof (flotype));
+  sv.outs = (flotype *) malloc (sizeof (flotype) * sv.batchmax *
+                                (net->outputcount + 1));
+  sv.history = (flotype *) malloc (sizeof (flotype) * sv.batchmax *
+                                   net->nodecount);
+  sv.acts = (sigtype *) malloc (sizeof (sigtype) * sv.batchmax *
+                                net->nodecount);
+  if (sv.rows == NULL || sv.owner == NULL || sv.valid == NULL
+      || sv.ins == NULL || sv.outs == NULL || sv.history == NULL
+      || sv.acts == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in ServeDeployment.\n");
+      exit (1);
+    }
+  memset (&stop, 0, sizeof (struct sigaction));
+  stop.sa_handler = HandleStop;
+  StopServing = 0;
+  sigaction (SIGINT, &stop, &oldint);
+  sigaction (SIGTERM, &stop, &oldterm);
+  memset (&ignore, 0, sizeof (struct sigaction));
+  ignore.sa_handler = SIG_IGN;
+  sigaction (SIGPIPE, &ignore, &oldpipe);       // a client gone away is seen as a failed write instead.
+  if (strncmp (dat->inname, SERVER_SOCKET_PREFIX,
+               strlen (SERVER_SOCKET_PREFIX)) == 0)
+    {
+      socketpath = &(dat->inname[strlen (SERVER_SOCKET_PREFIX)]);
+      sv.listenfd = OpenListener (socketpath);
+    }
+  else
+    AddClient (&sv, OpenRequestPipe (dat->inname), -1);
+  while (!StopServing)
+    {
+      size_t npoll = 0;
+      int timeout = -1;
+      struct timespec now;
+      polls = (struct pollfd *) realloc (polls, sizeof (struct pollfd) *
+                                         (sv.clientcount + 1));
+      if (polls == NULL)
+        {
+          fprintf (stderr,
+                   "Runtime Error: Allocation failure in ServeDeployment.\n");
+          exit (1);
+        }
+      if (sv.listenfd >= 0)
+        {
+          polls[npoll].fd = sv.listenfd;
+          polls[npoll++].events = POLLIN;
+        }
+      for (size_t c = 0; c < sv.clientcount; c++)
+        {                       // clients with nothing to read or send are polled as fd -1, which poll ignores.
+          struct client *cl = &(sv.clients[c]);
+          int unsent = cl->sent < cl->replylen;
+          polls[npoll].fd = cl->fd >= 0 ? cl->fd : unsent ? cl->outfd : -1;
+          polls[npoll++].events =
+            (cl->fd >= 0 ? POLLIN : 0) | (unsent ? POLLOUT : 0);
+        }
+      if (sv.pending != 0)
+        {
+          clock_gettime (CLOCK_MONOTONIC, &now);
+          if (sv.pending == sv.batchmax || !Later (&(sv.deadline), &now))
+            timeout = 0;
+          else
+            timeout = (int) ((sv.deadline.tv_sec - now.tv_sec) * 1000 +
+                             (sv.deadline.tv_nsec - now.tv_nsec + 999999) /
+                             1000000);
+        }
+      else if (sv.listenfd < 0 && sv.clients[0].fd < 0)
+        break;                  // plain file fully read and answered.
+      if (poll (polls, npoll, timeout) < 0 && errno != EINTR)
+        {
+          fprintf (stderr, "poll failed in ServeDeployment.\n");
+          exit (1);
+        }
+      if (StopServing)
+        break;
+      size_t polled = sv.clientcount;
+      npoll = 0;
+      if (sv.listenfd >= 0 && (polls[npoll++].revents & POLLIN) != 0)
+        {
+          int fd;
+          while ((fd = accept (sv.listenfd, NULL, NULL)) >= 0)
+            {
+              int outfd = dup (fd);
+              if (outfd < 0)
+                {
+                  close (fd);
+                  continue;
+                }
+              fcntl (fd, F_SETFL, O_NONBLOCK);  // shared with outfd.
+              AddClient (&sv, fd, outfd);
+            }
+        }
+      for (size_t c = 0; c < polled; c++, npoll++)
+        {
+          if (sv.clients[c].sent < sv.clients[c].replylen
+              && (polls[npoll].revents & (POLLOUT | POLLHUP | POLLERR)) != 0)
+            SendReplies (&sv, c);
+          if (sv.clients[c].fd >= 0
+              && (polls[npoll].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+            {
+              if (!ReceiveRequests (&sv, c))
+                {
+                  close (sv.clients[c].fd);
+                  sv.clients[c].fd = -1;
+                }
+              TakeRequests (&sv, c);
+            }
+        }
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      if (sv.pending == sv.batchmax
+          || (sv.pending != 0 && !Later (&(sv.deadline), &now)))
+        RunBatch (&sv);
+      ReapClients (&sv);
+    }
+  if (sv.pending != 0)
+    RunBatch (&sv);             // answer what has already been received.
+  for (size_t c = 0; c < sv.clientcount; c++)
+    {
+      if (sv.listenfd >= 0)
+        DropClient (&sv, c);    // unsent answers are abandoned.
+      else
+        {
+          if (sv.clients[c].fd >= 0)
+            close (sv.clients[c].fd);
+          if (sv.clients[c].out != NULL)
+            fclose (sv.clients[c].out);
+        }
+      free (sv.clients[c].buf);
+    }
+  if (sv.listenfd >= 0)
+    {
+      close (sv.listenfd);
+      unlink (socketpath);
+    }
+  sigaction (SIGINT, &oldint, NULL);
+  sigaction (SIGTERM, &oldterm, NULL);
+  sigaction (SIGPIPE, &oldpipe, NULL);
+  free (polls);
+  free (sv.clients);
+  free (sv.rows);
+  free (sv.owner);
+  free (sv.valid);
+  free (sv.ins);
+  free (sv.outs);
+  free (sv.history);
+  free (sv.acts);
+  return (sv.served);
+}
@@ -103,7 +103,7 @@ simulated_annealing (network * nn, network_config * config)
               // if(de<=0.) just accept the new configuration
               // otherwise treat it probabilistically
               double p = exp (-e0 / kbt);
-              if (rnd () < p)
+              if (rnd (config) < p)
                 // accept the new configuration
                 e0 = err;
               else
@@ -0,0 +1,124 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// helpers shared by the check programs and the benchmark programs.
+
+#include "includes.h"
+#include "defines.h"
+#include "testnet.h"
+
+double
+Uniform (double min, double max)
+{
+  return (min + (max - min) * ((double) random () / RAND_MAX));
+}
+
+// add count synapses, each from a random node to a random node numbered firstdest or above, with weights uniform in
+// plus or minus scale.  If tinyevery isn't zero, about one synapse in tinyevery has its weight made a hundred times
+// smaller.
+void
+RandomSynapses (struct netbuilder *nb, int firstdest, unsigned int count,
+                double scale, int tinyevery)
+{
+  const unsigned int nodes = nb->net->nodecount;
+  for (unsigned int synapse = 0; synapse < count; synapse++)
+    {
+      int from = random () % nodes;
+      int to = firstdest + random () % (nodes - firstdest);
+      flotype weight = Uniform (-scale, scale);
+      if (tinyevery != 0 && random () % tinyevery == 0)
+        weight *= 0.01;
+      BuildConnections (nb, from, from, to, to, &weight, 1);
+    }
+}
+
+// connect each of the sources nodes from source to each of the dests nodes from dest, with weights uniform in plus or
+// minus scale divided by the square root of the number of sources.
+void
+ConnectLayers (struct netbuilder *nb, int source, int sources, int dest,
+               int dests, double scale)
+{
+  flotype *weights = malloc (sizeof (flotype) * sources * dests);
+  if (weights == NULL)
+    {
+      fprintf (stderr,
+               "Runtime Error: Allocation failure in ConnectLayers.\n");
+      exit (1);
+    }
+  for (int weight = 0; weight < sources * dests; weight++)
+    weights[weight] = Uniform (-scale, scale) / sqrt ((double) sources);
+  BuildConnections (nb, source, source + sources - 1, dest,
+                    dest + dests - 1, weights, sources * dests);
+  free (weights);
+}
+
+static void *
+CopyOf (const void *src, size_t bytes)
+{
+  void *copy = malloc (bytes + 1);
+  if (copy == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in CopyOf.\n");
+      exit (1);
+    }
+  memcpy (copy, src, bytes);
+  return (copy);
+}
+
+// make copy a network like net, with node and synapse arrays of its own; anything else net points to is shared.
+void
+CopyNetwork (struct nnet *copy, const struct nnet *net)
+{
+  *copy = *net;
+  copy->transfer = CopyOf (net->transfer,
+                           sizeof (enum activation_function) *
+                           net->nodecount);
+  copy->accum = CopyOf (net->accum,
+                        sizeof (enum accumulator_function) * net->nodecount);
+  copy->transferwidths = CopyOf (net->transferwidths,
+                                 sizeof (unsigned int) * net->nodecount);
+  copy->weights = CopyOf (net->weights, sizeof (flotype) * net->synapsecount);
+  copy->sources = CopyOf (net->sources,
+                          sizeof (unsigned int) * net->synapsecount);
+  copy->dests = CopyOf (net->dests, sizeof (unsigned int) * net->synapsecount);
+}
+
+// free the node and synapse arrays of a network built with a netbuilder or by CopyNetwork.
+void
+FreeNetwork (struct nnet *net)
+{
+  free (net->transfer);
+  free (net->accum);
+  free (net->transferwidths);
+  free (net->weights);
+  free (net->sources);
+  free (net->dests);
+}
+
+// run check on networks random networks, numbered from 0, from the same random sequence every time.  Each call adds
+// what it measures to tally, and returns nonzero if its network fails.  Returns the number of networks that failed.
+int
+CheckNetworks (int networks, int (*check) (int, void *), void *tally)
+{
+  int failing = 0;
+  srandom (1);
+  for (int network = 0; network < networks; network++)
+    failing += check (network, tally) != 0;
+  return (failing);
+}
@@ -0,0 +1,232 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// carrying out training plans: gradient descent on the weights of nnet networks.
+
+#include "includes.h"
+#include "defines.h"
+#include "casestream.h"
+#include "backprop.h"
+#include "train.h"
+#include "prune.h"
+#include "profile.h"
+
+// the training cases of a plan, read in order from every training data set and starting over when all have been read.
+struct trainingfeed
+{
+  struct cases **sets;
+  size_t setcount;
+  size_t set;                   // data set being read.
+  struct casestream *cs;        // NULL between data sets.
+  flotype *rows;
+  size_t count;                 // cases in rows.
+  size_t next;                  // next case of rows.
+};
+
+// the next training case, or NULL if a data set has just ended (the next call starts the next one).  Sets *dat to the
+// data set the case belongs to.  Reading batches of cases counts as data input if net is profiled.
+static const flotype *
+NextTrainingCase (const struct nnet *net, struct trainingfeed *feed,
+                  struct cases **dat)
+{
+  if (feed->cs == NULL)
+    feed->cs = OpenCaseStream (feed->sets[feed->set], STREAM_BATCH,
+                               STREAM_RING);
+  *dat = feed->sets[feed->set];
+  if (feed->next == feed->count)
+    {
+      double began = PROFILE_START (net);
+      feed->next = 0;
+      feed->rows = NextCaseBatch (feed->cs, &(feed->count));
+      PROFILE_STOP (net, PROF_DATA, began);
+      if (feed->rows == NULL)
+        {
+          CloseCaseStream (feed->cs);
+          feed->cs = NULL;
+          feed->count = 0;
+          feed->set = (feed->set + 1) % feed->setcount;
+          return (NULL);
+        }
+    }
+  return (&(feed->rows[(feed->next++) * ((*dat)->inputcount +
+                                         (*dat)->outputcount)]));
+}
+
+// feed training cases until count more windows have been backpropagated.  Every case of an ordinary data set is a
+// sequence of one step; Sequence data sets hold sequences of steps, each starting at a case with a nonzero marker.
+static void
+TrainBatch (struct bptt *bp, struct trainingfeed *feed, size_t count,
+            const flotype * zeros)
+{
+  const struct nnet *net = bp->net;
+  size_t target = bp->windows + count;
+  size_t empty = 0;
+  while (bp->windows < target)
+    {
+      struct cases *dat;
+      const flotype *row = NextTrainingCase (net, feed, &dat);
+      if (row == NULL)
+        {                       // a data set ended, and with it any sequence.
+          ResetBptt (bp);
+          if (++empty > feed->setcount)
+            return;             // the data sets hold no cases.
+          continue;
+        }
+      empty = 0;
+      if ((dat->flags & DATA_SEQUENCE) == 0)
+        {
+          ResetBptt (bp);
+          BpttStep (bp, dat->inputcount == net->inputcount ? row : zeros,
+                    &(row[dat->inputcount]));
+          EndBpttWindow (bp);
+        }
+      else
+        {
+          if (row[0] != ZERO)
+            ResetBptt (bp);
+          BpttStep (bp, dat->inputcount == net->inputcount + 1 ?
+                    &(row[1]) : zeros, &(row[dat->inputcount]));
+        }
+    }
+}
+
+// whether to save after this epoch: the plan's saves are spread evenly over its maximum number of epochs, or made
+// after every epoch if it has no maximum or fewer epochs than saves.
+static int
+SaveDue (const struct plans *pl, unsigned int saves, unsigned int epoch)
+{
+  if (saves == 0)
+    return (0);
+  if (pl->epochmax == 0 || saves >= pl->epochmax)
+    return (1);
+  return ((unsigned long) epoch * saves / pl->epochmax !=
+          (unsigned long) (epoch - 1) * saves / pl->epochmax);
+}
+
+// train the network by gradient descent on the squared error of its outputs over the plan's training data, until the
+// plan's goal or maximum number of epochs is reached.  Accuracy is one minus the RMS error of an epoch's outputs.
+void
+TrainNetwork (struct nnet *net, struct conf *config, struct plans *pl,
+              struct checkpointer *saver)
+{
+  assert (net != NULL);
+  assert (config != NULL);
+  assert (pl != NULL);
+  struct trainingfeed feed;
+  size_t datacount;
+  struct cases **order = CasesInOrder (net->data, &datacount);
+  unsigned int saves = config->savecount;
+  unsigned int epoch = 0;
+  size_t window = pl->window != 0 ? pl->window : PLAN_DEFAULT_WINDOW;
+  size_t interval = pl->storeevery;
+  size_t batch = pl->batchsize != 0 ? pl->batchsize : 1;
+  double rms = 0.0;
+  FILE *report = stdout;
+  memset (&feed, 0, sizeof (struct trainingfeed));
+  feed.sets = order;
+  for (size_t index = 0; index < datacount; index++)
+    {
+      struct cases *dat = order[index];
+      if ((dat->flags & DATA_TRAINING) == 0)
+        continue;
+      if ((dat->flags & DATA_FROMPIPE) != 0)
+        fprintf (stderr,
+                 "FromPipe data is only read by Deployment plans; skipping \"%s\".\n",
+                 dat->inname);
+      else if (dat->outputcount != net->outputcount
+               || net->outputcount == 0)
+        fprintf (stderr,
+                 "Training data has no target outputs to train toward; skipping it.\n");
+      else
+        order[feed.setcount++] = dat;
+    }
+  if (feed.setcount == 0)
+    {
+      fprintf (stderr, "TrainingPlan has no training data; skipping it.\n");
+      free (order);
+      return;
+    }
+  if (interval == 0)
+    while (interval * interval < window)
+      interval++;
+  interval = MIN (interval, window);
+  flotype *zeros = (flotype *) calloc (net->inputcount + 1, sizeof (flotype));
+  if (zeros == NULL)
+    {
+      fprintf (stderr, "Runtime Error: Allocation failure in TrainNetwork.\n");
+      exit (1);
+    }
+  struct bptt *bp = StartBptt (net, window, interval);
+  if (pl->reportdest != NULL && strcmp (pl->reportdest, "stdout") != 0
+      && NULL == (report = fopen (pl->reportdest, "a")))
+    {
+      fprintf (stderr, "unable to open %s\n", pl->reportdest);
+      exit (1);
+    }
+  do
+    {
+      epoch++;
+      bp->sqerr = 0.0;
+      bp->scoredvals = 0;
+      for (size_t count = 0; count < pl->epochsize; count++)
+        {
+          TrainBatch (bp, &feed, batch, zeros);
+          DescendGradient (bp, pl->trainrate);
+        }
+      rms = bp->scoredvals > 0 ? sqrt (bp->sqerr / bp->scoredvals) : 0.0;
+      fprintf (report, "Epoch %u: RMS error %.9g\n", epoch, rms);
+      if (net->profile != NULL)
+        {
+          char label[32];
+          snprintf (label, sizeof (label), "Epoch %u", epoch);
+          ProfileReport (net, report, label);
+        }
+      if (pl->pruneevery != 0 && epoch % pl->pruneevery == 0)
+        {                       // the bptt's per-synapse arrays are sized to the synapses it started with.
+          unsigned int removed =
+            PruneNetwork (net, pl->prunebelow, pl->keeptop);
+          if (removed > 0)
+            {
+              FinishBptt (bp);
+              bp = StartBptt (net, window, interval);
+              fprintf (report, "Epoch %u: pruned %u synapses, %u remain\n",
+                       epoch, removed, net->synapsecount);
+            }
+        }
+      if (SaveDue (pl, saves, epoch) && config->savecount > 0)
+        {
+          Checkpoint (saver);
+          config->savecount--;
+        }
+    }
+  while ((epoch < pl->epochmin || 1.0 - rms < pl->goal)
+         && (pl->epochmax == 0 || epoch < pl->epochmax));
+  fprintf (report, "Training: %u epochs, RMS error %.9g\n", epoch, rms);
+  if (report != stdout)
+    fclose (report);
+  else
+    fflush (stdout);
+  config->savecount = saves;
+  if (feed.cs != NULL)
+    CloseCaseStream (feed.cs);
+  FinishBptt (bp);
+  free (zeros);
+  free (order);
+}
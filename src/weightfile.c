@@ -0,0 +1,170 @@
+/*
+   Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+
+   This file is part of Gneural Knockoff.
+
+   Gneural Knockoff is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Affero General Public License as published by the
+   Free Software Foundation; either version 3, or (at your option) any later
+   version.
+
+   Gneural Knockoff is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+   License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with Gneural Knockoff.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// binary weight files: mapping them for Connect statements that refer to them, and writing them for nnetwriter.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes.h"
+#include "defines.h"
+#include "weightfile.h"
+#include "fail.h"
+
+// Find the weight file name among those already mapped on *list, or map it and add it.  Returns NULL and writes a
+// message into the size bytes at message if the file cannot be used.
+struct weightfile *
+OpenWeightFile (struct weightfile **list, const char *name,
+                char *message, size_t size)
+{
+  assert (list != NULL);
+  assert (name != NULL);
+  assert (message != NULL);
+  struct weightfileheader hdr;
+  struct weightfile *wf;
+  struct stat st;
+  int fd;
+  for (wf = *list; wf != NULL; wf = wf->link)
+    if (strcmp (wf->name, name) == 0)
+      return (wf);
+  if ((fd = open (name, O_RDONLY)) < 0)
+    {
+      snprintf (message, size, "Unable to open weight file %s.",
+                name);
+      return (NULL);
+    }
+  if (pread (fd, &hdr, sizeof (hdr), 0) != sizeof (hdr)
+      || memcmp (hdr.magic, WEIGHTFILE_MAGIC, sizeof (hdr.magic)) != 0)
+    {
+      close (fd);
+      snprintf (message, size, "%s is not a weight file.", name);
+      return (NULL);
+    }
+  if (hdr.version != WEIGHTFILE_VERSION || hdr.endian != WEIGHTFILE_ENDIAN
+      || (hdr.precision != sizeof (float) && hdr.precision != sizeof (double)))
+    {
+      close (fd);
+      snprintf (message, size,
+                "%s was written by a different version of nnet or on a machine with a different byte order.",
+                name);
+      return (NULL);
+    }
+  size_t length = hdr.dataoffset + hdr.weightcount * hdr.precision;
+  if (fstat (fd, &st) != 0 || (uint64_t) st.st_size < length
+      || hdr.dataoffset != sizeof (struct weightfileheader))
+    {
+      close (fd);
+      snprintf (message, size, "%s is truncated or damaged.",
+                name);
+      return (NULL);
+    }
+  wf = (struct weightfile *) malloc (sizeof (struct weightfile));
+  if (wf == NULL || (wf->name = strdup (name)) == NULL)
+    {
+      Complain ("Runtime Error: Allocation failure in OpenWeightFile.\n");
+      Fail (1);
+    }
+  wf->map = mmap (NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (wf->map == MAP_FAILED)
+    {
+      free (wf->name);
+      free (wf);
+      snprintf (message, size, "Unable to map weight file %s.",
+                name);
+      return (NULL);
+    }
+  wf->length = length;
+  wf->values = (const char *) wf->map + hdr.dataoffset;
+  wf->precision = hdr.precision;
+  wf->weightcount = hdr.weightcount;
+  wf->next = 0;
+  wf->link = *list;
+  *list = wf;
+  return (wf);
+}
+
+// Copy count weights starting at position first of a mapped weight file into target, converting them if the file was
+// written by a build of the other precision.  Returns 0 if the file does not hold that many weights there.
+int
+CopyWeights (struct weightfile *wf, size_t first, size_t count,
+             flotype * target)
+{
+  assert (wf != NULL);
+  assert (target != NULL);
+  if (first > wf->weightcount || count > wf->weightcount - first)
+    return (0);
+  if (wf->precision == sizeof (flotype))
+    memcpy (target, wf->values + first * sizeof (flotype),
+            count * sizeof (flotype));
+  else if (wf->precision == sizeof (float))
+    for (size_t index = 0; index < count; index++)
+      target[index] = ((const float *) wf->values)[first + index];
+  else
+    for (size_t index = 0; index < count; index++)
+      target[index] = ((const double *) wf->values)[first + index];
+  wf->next = first + count;
+  return (1);
+}
+
+// Unmap and free every weight file on a list made by OpenWeightFile.
+void
+CloseWeightFiles (struct weightfile *list)
+{
+  struct weightfile *wf;
+  while ((wf = list) != NULL)
+    {
+      list = wf->link;
+      munmap (wf->map, wf->length);
+      free (wf->name);
+      free (wf);
+    }
+}
+
+// Write all the weights of net, in synapse order, to the weight file name.  Weight number n of the file is then the
+// weight of synapse n.
+void
+WriteWeightFile (const struct nnet *net, const char *name)
+{
+  assert (net != NULL);
+  assert (name != NULL);
+  struct weightfileheader hdr;
+  FILE *out = fopen (name, "wb");
+  if (out == NULL)
+    {
+      Complain ("unable to open %s\n", name);
+      Fail (1);
+    }
+  memset (&hdr, 0, sizeof (struct weightfileheader));
+  memcpy (hdr.magic, WEIGHTFILE_MAGIC, sizeof (hdr.magic));
+  hdr.version = WEIGHTFILE_VERSION;
+  hdr.endian = WEIGHTFILE_ENDIAN;
+  hdr.precision = sizeof (flotype);
+  hdr.weightcount = net->synapsecount;
+  hdr.dataoffset = sizeof (struct weightfileheader);
+  if (fwrite (&hdr, sizeof (struct weightfileheader), 1, out) != 1
+      || fwrite (net->weights, sizeof (flotype), net->synapsecount,
+                 out) != net->synapsecount || fclose (out) != 0)
+    {
+      Complain ("error writing %s\n", name);
+      Fail (1);
+    }
+}
@@ -0,0 +1,68 @@
+# Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+#
+# This file is part of Gneural Knockoff.
+#
+# Gneural Knockoff is free software: you can redistribute it and/or modify it
+# under the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# Gneural Knockoff is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Gneural Knockoff. If not, see <https://www.gnu.org/licenses/>.
+
+# Compare the file named on the command line, which holds the expected output,
+# with the file named by the variable other: every line must have the same text,
+# with every number within rtol relative or atol absolute of the expected one.
+# Prints the first difference and exits 1 if there is one.
+#
+#   awk -v other=FILE -v rtol=1e-3 -v atol=1e-5 -f compare.awk EXPECTED
+
+function differ(why) {
+  printf "%s:%d: %s\n  expected: %s\n  found:    %s\n", other, FNR, why, $0, b
+  bad = 1
+  exit
+}
+
+function magnitude(v) {
+  return v < 0 ? -v : v
+}
+
+{
+  if ((getline b < other) <= 0)
+    differ("ends early")
+  a = $0
+  rest = b
+  while (a != "" || rest != "") {
+    na = match(a, /[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?/)
+    sa = RSTART; la = RLENGTH
+    nb = match(rest, /[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?/)
+    sb = RSTART; lb = RLENGTH
+    if (!na || !nb) {
+      if (na || nb || a != rest)
+        differ("text differs")
+      break
+    }
+    if (substr(a, 1, sa - 1) != substr(rest, 1, sb - 1))
+      differ("text differs")
+    x = substr(a, sa, la) + 0
+    y = substr(rest, sb, lb) + 0
+    m = magnitude(x) > magnitude(y) ? magnitude(x) : magnitude(y)
+    if (magnitude(x - y) > atol + rtol * m)
+      differ("values differ: " substr(a, sa, la) " and " substr(rest, sb, lb))
+    a = substr(a, sa + la)
+    rest = substr(rest, sb + lb)
+  }
+}
+
+END {
+  if (!bad && (getline b < other) > 0) {
+    printf "%s: has more lines than %s\n", other, FILENAME
+    bad = 1
+  }
+  exit bad
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+#
+# This file is part of Gneural Knockoff.
+#
+# Gneural Knockoff is free software: you can redistribute it and/or modify it
+# under the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# Gneural Knockoff is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Gneural Knockoff. If not, see <https://www.gnu.org/licenses/>.
+
+# Run each example script tests/NAME.nnet that has a tests/NAME.expected with
+# nnet as configured, and check that the NAME.nnx it writes matches
+# NAME.expected: the same text, with every number within RTOL relative or ATOL
+# absolute of the expected one.  The expected outputs were written by a double
+# precision build; the tolerance allows for single and mixed builds.
+
+srcdir=${srcdir:-.}
+top=$(pwd)
+RTOL=${RTOL:-1e-3}
+ATOL=${ATOL:-1e-5}
+work=tests/expected.d
+
+status=0
+rm -rf "$work"
+mkdir -p "$work"
+for expected in "$srcdir"/tests/*.expected; do
+  name=$(basename "$expected" .expected)
+  cp "$srcdir/tests/$name.nnet" "$work"
+  if (cd "$work" && "$top/nnet" "$name" > "$name.log" 2>&1); then
+    awk -v other="$work/$name.nnx" -v rtol="$RTOL" -v atol="$ATOL" \
+      -f "$srcdir/tests/compare.awk" "$expected" || status=1
+  else
+    echo "$name: nnet failed"
+    cat "$work/$name.log"
+    status=1
+  fi
+done
+exit $status
@@ -0,0 +1,88 @@
+#!/bin/sh
+# Copyright (C) 2022 Karl Semich <0xloem@gmail.com>
+#
+# This file is part of Gneural Knockoff.
+#
+# Gneural Knockoff is free software: you can redistribute it and/or modify it
+# under the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# Gneural Knockoff is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Gneural Knockoff. If not, see <https://www.gnu.org/licenses/>.
+
+# Run every example script in tests/ with the double, single and mixed precision
+# builds of nnet (nnet_double, nnet_single and nnet_mixed, built by make check),
+# and check that what the single and mixed builds print and write matches the
+# double build: the same text, with every number within RTOL relative or ATOL
+# absolute of the double build's.  Each build must also read back a weight
+# that rounds to the largest float from the script it saves.
+
+srcdir=${srcdir:-.}
+top=$(pwd)
+RTOL=${RTOL:-1e-3}
+ATOL=${ATOL:-1e-5}
+work=tests/precision.d
+
+# compare the file $1 written by the double build with $2 written by another.
+compare () {
+  awk -v other="$2" -v rtol="$RTOL" -v atol="$ATOL" -f "$srcdir/tests/compare.awk" "$1"
+}
+
+status=0
+rm -rf "$work"
+for precision in double single mixed; do
+  mkdir -p "$work/$precision"
+  cp "$srcdir"/tests/*.nnet "$work/$precision"
+done
+for script in "$srcdir"/tests/*.nnet; do
+  name=$(basename "$script" .nnet)
+  before=$(ls "$work/double")
+  for precision in double single mixed; do
+    (cd "$work/$precision" && "$top/nnet_$precision" "$name" > "$name.log" 2>&1) || {
+      echo "$name: nnet_$precision failed"
+      cat "$work/$precision/$name.log"
+      status=1
+    }
+  done
+  for file in $(cd "$work/double" && ls); do
+    case " $(echo $before) " in
+      *" $file "*) continue ;;
+    esac
+    for precision in single mixed; do
+      compare "$work/double/$file" "$work/$precision/$file" || status=1
+    done
+  done
+done
+
+# a weight that rounds to the largest float must read back from the script each
+# build saves.
+for precision in double single mixed; do
+  dir="$work/$precision/roundtrip"
+  mkdir -p "$dir"
+  cat > "$dir/largest.nnet" <<EOF
+StartConfig
+    Save("saved.nnet")
+EndConfig
+StartNodes
+    CreateInput(1 Add Identity)
+    CreateOutput(1 Add Identity)
+EndNodes
+StartConnections
+    Connect(0 2 0.5)
+    Connect(1 2 3.40282346e38)
+EndConnections
+EOF
+  (cd "$dir" && "$top/nnet_$precision" largest > largest.log 2>&1 &&
+    "$top/nnet_$precision" saved > saved.log 2>&1) || {
+    echo "largest: nnet_$precision failed to read back its saved script"
+    cat "$dir"/*.log
+    status=1
+  }
+done
+exit $status